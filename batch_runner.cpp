@@ -0,0 +1,209 @@
+//******************************************************************************
+//
+// batch_runner.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include "batch_runner.h"
+#include "host_syscalls.h"
+
+// Reads the jobs from a manifest.
+bool batch_runner::load_manifest(const std::string &fname)
+{
+    std::ifstream infile(fname);
+
+    if (!infile)
+    {
+        std::cerr << "Can't open file '" << fname << "' for reading." << std::endl;
+        return false;
+    }
+
+    // file names in the manifest are relative to its directory
+    std::string dir = fname.substr(0, fname.find_last_of('/') + 1);
+    auto path = [&dir](const std::string &f) { return f.empty() || f[0] == '/' ? f : dir + f; };
+
+    std::string line;
+    for (int n = 1; std::getline(infile, line); ++n)
+    {
+        std::istringstream iss(line);
+        std::string binary;
+
+        if (!(iss >> binary) || binary[0] == '#')
+            continue;
+
+        job j = job();
+        if (!(iss >> std::hex >> j.mem_size >> j.exec_limit))
+        {
+            std::cerr << fname << ":" << n << ": expected: binary hex-mem-size hex-exec-limit [expected-output]" << std::endl;
+            return false;
+        }
+
+        iss >> j.expected;
+        j.binary = path(binary);
+        j.expected = path(j.expected);
+        jobs.push_back(j);
+    }
+
+    return true;
+}
+
+// Runs all of the jobs.
+void batch_runner::run(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = threads;
+
+    // deal the jobs out round-robin
+    queues.clear();
+    for (unsigned i = 0; i < threads; ++i)
+        queues.emplace_back(new work_queue());
+    for (size_t i = 0; i < jobs.size(); ++i)
+        queues[i % threads]->jobs.push_back(i);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i)
+        pool.emplace_back(&batch_runner::worker, this, i);
+    worker(0);
+    for (std::thread &t : pool)
+        t.join();
+
+    wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs jobs until there are none left in any queue.
+void batch_runner::worker(size_t id)
+{
+    size_t j;
+    while (next_job(id, j))
+    {
+        run_job(jobs[j]);
+    }
+}
+
+// Takes the next job for a thread, stealing one if its own queue is empty.
+bool batch_runner::next_job(size_t id, size_t &j)
+{
+    {
+        work_queue &q = *queues[id];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.jobs.empty())
+        {
+            j = q.jobs.back();
+            q.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // nothing is ever added to a queue once run() starts, so one pass over
+    // the others is enough to know that all of the work has been taken
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        work_queue &q = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (!q.jobs.empty())
+        {
+            j = q.jobs.front();
+            q.jobs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Loads and runs a single job.
+void batch_runner::run_job(job &j) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    memory mem(j.mem_size, paged);
+    uint32_t entry = 0;
+    uint32_t flags = 0;
+
+    if (memory::is_elf(j.binary) ? !mem.load_elf(j.binary, entry, nullptr, &flags) : !mem.load_file(j.binary))
+    {
+        j.result = status::error;
+        j.halt_reason = "can't load binary";
+        return;
+    }
+
+    std::ostringstream output;
+    host_syscalls syscalls(mem, output, output, -1);   // the jobs share no input
+
+    cpu_single_hart cpu(mem);
+    cpu.set_reset_pc(entry);
+    cpu.set_compressed(flags & memory::elf_flag_rvc);
+    cpu.reset();
+    cpu.set_engine(exec_engine);
+    cpu.set_syscalls(&syscalls);
+    cpu.run(j.exec_limit, output);
+
+    j.insns = cpu.get_insn_counter();
+    j.halt_reason = cpu.is_halted() ? cpu.get_halt_reason() : "exec limit";
+    j.result = status::done;
+
+    if (!j.expected.empty())
+    {
+        std::ifstream expected(j.expected, std::ios::in|std::ios::binary);
+
+        if (!expected)
+        {
+            j.result = status::error;
+            j.halt_reason = "can't read expected output";
+        }
+        else
+        {
+            std::string want((std::istreambuf_iterator<char>(expected)), std::istreambuf_iterator<char>());
+            j.result = output.str() == want ? status::pass : status::fail;
+        }
+    }
+
+    j.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Prints a line per job and the totals.
+bool batch_runner::report(std::ostream &os) const
+{
+    static const char *const names[] = { "pending", "done", "pass", "FAIL", "ERROR" };
+
+    size_t count[5] = { 0 };
+    uint64_t insns = 0;
+
+    os << std::left << std::setw(40) << "job" << std::setw(8) << "result" << std::right
+       << std::setw(14) << "insns" << std::setw(10) << "seconds" << "  halt reason" << std::endl;
+
+    for (const job &j : jobs)
+    {
+        ++count[static_cast<int>(j.result)];
+        insns += j.insns;
+
+        os << std::left << std::setw(40) << j.binary << std::setw(8) << names[static_cast<int>(j.result)] << std::right
+           << std::setw(14) << j.insns << std::setw(10) << std::fixed << std::setprecision(4) << j.seconds
+           << "  " << j.halt_reason << std::endl;
+    }
+
+    os << jobs.size() << " jobs: " << count[static_cast<int>(status::pass)] << " passed, "
+       << count[static_cast<int>(status::fail)] << " failed, " << count[static_cast<int>(status::error)] << " errors, "
+       << count[static_cast<int>(status::done)] << " unchecked" << std::endl;
+    os << insns << " instructions in " << std::setprecision(3) << wall_seconds << " s on " << thread_count << " threads ("
+       << std::setprecision(1) << (wall_seconds > 0 ? insns / wall_seconds / 1e6 : 0) << " MIPS)" << std::endl;
+
+    return count[static_cast<int>(status::fail)] == 0 && count[static_cast<int>(status::error)] == 0;
+}
@@ -0,0 +1,139 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+//******************************************************************************
+//
+// batch_runner.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cpu_single_hart.h"
+
+/**
+ * @brief Class to run many simulations in parallel.
+ *
+ * The jobs come from a manifest with one job per line:
+ *
+ *     binary hex-mem-size hex-exec-limit [expected-output]
+ *
+ * Blank lines and lines starting with # are ignored, and relative file
+ * names are relative to the manifest's directory. Every job gets its own
+ * memory and cpu_single_hart. What the cpu prints when it finishes is
+ * compared with the contents of expected-output, if given.
+ *
+ * The jobs are spread over one queue per thread. A thread that runs out of
+ * work steals from the other end of another thread's queue, so a few long
+ * jobs don't leave the other threads idle.
+ * ****************************************************************************/
+class batch_runner
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param paged Give each job sparse paged memory.
+         * @param e The execution engine each job's cpu uses.
+         * ********************************************************************/
+        batch_runner(bool paged, cpu_single_hart::engine e) : paged(paged), exec_engine(e) { }
+
+        /**
+         * @brief Reads the jobs from a manifest.
+         * @param fname File name of the manifest.
+         * @return false if the manifest can't be read or has a bad line.
+         * ********************************************************************/
+        bool load_manifest(const std::string &fname);
+
+        /**
+         * @brief Runs all of the jobs.
+         * @param threads The number of threads to use, or 0 for one per
+         *        hardware thread.
+         * ********************************************************************/
+        void run(unsigned threads);
+
+        /**
+         * @brief Prints a line per job and the totals.
+         * @param os Where to print the report.
+         * @return true if every job loaded and matched its expected output.
+         * ********************************************************************/
+        bool report(std::ostream &os) const;
+
+    private:
+        /**
+         * @brief How a job turned out.
+         * ********************************************************************/
+        enum class status
+        {
+            pending,    ///< Not run yet.
+            done,       ///< Ran, with no expected output to check.
+            pass,       ///< Ran and matched its expected output.
+            fail,       ///< Ran and didn't match its expected output.
+            error       ///< The binary or expected output couldn't be loaded.
+        };
+
+        /**
+         * @brief One simulation and its results.
+         * ********************************************************************/
+        struct job
+        {
+            std::string binary;         ///< The program to run.
+            uint64_t mem_size;          ///< Its memory size.
+            uint64_t exec_limit;        ///< Its instruction limit, 0 for none.
+            std::string expected;       ///< Expected output file, or empty.
+
+            status result;              ///< How it turned out.
+            uint64_t insns;             ///< Instructions executed.
+            std::string halt_reason;    ///< Why it stopped.
+            double seconds;             ///< Wall time to load and run it.
+        };
+
+        /**
+         * @brief One thread's share of the jobs.
+         * ********************************************************************/
+        struct work_queue
+        {
+            std::mutex lock;            ///< Guards jobs.
+            std::deque<size_t> jobs;    ///< Indices into batch_runner::jobs.
+        };
+
+        /**
+         * @brief Loads and runs a single job.
+         * @param j The job, updated with its results.
+         * ********************************************************************/
+        void run_job(job &j) const;
+
+        /**
+         * @brief Runs jobs until there are none left in any queue.
+         * @param id The index of this thread's own queue.
+         * ********************************************************************/
+        void worker(size_t id);
+
+        /**
+         * @brief Takes the next job for a thread, stealing one if its own
+         *        queue is empty.
+         * @param id The index of the thread's own queue.
+         * @param j Set to the index of the job.
+         * @return false if there is no work left.
+         * ********************************************************************/
+        bool next_job(size_t id, size_t &j);
+
+        bool paged;                                     ///< Use sparse paged memory.
+        cpu_single_hart::engine exec_engine;            ///< Engine for each cpu.
+        std::vector<job> jobs;                          ///< All of the jobs.
+        std::vector<std::unique_ptr<work_queue>> queues; ///< One per thread.
+        double wall_seconds = { 0 };                    ///< Wall time of run().
+        unsigned thread_count = { 0 };                  ///< Threads used by run().
+};
+
+#endif
@@ -0,0 +1,525 @@
+//******************************************************************************
+//
+// binary_trace.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstring>
+
+#include "binary_trace.h"
+
+const char binary_trace::magic[8] = { 'R', 'V', '3', '2', 'T', 'R', 'C', 'E' };
+
+/**
+ * @brief Writes a little-endian value.
+ * @param os The stream to write to.
+ * @param v The value.
+ * @param len The size of the value in bytes.
+ * ****************************************************************************/
+static void put(std::ostream &os, uint64_t v, int len)
+{
+    for (int i = 0; i < len; ++i)
+    {
+        os.put(static_cast<char>(v >> (8 * i)));
+    }
+}
+
+/**
+ * @brief Reads a little-endian value.
+ * @param is The stream to read from.
+ * @param len The size of the value in bytes.
+ * @return The value, or 0 if the stream ran out.
+ * ****************************************************************************/
+static uint64_t get(std::istream &is, int len)
+{
+    uint8_t b[8] = { 0 };
+    is.read(reinterpret_cast<char*>(b), len);
+
+    uint64_t v = 0;
+    for (int i = len - 1; i >= 0; --i)
+    {
+        v = (v << 8) | b[i];
+    }
+    return v;
+}
+
+/**
+ * @brief Encodes an unsigned varint.
+ * @param p Where to put it.
+ * @param v The value.
+ * @return The byte after it.
+ * ****************************************************************************/
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+/**
+ * @brief Encodes a signed varint, zigzag encoded.
+ * @param p Where to put it.
+ * @param v The value.
+ * @return The byte after it.
+ * ****************************************************************************/
+static uint8_t *put_svarint(uint8_t *p, int32_t v)
+{
+    return put_varint(p, (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31));
+}
+
+// The number of bytes a load instruction reads.
+uint32_t binary_trace::load_width(uint32_t insn)
+{
+    switch (rv32i_hart::get_funct3(insn))
+    {
+        case rv32i_hart::funct3_lb:
+        case rv32i_hart::funct3_lbu:    return 1;
+        case rv32i_hart::funct3_lh:
+        case rv32i_hart::funct3_lhu:    return 2;
+        case rv32i_hart::funct3_lw:     return 4;
+    }
+    return 0;
+}
+
+// Reads what a load read, if it was inside of memory.
+int32_t binary_trace::peek(const memory &m, uint32_t addr, uint32_t len)
+{
+    switch (m.in_range(addr, len) ? len : 0)
+    {
+        case 1: return m.get8(addr);
+        case 2: return m.get16(addr);
+        case 4: return m.get32(addr);
+    }
+    return 0;
+}
+
+// Puts back what a load read, if it was inside of memory.
+void binary_trace::poke(memory &m, uint32_t addr, uint32_t len, int32_t val)
+{
+    switch (m.in_range(addr, len) ? len : 0)
+    {
+        case 1: m.set8(addr, val); break;
+        case 2: m.set16(addr, val); break;
+        case 4: m.set32(addr, val); break;
+    }
+}
+
+// Fills in a record for an instruction the hart has just executed.
+void binary_trace::capture(const rv32i_hart &h, uint32_t pc, const rv32i_hart::decoded_insn &d, uint32_t addr, int32_t old, record &r)
+{
+    r.flags = 0;
+    r.len = d.len;
+    r.pc = pc;
+    r.insn = d.len == 2 ? h.mem.get16(pc) : d.insn;
+
+    switch (d.insn & 0x7f)
+    {
+        case rv32i_hart::opcode_load_imm:
+            r.flags = rec_addr | rec_value;
+            r.addr = addr;
+            // with rd = x0 the loaded value is only in memory
+            r.value = (d.rd ? h.regs.get(d.rd) : peek(h.mem, addr, load_width(d.insn))) - old;
+            break;
+
+        case rv32i_hart::opcode_stype:
+            r.flags = rec_addr;
+            r.addr = addr;
+            break;
+
+        case rv32i_hart::opcode_system:
+            if (d.insn == rv32i_hart::insn_ecall ? !h.is_halted() : d.insn != rv32i_hart::insn_ebreak)
+            {
+                // a system call's result, or the CSR read
+                r.flags = rec_value;
+                r.value = h.regs.get(d.insn == rv32i_hart::insn_ecall ? 10 : d.rd) - old;
+            }
+            break;
+    }
+}
+
+// Fills in a record for an instruction translated code has executed.
+void binary_trace::capture(const retired_insn &ri, record &r)
+{
+    r.flags = 0;
+    r.len = ri.len;
+    r.pc = ri.pc;
+    r.insn = ri.len == 2 ? ri.raw : ri.insn;
+
+    switch (ri.insn & 0x7f)
+    {
+        case rv32i_hart::opcode_load_imm:
+            r.flags = rec_addr | rec_value;
+            r.addr = ri.addr;
+            r.value = ri.value;
+            break;
+
+        case rv32i_hart::opcode_stype:
+            r.flags = rec_addr;
+            r.addr = ri.addr;
+            break;
+    }
+}
+
+// Destructor.
+trace_writer::~trace_writer()
+{
+    finish();
+}
+
+// Opens the trace file.
+bool trace_writer::open(const std::string &name)
+{
+    out.open(name, std::ios::out|std::ios::binary|std::ios::trunc);
+
+    if (!out)
+    {
+        std::cerr << "Can't open file '" << name << "' for writing." << std::endl;
+        return false;
+    }
+
+    fname = name;
+    return true;
+}
+
+// Writes the header.
+void trace_writer::start(const rv32i_hart &h)
+{
+    out.write(magic, sizeof(magic));
+    put(out, version, 4);
+    put(out, (h.get_compressed() ? flag_compressed : 0) | (h.get_syscalls() ? flag_syscalls : 0), 4);
+    put(out, h.mem.get_size(), 8);
+    put(out, h.get_mhartid(), 4);
+    put(out, h.get_pc(), 4);
+    for (uint32_t r = 0; r < 32; ++r)
+    {
+        put(out, h.get_reg(r), 4);
+    }
+
+    next_pc = h.get_pc();
+    finished = false;
+}
+
+// Records an instruction the hart has just executed.
+void trace_writer::record(const rv32i_hart &h, uint32_t pc, const rv32i_hart::decoded_insn &d, uint32_t addr, int32_t old)
+{
+    binary_trace::record r;
+    capture(h, pc, d, addr, old, r);
+    write(r);
+}
+
+// Records a run of instructions translated code has executed.
+void trace_writer::record(const retired_insn *ri, size_t n)
+{
+    binary_trace::record r;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        capture(ri[i], r);
+        write(r);
+    }
+}
+
+// Encodes a record into the buffer.
+void trace_writer::write(const binary_trace::record &r)
+{
+    if (pos + max_record > buf.get() + buffer_size)
+    {
+        flush();
+    }
+
+    uint8_t *p = pos + 1;
+    uint8_t f = r.flags;
+
+    if (r.pc != next_pc)
+    {
+        f |= rec_pc;
+        p = put_svarint(p, r.pc - next_pc);
+    }
+    next_pc = r.pc + r.len;
+
+    seen_insn &s = seen[seen_index(r.pc)];
+    if (s.pc != r.pc || s.insn != r.insn)
+    {
+        f |= rec_insn;
+        s.pc = r.pc;
+        s.insn = r.insn;
+        p = put_varint(p, r.insn);
+    }
+
+    if (f & rec_addr)
+    {
+        p = put_svarint(p, r.addr - last_addr);
+        last_addr = r.addr;
+    }
+
+    if (f & rec_value)
+    {
+        p = put_svarint(p, r.value);
+    }
+
+    *pos = f;
+    pos = p;
+}
+
+// Writes the end of the trace and flushes it.
+bool trace_writer::finish()
+{
+    if (finished)
+        return true;
+
+    *pos++ = rec_end;
+    flush();
+    finished = true;
+
+    if (!out.flush())
+    {
+        std::cerr << "Can't write file '" << fname << "'." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Writes out the buffer.
+void trace_writer::flush()
+{
+    out.write(reinterpret_cast<const char*>(buf.get()), pos - buf.get());
+    pos = buf.get();
+}
+
+// Constructor.
+trace_replayer::trace_replayer(uint64_t mem_size, uint32_t flags, uint32_t mhartid, uint32_t pc, const int32_t *regs, bool warnings)
+    : flags(flags), mem(new memory(mem_size, true)), hart(new rv32i_hart(*mem))
+{
+    // the memory is paged, as only the locations that get loaded from are ever touched
+    mem->set_warnings(warnings);
+    hart->set_reset_pc(pc);
+    hart->reset();
+    hart->set_mhardid(mhartid);
+    hart->set_compressed(flags & flag_compressed);
+    for (uint32_t r = 1; r < 32; ++r)
+    {
+        hart->set_reg(r, regs[r]);
+    }
+}
+
+// Prints an instruction.
+bool trace_replayer::replay(const record &r, std::ostream &os, bool show_instructions, bool show_registers)
+{
+    if (hart->is_halted())
+        return false;
+
+    rv32i_hart::decoded_insn d;
+    rv32i_hart::predecode(r.len == 2 ? rv32i_hart::expand_compressed(r.insn) : r.insn, d);
+    d.len = r.len;
+
+    if (r.flags & rec_printed)
+    {
+        show_instructions = show_registers = false;
+    }
+
+    std::ostream *pos = show_instructions ? &os : nullptr;
+    int32_t value = hart->regs.get(d.rd) + r.value;
+
+    hart->insn_counter++;
+    hart->set_pc(r.pc);
+
+    if (show_registers)
+    {
+        hart->dump("", os);
+    }
+
+    if (show_instructions)
+    {
+        os << hex::to_hex32(r.pc) << ": "
+           << (d.len == 2 ? "    " + hex::to_hex16(r.insn) : hex::to_hex32(r.insn)) << "  ";
+    }
+
+    switch (d.insn & 0x7f)
+    {
+        case rv32i_hart::opcode_load_imm:
+            poke(*mem, r.addr, load_width(d.insn), value);      // where the load will find it
+            break;
+
+        case rv32i_hart::opcode_system:
+            if (d.insn == rv32i_hart::insn_ecall && (flags & flag_syscalls)
+                && host_syscalls::is_supported(hart->regs.get(17)))
+            {
+                host_syscalls::request c;
+                c.num = hart->regs.get(17);
+                c.arg[0] = hart->regs.get(10);
+                c.arg[1] = hart->regs.get(11);
+                c.arg[2] = hart->regs.get(12);
+                c.ret = r.value;
+                c.store_addr = 0;
+                c.store_len = 0;
+                c.exited = !(r.flags & rec_value);
+
+                if (show_instructions)
+                    hart->finish_ecall<true>(d, pos, c);
+                else
+                    hart->finish_ecall<false>(d, pos, c);
+
+                d.handler = nullptr;    // done
+            }
+            break;
+    }
+
+    if (d.handler)
+    {
+        (hart.get()->*(show_instructions ? rv32i_hart::get_handler<true>(d.insn) : d.handler))(d, pos);
+    }
+
+    if (show_instructions)
+    {
+        os << '\n';
+    }
+
+    return true;
+}
+
+// Opens a trace and reads its header.
+bool trace_reader::open(const std::string &name)
+{
+    in.open(name, std::ios::in|std::ios::binary);
+
+    if (!in)
+    {
+        std::cerr << "Can't open file '" << name << "' for reading." << std::endl;
+        return false;
+    }
+
+    char m[sizeof(magic)];
+    if (!in.read(m, sizeof(m)) || std::memcmp(m, magic, sizeof(magic)) != 0 || get(in, 4) != version)
+    {
+        std::cerr << "'" << name << "' is not a trace." << std::endl;
+        return false;
+    }
+
+    fname = name;
+    flags = get(in, 4);
+    uint64_t mem_size = get(in, 8);
+    uint32_t mhartid = get(in, 4);
+    next_pc = get(in, 4);
+    int32_t regs[32];
+    for (uint32_t r = 0; r < 32; ++r)
+    {
+        regs[r] = get(in, 4);
+    }
+
+    if (!in || mem_size == 0 || mem_size > uint64_t(1) << 32)
+    {
+        std::cerr << "'" << name << "' is truncated." << std::endl;
+        return false;
+    }
+
+    replayer.reset(new trace_replayer(mem_size, flags, mhartid, next_pc, regs, true));
+    return true;
+}
+
+// Prints the recorded instructions.
+int64_t trace_reader::replay(std::ostream &os, bool show_instructions, bool show_registers)
+{
+    int64_t count = 0;
+    record r;
+
+    while (read(r))
+    {
+        if (!replayer->replay(r, os, show_instructions, show_registers))
+        {
+            damaged = true;     // it goes on after a halt
+            break;
+        }
+        ++count;
+    }
+
+    os.flush();
+
+    if (damaged)
+    {
+        std::cerr << "'" << fname << "' is damaged after " << count << " instructions." << std::endl;
+        return -1;
+    }
+
+    return count;
+}
+
+// Decodes the next record.
+bool trace_reader::read(record &r)
+{
+    int f = in.get();
+
+    if (f == rec_end)
+        return false;
+
+    if (f == EOF)
+    {
+        damaged = true;     // the end is missing
+        return false;
+    }
+
+    r.flags = f & (rec_addr | rec_value);
+    r.pc = next_pc;
+    if (f & rec_pc)
+    {
+        r.pc += get_svarint();
+    }
+
+    seen_insn &s = seen[seen_index(r.pc)];
+    if (f & rec_insn)
+    {
+        s.pc = r.pc;
+        s.insn = get_varint();
+    }
+    else if (s.pc != r.pc)
+    {
+        damaged = true;
+        return false;
+    }
+
+    r.insn = s.insn;
+    r.len = (flags & flag_compressed) && rv32i_hart::is_compressed(r.insn) ? 2 : 4;
+    next_pc = r.pc + r.len;
+
+    if (f & rec_addr)
+    {
+        r.addr = last_addr += get_svarint();
+    }
+
+    r.value = (f & rec_value) ? get_svarint() : 0;
+
+    if (in.fail())
+    {
+        damaged = true;
+        return false;
+    }
+
+    return true;
+}
+
+// Reads an unsigned varint.
+uint32_t trace_reader::get_varint()
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        int b = in.get();
+        if (b == EOF)
+            break;
+
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
@@ -0,0 +1,336 @@
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+//******************************************************************************
+//
+// binary_trace.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "rv32i_hart.h"
+
+/**
+ * @brief The layout of a binary trace, shared by its writer and reader.
+ *
+ * A trace starts with a header holding what the hart looked like before
+ * the first instruction: the magic "RV32TRCE", a version, flag bits, the
+ * memory size, mhartid, pc and the 32 registers, all little-endian.
+ *
+ * Then comes one record per instruction executed. A record is a byte of
+ * rec_* flags followed by the fields they call for, each a LEB128 varint.
+ * Signed fields are zigzag encoded first so that small negative numbers
+ * stay short:
+ *
+ *     rec_pc       pc minus the address after the previous instruction
+ *     rec_insn     the instruction word as it is in memory (16 bits if
+ *                  compressed)
+ *     rec_addr     the load/store address minus the previous one
+ *     rec_value    the value a load, csrrs or ecall writes back, minus the
+ *                  value its rd held before
+ *
+ * A straight-line instruction that has been seen at the same pc before
+ * needs no pc and no instruction word, so most records are one or two
+ * bytes. The word is only written when the instruction misses in a small
+ * direct-mapped table of recently seen (pc, instruction) pairs, which the
+ * reader keeps in step. The values of all other instructions are left
+ * out, as they can be recomputed. A rec_end byte ends the trace.
+ * ****************************************************************************/
+class binary_trace
+{
+    public:
+        static constexpr uint8_t rec_pc     = 0x01;    ///< pc doesn't follow on.
+        static constexpr uint8_t rec_insn   = 0x02;    ///< The instruction word follows.
+        static constexpr uint8_t rec_addr   = 0x04;    ///< A load/store address follows.
+        static constexpr uint8_t rec_value  = 0x08;    ///< A writeback value follows.
+        static constexpr uint8_t rec_end    = 0x80;    ///< End of the trace.
+
+        /**
+         * @brief Marks a record whose instruction has already been printed
+         *        by the hart. Never appears in a file.
+         * ********************************************************************/
+        static constexpr uint8_t rec_printed = 0x40;
+
+        static constexpr uint32_t flag_compressed = 0x1;   ///< RV32C was enabled.
+        static constexpr uint32_t flag_syscalls = 0x2;     ///< A syscall layer was attached.
+
+        /**
+         * @brief One executed instruction with every field filled in, as
+         *        it is captured from the hart and as the reader decodes it.
+         * ********************************************************************/
+        struct record
+        {
+            uint8_t flags;      ///< rec_addr and rec_value tell which of addr and value are set.
+            uint8_t len;        ///< Length of the instruction in bytes (2 or 4).
+            uint32_t pc;        ///< Address of the instruction.
+            uint32_t insn;      ///< The instruction as it is in memory.
+            uint32_t addr;      ///< The load/store address.
+            int32_t value;      ///< The writeback value minus the value rd held before.
+        };
+
+        /**
+         * @brief Fills in a record for an instruction the hart has just
+         *        executed.
+         * @param h The hart.
+         * @param pc The address of the instruction.
+         * @param d The decoded instruction.
+         * @param addr rs1 + imm as it was before the instruction executed.
+         * @param old The value rd held before the instruction executed.
+         * @param r The record.
+         * ********************************************************************/
+        static void capture(const rv32i_hart &h, uint32_t pc, const rv32i_hart::decoded_insn &d, uint32_t addr, int32_t old, record &r);
+
+        /**
+         * @brief Fills in a record for an instruction that translated code
+         *        has executed and recorded for a trace. Translated code only
+         *        runs loads, stores and instructions with no value to record.
+         * @param ri The instruction as the translated code recorded it.
+         * @param r The record.
+         * ********************************************************************/
+        static void capture(const retired_insn &ri, record &r);
+
+    protected:
+        static const char magic[8];                 ///< Start of the header.
+        static constexpr uint32_t version = 1;      ///< Version of the format.
+
+        /**
+         * @brief Number of entries in the table of recently seen
+         *        instructions.
+         * ********************************************************************/
+        static constexpr uint32_t seen_size = 4096;
+
+        /**
+         * @brief An instruction seen at an address.
+         * ********************************************************************/
+        struct seen_insn
+        {
+            uint32_t pc = { 1 };    ///< Its address, odd (no instruction) if unused.
+            uint32_t insn;          ///< The instruction as it is in memory.
+        };
+
+        /**
+         * @brief The table entry an instruction address maps to.
+         * @param pc The address.
+         * @return The entry's index.
+         * ********************************************************************/
+        static uint32_t seen_index(uint32_t pc) { return (pc >> 1) % seen_size; }
+
+        /**
+         * @brief The number of bytes a load instruction reads.
+         * @param insn The load instruction.
+         * @return 1, 2 or 4, or 0 if it is illegal.
+         * ********************************************************************/
+        static uint32_t load_width(uint32_t insn);
+
+        /**
+         * @brief Reads the value a load read, for a load into x0.
+         * @param m The memory.
+         * @param addr The load address.
+         * @param len The load width.
+         * @return The value, or 0 if the load was outside of memory.
+         * ********************************************************************/
+        static int32_t peek(const memory &m, uint32_t addr, uint32_t len);
+
+        /**
+         * @brief Puts back the value a load read, so that executing the
+         *        load again reads it too.
+         * @param m The memory.
+         * @param addr The load address.
+         * @param len The load width.
+         * @param val The value. Only its low len bytes are stored.
+         * ********************************************************************/
+        static void poke(memory &m, uint32_t addr, uint32_t len, int32_t val);
+
+        /**
+         * @brief The recently seen instructions.
+         * ********************************************************************/
+        std::unique_ptr<seen_insn[]> seen { new seen_insn[seen_size] };
+
+        uint32_t next_pc = { 0 };       ///< The address after the last instruction.
+        uint32_t last_addr = { 0 };     ///< The last load/store address.
+};
+
+/**
+ * @brief Class to record the instructions a hart executes in a binary trace.
+ *
+ * Records are encoded into a large buffer that is written to the file when
+ * it fills, so recording costs little more than executing.
+ * ****************************************************************************/
+class trace_writer : public binary_trace
+{
+    public:
+        /**
+         * @brief Destructor. Ends the trace.
+         * ********************************************************************/
+        ~trace_writer();
+
+        /**
+         * @brief Opens the trace file.
+         * @param fname The file name.
+         * @return false if it can't be opened.
+         * ********************************************************************/
+        bool open(const std::string &fname);
+
+        /**
+         * @brief Writes the header. Call this once the hart has been reset
+         *        (or restored), before it executes anything.
+         * @param h The hart.
+         * ********************************************************************/
+        void start(const rv32i_hart &h);
+
+        /**
+         * @brief Records an instruction the hart has just executed.
+         * @param h The hart.
+         * @param pc The address of the instruction.
+         * @param d The decoded instruction.
+         * @param addr rs1 + imm as it was before the instruction executed.
+         * @param old The value rd held before the instruction executed.
+         * ********************************************************************/
+        void record(const rv32i_hart &h, uint32_t pc, const rv32i_hart::decoded_insn &d, uint32_t addr, int32_t old);
+
+        /**
+         * @brief Records a run of instructions that translated code has
+         *        executed.
+         * @param ri The instructions, oldest first.
+         * @param n The number of them.
+         * ********************************************************************/
+        void record(const retired_insn *ri, size_t n);
+
+        /**
+         * @brief Writes the end of the trace and flushes it to the file.
+         *        Nothing more can be recorded after this.
+         * @return false if the file couldn't be written.
+         * ********************************************************************/
+        bool finish();
+
+    private:
+        /**
+         * @brief Size of the output buffer.
+         * ********************************************************************/
+        static constexpr uint32_t buffer_size = 1024 * 1024;
+
+        /**
+         * @brief The longest a record can be: the flags and four 5-byte
+         *        varints.
+         * ********************************************************************/
+        static constexpr uint32_t max_record = 1 + 4 * 5;
+
+        /**
+         * @brief Encodes a record into the buffer.
+         * @param r The record.
+         * ********************************************************************/
+        void write(const binary_trace::record &r);
+
+        /**
+         * @brief Writes out the buffer.
+         * ********************************************************************/
+        void flush();
+
+        std::ofstream out;                                      ///< The trace file.
+        std::string fname;                                      ///< Its name.
+        std::unique_ptr<uint8_t[]> buf { new uint8_t[buffer_size] };       ///< Records not yet written.
+        uint8_t *pos = { buf.get() };                           ///< End of the records in buf.
+        bool finished = { true };                               ///< No trace open, or it has been ended.
+};
+
+/**
+ * @brief Class to print captured instructions as -i and -r would have.
+ *
+ * Each instruction is executed again on a hart of the replayer's own,
+ * which prints it exactly as the simulator would have. The registers
+ * evolve just as they did on the original hart. Memory does not, but every
+ * value loaded from it is in the record and is put in place before the
+ * load executes, and system calls take their results from the record too.
+ * ****************************************************************************/
+class trace_replayer : public binary_trace
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param mem_size The size of the original hart's memory.
+         * @param flags flag_compressed and flag_syscalls.
+         * @param mhartid The original hart's mhartid.
+         * @param pc Its pc before the first instruction.
+         * @param regs Its registers before the first instruction.
+         * @param warnings Print warnings for accesses outside of memory,
+         *        as the original hart did.
+         * ********************************************************************/
+        trace_replayer(uint64_t mem_size, uint32_t flags, uint32_t mhartid, uint32_t pc, const int32_t *regs, bool warnings);
+
+        /**
+         * @brief Prints an instruction.
+         * @param r The record of the instruction.
+         * @param os Where to print it.
+         * @param show_instructions Print the instruction, as -i does.
+         * @param show_registers Dump the registers before it, as -r does.
+         * @return false if the hart had already halted.
+         * ********************************************************************/
+        bool replay(const record &r, std::ostream &os, bool show_instructions, bool show_registers);
+
+    private:
+        uint32_t flags;                     ///< flag_compressed and flag_syscalls.
+        std::unique_ptr<memory> mem;        ///< Memory for the hart.
+        std::unique_ptr<rv32i_hart> hart;   ///< The hart that re-executes the instructions.
+};
+
+/**
+ * @brief Class to turn a binary trace back into the output of -i and -r.
+ * ****************************************************************************/
+class trace_reader : public binary_trace
+{
+    public:
+        /**
+         * @brief Opens a trace and reads its header.
+         * @param fname The file name.
+         * @return false if it can't be read or isn't a trace.
+         * ********************************************************************/
+        bool open(const std::string &fname);
+
+        /**
+         * @brief Prints the recorded instructions.
+         * @param os Where to print them.
+         * @param show_instructions Print each instruction, as -i does.
+         * @param show_registers Dump the registers before each instruction,
+         *        as -r does.
+         * @return The number of instructions read, or -1 if the trace is
+         *         damaged.
+         * ********************************************************************/
+        int64_t replay(std::ostream &os, bool show_instructions, bool show_registers);
+
+    private:
+        /**
+         * @brief Decodes the next record.
+         * @param r Where to put it.
+         * @return false at the end of the trace or if it is damaged.
+         * ********************************************************************/
+        bool read(record &r);
+
+        /**
+         * @brief Reads an unsigned varint.
+         * @return Its value.
+         * ********************************************************************/
+        uint32_t get_varint();
+
+        /**
+         * @brief Reads a zigzag encoded varint.
+         * @return Its value.
+         * ********************************************************************/
+        int32_t get_svarint() { uint32_t v = get_varint(); return (v >> 1) ^ -(v & 1); }
+
+        std::ifstream in;                           ///< The trace file.
+        std::string fname;                          ///< Its name.
+        uint32_t flags = { 0 };                     ///< flag_compressed and flag_syscalls.
+        std::unique_ptr<trace_replayer> replayer;   ///< Prints the records.
+        bool damaged = { false };                   ///< Set when the trace can't be decoded.
+};
+
+#endif
@@ -0,0 +1,352 @@
+//******************************************************************************
+//
+// branch_model.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "branch_model.h"
+
+/**
+ * @brief Formats a fraction as a percentage.
+ * @param n The part.
+ * @param of The whole.
+ * @return n / of as a percentage with two decimals.
+ * ****************************************************************************/
+static std::string percent(uint64_t n, uint64_t of)
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(2) << (of ? 100.0 * n / of : 0.0) << "%";
+    return os.str();
+}
+
+// Constructor.
+packed_table::packed_table(uint32_t bits, uint32_t entries, uint32_t init)
+    : bits(bits), per_word(32 / bits), max(bits == 32 ? ~0u : (1u << bits) - 1), entries(entries)
+{
+    words.resize((entries + per_word - 1) / per_word);
+    for (uint32_t i = 0; i < entries; ++i)
+    {
+        set(i, init);
+    }
+}
+
+// Writes a field.
+void packed_table::set(uint32_t i, uint32_t v)
+{
+    uint32_t shift = i % per_word * bits;
+    uint32_t &w = words[i / per_word];
+
+    w = (w & ~(max << shift)) | (v << shift);
+}
+
+// Moves a saturating counter one step up or down.
+void packed_table::train(uint32_t i, bool up)
+{
+    uint32_t v = get(i);
+
+    if (up && v < max)
+        set(i, v + 1);
+    else if (!up && v > 0)
+        set(i, v - 1);
+}
+
+// Constructor.
+bimodal_predictor::bimodal_predictor(uint32_t index_bits)
+    : mask((1u << index_bits) - 1), counters(2, 1u << index_bits, 1)
+{
+}
+
+// Predicts a branch from its counter.
+bool bimodal_predictor::predict(uint32_t pc, uint32_t)
+{
+    return counters.taken((pc >> 1) & mask);
+}
+
+// Trains the branch's counter.
+void bimodal_predictor::update(uint32_t pc, bool taken)
+{
+    counters.train((pc >> 1) & mask, taken);
+}
+
+// Constructor.
+gshare_predictor::gshare_predictor(uint32_t index_bits)
+    : index_bits(index_bits), mask((1u << index_bits) - 1), counters(2, 1u << index_bits, 1)
+{
+}
+
+// Predicts a branch from the counter its address and the history pick.
+bool gshare_predictor::predict(uint32_t pc, uint32_t)
+{
+    index = ((pc >> 1) ^ history) & mask;
+    return counters.taken(index);
+}
+
+// Trains the counter predict() used and adds the branch to the history.
+void gshare_predictor::update(uint32_t, bool taken)
+{
+    counters.train(index, taken);
+    history = ((history << 1) | taken) & mask;
+}
+
+const uint32_t tage_predictor::history_lengths[tage_predictor::tables] = { 4, 10, 24, 64 };
+
+// Constructor.
+tage_predictor::tage_predictor() : base(2, 1u << base_bits, 1)
+{
+    for (uint32_t t = 0; t < tables; ++t)
+    {
+        ctrs.emplace_back(3, 1u << index_bits, 3);
+        useful.emplace_back(2, 1u << index_bits, 0);
+        tags.emplace_back(1u << index_bits, 0);
+    }
+}
+
+// Folds the newest bits of the history down to a narrower width.
+uint32_t tage_predictor::fold(uint32_t length, uint32_t width) const
+{
+    uint64_t h = length < 64 ? history & ((uint64_t(1) << length) - 1) : history;
+    uint32_t folded = 0;
+
+    while (h)
+    {
+        folded ^= h & ((1u << width) - 1);
+        h >>= width;
+    }
+    return folded;
+}
+
+// Predicts a branch from the longest history with a matching tag.
+bool tage_predictor::predict(uint32_t pc, uint32_t)
+{
+    uint32_t addr = pc >> 1;
+
+    base_index = addr & ((1u << base_bits) - 1);
+    provider = -1;
+    provider_pred = alt_pred = base.taken(base_index);
+
+    for (uint32_t t = 0; t < tables; ++t)
+    {
+        uint32_t len = history_lengths[t];
+
+        index[t] = (addr ^ (addr >> index_bits) ^ fold(len, index_bits)) & ((1u << index_bits) - 1);
+        tag[t] = (addr ^ fold(len, tag_bits) ^ (fold(len, tag_bits - 1) << 1)) & ((1u << tag_bits) - 1);
+
+        if (tags[t][index[t]] == tag[t])
+        {
+            alt_pred = provider_pred;
+            provider = t;
+            provider_pred = ctrs[t].taken(index[t]);
+        }
+    }
+    return provider_pred;
+}
+
+// Trains the provider, and allocates a longer history on a misprediction.
+void tage_predictor::update(uint32_t, bool taken)
+{
+    if (provider < 0)
+    {
+        base.train(base_index, taken);
+    }
+    else
+    {
+        ctrs[provider].train(index[provider], taken);
+        if (provider_pred != alt_pred)
+        {
+            useful[provider].train(index[provider], provider_pred == taken);
+        }
+    }
+
+    if (provider_pred != taken && provider < int(tables) - 1)
+    {
+        bool allocated = false;
+        for (uint32_t t = provider + 1; t < tables && !allocated; ++t)
+        {
+            if (useful[t].get(index[t]) == 0)
+            {
+                tags[t][index[t]] = tag[t];
+                ctrs[t].set(index[t], taken ? 4 : 3);   // weakly in the direction just seen
+                allocated = true;
+            }
+        }
+
+        // every candidate is useful, so age them to make room next time
+        for (uint32_t t = provider + 1; t < tables && !allocated; ++t)
+        {
+            useful[t].train(index[t], false);
+        }
+    }
+
+    if (++branches == decay_period)
+    {
+        branches = 0;
+        for (auto &u : useful)
+        {
+            for (uint32_t i = 0; i < (1u << index_bits); ++i)
+            {
+                u.train(i, false);
+            }
+        }
+    }
+
+    history = (history << 1) | taken;
+}
+
+// The size of the predictor's tables.
+uint64_t tage_predictor::size_bits() const
+{
+    uint64_t bits = base.size_bits() + 64;
+
+    for (uint32_t t = 0; t < tables; ++t)
+    {
+        bits += ctrs[t].size_bits() + useful[t].size_bits() + tags[t].size() * tag_bits;
+    }
+    return bits;
+}
+
+// Constructor.
+branch_model::branch_model(const symbol_table &syms) : syms(syms), ras(ras_depth)
+{
+    predictors.emplace_back(new static_predictor);
+    predictors.emplace_back(new bimodal_predictor(12));
+    predictors.emplace_back(new gshare_predictor(12));
+    predictors.emplace_back(new tage_predictor);
+    misses.resize(predictors.size());
+}
+
+// Predicts a branch, call or return with every predictor.
+void branch_model::retired(const retired_insn &r)
+{
+    switch (get_opcode(r.insn))
+    {
+        case opcode_btype:
+        {
+            uint32_t target = r.pc + get_imm_b(r.insn);
+            bool was_taken = r.next_pc != r.pc + r.len;
+
+            site &s = sites[r.pc];
+            if (s.misses.empty())
+            {
+                s.misses.resize(predictors.size());
+            }
+
+            ++branches;
+            ++s.executed;
+            if (was_taken)
+            {
+                ++taken;
+                ++s.taken;
+            }
+
+            for (size_t i = 0; i < predictors.size(); ++i)
+            {
+                if (predictors[i]->predict(r.pc, target) != was_taken)
+                {
+                    ++misses[i];
+                    ++s.misses[i];
+                }
+                predictors[i]->update(r.pc, was_taken);
+            }
+            break;
+        }
+
+        case opcode_jal:
+        case opcode_jalr:
+            ++jumps;
+
+            if (is_return(r))
+            {
+                ++returns;
+                if (ras_count == 0 || ras[ras_top] != r.next_pc)
+                {
+                    ++ras_misses;
+                }
+                if (ras_count)
+                {
+                    ras_top = (ras_top + ras_depth - 1) % ras_depth;
+                    --ras_count;
+                }
+            }
+            else if (is_call(r))
+            {
+                ras_top = (ras_top + 1) % ras_depth;
+                ras[ras_top] = r.pc + r.len;    // the oldest is lost when full
+                if (ras_count < ras_depth)
+                    ++ras_count;
+            }
+            break;
+    }
+}
+
+// Prints the misprediction rates.
+void branch_model::report(std::ostream &os) const
+{
+    os << std::left << std::setw(24) << "Branch predictor" << std::right << std::setw(14) << "predictions"
+       << std::setw(14) << "mispredicts" << std::setw(9) << "miss %" << std::setw(10) << "bytes" << std::endl;
+
+    for (size_t i = 0; i < predictors.size(); ++i)
+    {
+        os << "  " << std::left << std::setw(22) << predictors[i]->name() << std::right << std::setw(14) << branches
+           << std::setw(14) << misses[i] << std::setw(9) << percent(misses[i], branches)
+           << std::setw(10) << (predictors[i]->size_bits() + 7) / 8 << std::endl;
+    }
+    os << "  " << std::left << std::setw(22) << ("ras (" + std::to_string(ras_depth) + " deep)") << std::right
+       << std::setw(14) << returns << std::setw(14) << ras_misses << std::setw(9) << percent(ras_misses, returns)
+       << std::setw(10) << ras_depth * 4 << std::endl;
+    os << "  " << branches << " conditional branches (" << percent(taken, branches) << " taken), "
+       << jumps << " jal/jalr" << std::endl;
+
+    // the branches mispredicted most, over all the predictors
+    std::vector<std::pair<uint64_t, uint32_t>> hot;
+    for (const auto &s : sites)
+    {
+        uint64_t n = 0;
+        for (uint64_t m : s.second.misses)
+        {
+            n += m;
+        }
+        hot.emplace_back(n, s.first);
+    }
+    std::sort(hot.begin(), hot.end(), [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    if (hot.size() > hot_branches)
+    {
+        hot.resize(hot_branches);
+    }
+
+    os << std::left << std::setw(10) << "pc" << std::right << std::setw(14) << "executed" << std::setw(9) << "taken %";
+    for (const auto &p : predictors)
+    {
+        os << std::setw(9) << p->name();
+    }
+    os << std::endl;
+
+    for (const auto &h : hot)
+    {
+        const site &s = sites.at(h.second);
+
+        os << std::left << std::setw(10) << to_hex32(h.second) << std::right << std::setw(14) << s.executed
+           << std::setw(9) << percent(s.taken, s.executed);
+        for (uint64_t m : s.misses)
+        {
+            os << std::setw(9) << percent(m, s.executed);
+        }
+        if (const symbol_table::symbol *sym = syms.lookup(h.second))
+        {
+            os << "  " << sym->name << "+" << to_hex0x32(h.second - sym->addr);
+        }
+        os << std::endl;
+    }
+}
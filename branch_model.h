@@ -0,0 +1,309 @@
+#ifndef BRANCH_MODEL_H
+#define BRANCH_MODEL_H
+
+//******************************************************************************
+//
+// branch_model.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hart_observer.h"
+#include "symbol_table.h"
+
+/**
+ * @brief Class to hold a table of small unsigned fields packed side by side
+ *        in 32-bit words, such as the 2-bit counters of a predictor.
+ * ****************************************************************************/
+class packed_table
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param bits The width of each field, from 1 to 32.
+         * @param entries The number of fields.
+         * @param init The value every field starts with.
+         * ********************************************************************/
+        packed_table(uint32_t bits, uint32_t entries, uint32_t init);
+
+        /**
+         * @brief Reads a field.
+         * @param i The index of the field.
+         * @return Its value.
+         * ********************************************************************/
+        uint32_t get(uint32_t i) const { return (words[i / per_word] >> (i % per_word * bits)) & max; }
+
+        /**
+         * @brief Writes a field.
+         * @param i The index of the field.
+         * @param v Its new value, which must fit in the field.
+         * ********************************************************************/
+        void set(uint32_t i, uint32_t v);
+
+        /**
+         * @brief Moves a field, used as a saturating counter, one step up
+         *        or down.
+         * @param i The index of the field.
+         * @param up true to count up, false to count down.
+         * ********************************************************************/
+        void train(uint32_t i, bool up);
+
+        /**
+         * @brief Is a field, used as a saturating counter, in its upper
+         *        half?
+         * @param i The index of the field.
+         * @return true if it predicts taken.
+         * ********************************************************************/
+        bool taken(uint32_t i) const { return get(i) > max / 2; }
+
+        /**
+         * @brief Accessor for the size of the table.
+         * @return The bits the fields take up.
+         * ********************************************************************/
+        uint64_t size_bits() const { return uint64_t(entries) * bits; }
+
+    private:
+        uint32_t bits;                  ///< Width of each field.
+        uint32_t per_word;              ///< Fields in each word.
+        uint32_t max;                   ///< The largest value a field holds.
+        uint32_t entries;               ///< Number of fields.
+        std::vector<uint32_t> words;    ///< The fields.
+};
+
+/**
+ * @brief Base class for conditional branch direction predictors.
+ *
+ * For every conditional branch predict() is called first and update()
+ * straight after with the outcome, so a predictor may keep what it looked
+ * up in predict() for update() to use.
+ * ****************************************************************************/
+class branch_predictor
+{
+    public:
+        /**
+         * @brief Destructor.
+         * ********************************************************************/
+        virtual ~branch_predictor() { }
+
+        /**
+         * @brief Accessor for the predictor's name.
+         * @return The name it is reported under.
+         * ********************************************************************/
+        virtual const char *name() const = 0;
+
+        /**
+         * @brief Predicts a branch's direction.
+         * @param pc The address of the branch.
+         * @param target The address it goes to if taken.
+         * @return true to predict taken.
+         * ********************************************************************/
+        virtual bool predict(uint32_t pc, uint32_t target) = 0;
+
+        /**
+         * @brief Trains the predictor on the branch last predicted.
+         * @param pc The address of the branch.
+         * @param taken true if the branch was taken.
+         * ********************************************************************/
+        virtual void update(uint32_t pc, bool taken) = 0;
+
+        /**
+         * @brief Accessor for the size of the predictor's state.
+         * @return Its tables' size in bits.
+         * ********************************************************************/
+        virtual uint64_t size_bits() const = 0;
+};
+
+/**
+ * @brief Predicts backward branches (loops) taken and forward branches not
+ *        taken, with no state at all.
+ * ****************************************************************************/
+class static_predictor : public branch_predictor
+{
+    public:
+        const char *name() const override { return "static"; }
+        bool predict(uint32_t pc, uint32_t target) override { return target < pc; }
+        void update(uint32_t, bool) override { }
+        uint64_t size_bits() const override { return 0; }
+};
+
+/**
+ * @brief Predicts each branch from a 2-bit saturating counter chosen by
+ *        its address.
+ * ****************************************************************************/
+class bimodal_predictor : public branch_predictor
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param index_bits log2 of the number of counters.
+         * ********************************************************************/
+        bimodal_predictor(uint32_t index_bits);
+
+        const char *name() const override { return "bimodal"; }
+        bool predict(uint32_t pc, uint32_t target) override;
+        void update(uint32_t pc, bool taken) override;
+        uint64_t size_bits() const override { return counters.size_bits(); }
+
+    private:
+        uint32_t mask;              ///< The number of counters, less one.
+        packed_table counters;      ///< The 2-bit counters.
+};
+
+/**
+ * @brief Predicts each branch from a 2-bit saturating counter chosen by
+ *        its address exclusive-ored with the directions of the most recent
+ *        branches.
+ * ****************************************************************************/
+class gshare_predictor : public branch_predictor
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param index_bits log2 of the number of counters, which is also
+         *        the number of branches of history kept.
+         * ********************************************************************/
+        gshare_predictor(uint32_t index_bits);
+
+        const char *name() const override { return "gshare"; }
+        bool predict(uint32_t pc, uint32_t target) override;
+        void update(uint32_t pc, bool taken) override;
+        uint64_t size_bits() const override { return counters.size_bits() + index_bits; }
+
+    private:
+        uint32_t index_bits;        ///< Bits of history, and of the counters' index.
+        uint32_t mask;              ///< The number of counters, less one.
+        uint32_t history = { 0 };   ///< The most recent branches' directions, newest in bit 0.
+        uint32_t index = { 0 };     ///< The counter predict() last used.
+        packed_table counters;      ///< The 2-bit counters.
+};
+
+/**
+ * @brief A small TAGE predictor: a bimodal base table backed by tagged
+ *        tables indexed by geometrically longer global histories.
+ *
+ * The longest history whose table holds a matching tag provides the
+ * prediction. A misprediction allocates an entry in a longer table whose
+ * useful counter is zero, and the useful counters are decayed now and then
+ * so that stale entries can be replaced.
+ * ****************************************************************************/
+class tage_predictor : public branch_predictor
+{
+    public:
+        /**
+         * @brief Constructor.
+         * ********************************************************************/
+        tage_predictor();
+
+        const char *name() const override { return "tage"; }
+        bool predict(uint32_t pc, uint32_t target) override;
+        void update(uint32_t pc, bool taken) override;
+        uint64_t size_bits() const override;
+
+    private:
+        static constexpr uint32_t tables = 4;           ///< The number of tagged tables.
+        static constexpr uint32_t base_bits = 12;       ///< log2 of the base table's counters.
+        static constexpr uint32_t index_bits = 10;      ///< log2 of each tagged table's entries.
+        static constexpr uint32_t tag_bits = 8;         ///< Width of a tag.
+        static constexpr uint32_t decay_period = 1 << 18;   ///< Branches between decays of the useful counters.
+        static const uint32_t history_lengths[tables];  ///< Branches of history each tagged table uses, shortest first.
+
+        /**
+         * @brief Folds the newest bits of the history down to a narrower
+         *        width by exclusive-oring them together.
+         * @param length How many branches of history to fold.
+         * @param width The width to fold them to.
+         * @return The folded history.
+         * ********************************************************************/
+        uint32_t fold(uint32_t length, uint32_t width) const;
+
+        uint64_t history = { 0 };       ///< The most recent branches' directions, newest in bit 0.
+        uint32_t branches = { 0 };      ///< Branches since the last decay.
+
+        packed_table base;              ///< The base table's 2-bit counters.
+        std::vector<packed_table> ctrs; ///< Each tagged table's 3-bit counters.
+        std::vector<packed_table> useful;   ///< Each tagged table's 2-bit useful counters.
+        std::vector<std::vector<uint8_t>> tags; ///< Each tagged table's tags.
+
+        // what predict() looked up, for update()
+        uint32_t base_index = { 0 };    ///< The base table's counter.
+        uint32_t index[tables];         ///< Each tagged table's entry.
+        uint8_t tag[tables];            ///< Each tagged table's tag.
+        int provider = { -1 };          ///< The table that provided the prediction, -1 for the base.
+        bool provider_pred = { false }; ///< The provider's prediction.
+        bool alt_pred = { false };      ///< What the next shorter match would have predicted.
+};
+
+/**
+ * @brief Class to run every branch and jump a hart executes through several
+ *        predictors side by side.
+ *
+ * Conditional branches are predicted by a static, a bimodal, a gshare and
+ * a TAGE predictor, each counting its mispredictions overall and per
+ * branch. Returns are predicted by a return address stack that follows the
+ * calling convention: a jal or jalr that links to ra (or t0) pushes the
+ * return address, and a jalr through ra (or t0) that doesn't link pops it.
+ * ****************************************************************************/
+class branch_model : public hart_observer
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param syms The program's symbols, for naming the branches
+         *        reported. May be empty.
+         * ********************************************************************/
+        branch_model(const symbol_table &syms);
+
+        /**
+         * @brief Predicts a branch, call or return and counts whether each
+         *        predictor got it right.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override;
+
+        /**
+         * @brief Prints each predictor's misprediction rate, then the
+         *        branches mispredicted most.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+    private:
+        static constexpr uint32_t ras_depth = 16;       ///< Return addresses the stack holds.
+        static constexpr size_t hot_branches = 20;      ///< The number of branches report() lists.
+
+        /**
+         * @brief The counts for one branch.
+         * ********************************************************************/
+        struct site
+        {
+            uint64_t executed = { 0 };      ///< Times it was executed.
+            uint64_t taken = { 0 };         ///< Times it was taken.
+            std::vector<uint64_t> misses;   ///< Each predictor's mispredictions of it.
+        };
+
+        const symbol_table &syms;                                   ///< The program's symbols.
+        std::vector<std::unique_ptr<branch_predictor>> predictors;  ///< The conditional branch predictors.
+        std::vector<uint64_t> misses;                               ///< Each predictor's mispredictions.
+        std::unordered_map<uint32_t, site> sites;                   ///< The counts for each branch, by address.
+        uint64_t branches = { 0 };                                  ///< Conditional branches executed.
+        uint64_t taken = { 0 };                                     ///< Conditional branches taken.
+        uint64_t jumps = { 0 };                                     ///< jal and jalr executed, returns included.
+
+        std::vector<uint32_t> ras;          ///< The return address stack, used as a ring.
+        uint32_t ras_top = { 0 };           ///< The index of the newest return address.
+        uint32_t ras_count = { 0 };         ///< Return addresses on the stack, up to ras_depth.
+        uint64_t returns = { 0 };           ///< Returns executed.
+        uint64_t ras_misses = { 0 };        ///< Returns the stack mispredicted.
+};
+
+#endif
@@ -0,0 +1,301 @@
+//******************************************************************************
+//
+// cache_model.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include "cache_model.h"
+
+/**
+ * @brief Is a number a power of two?
+ * @param n The number.
+ * @return true if it is, false if it is 0 or not a power of two.
+ * ****************************************************************************/
+static bool is_pow2(uint64_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+/**
+ * @brief The base-2 logarithm of a power of two.
+ * @param n The power of two.
+ * @return log2(n).
+ * ****************************************************************************/
+static uint32_t ilog2(uint32_t n)
+{
+    uint32_t bits = 0;
+    while (n >>= 1)
+    {
+        ++bits;
+    }
+    return bits;
+}
+
+// Parses a cache description.
+bool cache::parse(const std::string &spec, config &c)
+{
+    std::istringstream iss(spec);
+    std::string size, assoc, line, policy, write;
+
+    if (!std::getline(iss, size, ':') || !std::getline(iss, assoc, ':') || !std::getline(iss, line, ':'))
+        return false;
+    std::getline(iss, policy, ':');
+    std::getline(iss, write, ':');
+    std::string extra;
+    if (std::getline(iss, extra, ':'))
+        return false;
+
+    config n = c;
+    uint64_t scale = 1;
+    char *end;
+
+    if (!size.empty() && (size.back() == 'k' || size.back() == 'K'))
+        scale = 1024;
+    else if (!size.empty() && (size.back() == 'm' || size.back() == 'M'))
+        scale = 1024 * 1024;
+    if (scale != 1)
+        size.pop_back();
+
+    uint64_t bytes = std::strtoull(size.c_str(), &end, 0) * scale;
+    if (size.empty() || *end || bytes > (uint64_t(1) << 31))
+        return false;
+    n.size = bytes;
+
+    n.assoc = std::strtoul(assoc.c_str(), &end, 0);
+    if (assoc.empty() || *end)
+        return false;
+
+    n.line = std::strtoul(line.c_str(), &end, 0);
+    if (line.empty() || *end)
+        return false;
+
+    if (policy == "lru")
+        n.policy = replacement::lru;
+    else if (policy == "fifo")
+        n.policy = replacement::fifo;
+    else if (policy == "random")
+        n.policy = replacement::random;
+    else if (!policy.empty())
+        return false;
+
+    if (write == "wb")
+        n.write = write_policy::back;
+    else if (write == "wt")
+        n.write = write_policy::through;
+    else if (!write.empty())
+        return false;
+
+    if (!is_pow2(n.size) || !is_pow2(n.assoc) || !is_pow2(n.line) || n.line < 4 || n.assoc > 256
+        || uint64_t(n.assoc) * n.line > n.size)
+        return false;
+
+    c = n;
+    return true;
+}
+
+// Constructor.
+cache::cache(const std::string &name, const config &c, cache *next)
+    : name(name), cfg(c), next(next), line_bits(ilog2(c.line)), set_mask(c.size / (c.assoc * c.line) - 1)
+{
+    lines.assign(c.size / c.line, 0);
+    order.resize(lines.size());
+
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i % c.assoc;
+    }
+}
+
+// Looks up the line holding an address.
+void cache::access(uint32_t addr, bool write)
+{
+    write ? ++writes : ++reads;
+
+    uint32_t block = addr >> line_bits;
+    uint32_t set = (block & set_mask) * cfg.assoc;
+    uint32_t want = (block << tag_shift) | valid;
+
+    for (uint32_t way = 0; way < cfg.assoc; ++way)
+    {
+        if ((lines[set + way] & ~dirty) == want)
+        {
+            if (cfg.policy == replacement::lru)
+            {
+                touch(set, way);
+            }
+
+            if (write)
+            {
+                if (cfg.write == write_policy::back)
+                    lines[set + way] |= dirty;
+                else if (next)
+                    next->access(addr, true);
+            }
+            return;
+        }
+    }
+
+    ++misses;
+
+    if (write && cfg.write == write_policy::through)
+    {
+        if (next)
+        {
+            next->access(addr, true);   // no-write-allocate
+        }
+        return;
+    }
+
+    uint32_t way = victim(set);
+    uint32_t &l = lines[set + way];
+
+    if (l & valid)
+    {
+        ++evictions;
+        if (l & dirty)
+        {
+            ++writebacks;
+            if (next)
+            {
+                next->access((l >> tag_shift) << line_bits, true);
+            }
+        }
+    }
+
+    if (next)
+    {
+        next->access(block << line_bits, false);    // fill the line
+    }
+
+    l = want | (write ? dirty : 0);
+    touch(set, way);
+}
+
+// Chooses the way to fill in a set.
+uint32_t cache::victim(uint32_t set)
+{
+    for (uint32_t way = 0; way < cfg.assoc; ++way)
+    {
+        if (!(lines[set + way] & valid))
+            return way;
+    }
+
+    if (cfg.policy == replacement::random)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng & (cfg.assoc - 1);
+    }
+
+    // lru and fifo both replace the oldest, they differ in what renews a line
+    for (uint32_t way = 0; way < cfg.assoc; ++way)
+    {
+        if (order[set + way] == cfg.assoc - 1)
+            return way;
+    }
+    return 0;
+}
+
+// Moves a way to the front of its set's replacement order.
+void cache::touch(uint32_t set, uint32_t way)
+{
+    uint8_t age = order[set + way];
+
+    for (uint32_t w = 0; w < cfg.assoc; ++w)
+    {
+        if (order[set + w] < age)
+        {
+            ++order[set + w];
+        }
+    }
+    order[set + way] = 0;
+}
+
+// Prints the heading of the table report() prints a row of.
+void cache::report_heading(std::ostream &os)
+{
+    os << std::left << std::setw(6) << "Cache" << std::right << std::setw(8) << "size" << std::setw(6) << "ways"
+       << std::setw(6) << "line" << std::setw(8) << "policy" << std::setw(6) << "write" << std::setw(14) << "accesses"
+       << std::setw(14) << "hits" << std::setw(14) << "misses" << std::setw(9) << "miss %" << std::setw(12) << "evictions"
+       << std::setw(12) << "writebacks" << std::endl;
+}
+
+// Prints the cache's shape and counts as a row of a table.
+void cache::report(std::ostream &os) const
+{
+    static const char *const policies[] = { "lru", "fifo", "random" };
+    uint64_t accesses = reads + writes;
+
+    std::ostringstream size, pct;
+    if (cfg.size % (1024 * 1024) == 0)
+        size << cfg.size / (1024 * 1024) << "M";
+    else if (cfg.size % 1024 == 0)
+        size << cfg.size / 1024 << "K";
+    else
+        size << cfg.size;
+    pct << std::fixed << std::setprecision(2) << (accesses ? 100.0 * misses / accesses : 0.0) << "%";
+
+    os << std::left << std::setw(6) << name << std::right << std::setw(8) << size.str() << std::setw(6) << cfg.assoc
+       << std::setw(6) << cfg.line << std::setw(8) << policies[static_cast<int>(cfg.policy)]
+       << std::setw(6) << (cfg.write == write_policy::back ? "wb" : "wt") << std::setw(14) << accesses
+       << std::setw(14) << accesses - misses << std::setw(14) << misses << std::setw(9) << pct.str()
+       << std::setw(12) << evictions << std::setw(12) << writebacks << std::endl;
+}
+
+// Constructor.
+cache_model::cache_model(const cache::config &l1i, const cache::config &l1d, const cache::config *l2)
+    : l2(l2 ? new cache("L2", *l2, nullptr) : nullptr), l1i("L1I", l1i, this->l2.get()), l1d("L1D", l1d, this->l2.get())
+{
+}
+
+// Runs an instruction's fetch, and its load or store, through the caches.
+void cache_model::retired(const retired_insn &r)
+{
+    access(l1i, r.pc, r.len, false);
+
+    switch (get_opcode(r.insn))
+    {
+        case opcode_load_imm:
+            access(l1d, r.addr, 1 << (get_funct3(r.insn) & 3), false);
+            break;
+
+        case opcode_stype:
+            access(l1d, r.addr, 1 << (get_funct3(r.insn) & 3), true);
+            break;
+    }
+}
+
+// Accesses every line a range of bytes touches.
+void cache_model::access(cache &c, uint32_t addr, uint32_t len, bool write)
+{
+    uint32_t line = c.get_line_size();
+
+    c.access(addr, write);
+    if ((addr & (line - 1)) + len > line)
+    {
+        c.access((addr | (line - 1)) + 1, write);   // misaligned across two lines
+    }
+}
+
+// Prints each cache's hits, misses and evictions.
+void cache_model::report(std::ostream &os) const
+{
+    cache::report_heading(os);
+    l1i.report(os);
+    l1d.report(os);
+    if (l2)
+    {
+        l2->report(os);
+    }
+}
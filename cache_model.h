@@ -0,0 +1,190 @@
+#ifndef CACHE_MODEL_H
+#define CACHE_MODEL_H
+
+//******************************************************************************
+//
+// cache_model.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hart_observer.h"
+
+/**
+ * @brief Class to model one level of a set-associative cache.
+ *
+ * Only the tags are kept, so the model says whether each access hits but
+ * never holds any data. A line's tag, valid and dirty bits are packed into
+ * one word, and its place in the replacement order into a byte, so a set
+ * is scanned without leaving a cache line or two of the host's.
+ * ****************************************************************************/
+class cache
+{
+    public:
+        /**
+         * @brief How a victim is chosen from a full set.
+         * ********************************************************************/
+        enum class replacement
+        {
+            lru,        ///< The least recently used line.
+            fifo,       ///< The line filled longest ago.
+            random      ///< Any line.
+        };
+
+        /**
+         * @brief What happens on a write.
+         * ********************************************************************/
+        enum class write_policy
+        {
+            back,       ///< Write-back, write-allocate: lines are dirtied and written out when evicted.
+            through     ///< Write-through, no-write-allocate: every write goes on to the next level.
+        };
+
+        /**
+         * @brief The shape of a cache.
+         * ********************************************************************/
+        struct config
+        {
+            uint32_t size = { 32 * 1024 };                  ///< Capacity in bytes.
+            uint32_t assoc = { 4 };                         ///< Lines per set.
+            uint32_t line = { 64 };                         ///< Line size in bytes.
+            replacement policy = { replacement::lru };      ///< Replacement policy.
+            write_policy write = { write_policy::back };    ///< Write policy.
+        };
+
+        /**
+         * @brief Parses a cache description of the form
+         *        size:assoc:line[:lru|fifo|random[:wb|wt]], where size may
+         *        end in k or m.
+         * @param spec The description.
+         * @param c Where to put it. Fields that spec leaves out are left as
+         *        they are.
+         * @return false if spec is malformed, or the sizes aren't powers of
+         *         two that make at least one set.
+         * ********************************************************************/
+        static bool parse(const std::string &spec, config &c);
+
+        /**
+         * @brief Constructor.
+         * @param name Its name in the report.
+         * @param c Its shape. Must have been checked by parse().
+         * @param next The next level out, or nullptr if misses go to memory.
+         * ********************************************************************/
+        cache(const std::string &name, const config &c, cache *next);
+
+        /**
+         * @brief Looks up the line holding an address, filling it on a
+         *        miss as the write policy says.
+         * @param addr The address.
+         * @param write true for a store.
+         * ********************************************************************/
+        void access(uint32_t addr, bool write);
+
+        /**
+         * @brief Prints the cache's shape and counts as a row of a table.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const;
+
+        /**
+         * @brief Prints the heading of the table report() prints a row of.
+         * @param os Where to print it.
+         * ********************************************************************/
+        static void report_heading(std::ostream &os);
+
+        /**
+         * @brief Accessor for line.
+         * @return The line size in bytes.
+         * ********************************************************************/
+        uint32_t get_line_size() const { return cfg.line; }
+
+    private:
+        static constexpr uint32_t valid = 0x1;     ///< The line holds something.
+        static constexpr uint32_t dirty = 0x2;     ///< The line has been written to since it was filled.
+        static constexpr uint32_t tag_shift = 2;   ///< Where the tag starts in a line's word.
+
+        /**
+         * @brief Chooses the way to fill in a set.
+         * @param set The index of the set's first line.
+         * @return The way.
+         * ********************************************************************/
+        uint32_t victim(uint32_t set);
+
+        /**
+         * @brief Moves a way to the front of its set's replacement order.
+         * @param set The index of the set's first line.
+         * @param way The way.
+         * ********************************************************************/
+        void touch(uint32_t set, uint32_t way);
+
+        std::string name;               ///< Its name in the report.
+        config cfg;                     ///< Its shape.
+        cache *next;                    ///< The next level out, if any.
+        uint32_t line_bits;             ///< log2 of the line size.
+        uint32_t set_mask;              ///< The number of sets, less one.
+        uint32_t rng = { 0x2545f491 };  ///< State of the random replacement policy.
+
+        std::vector<uint32_t> lines;    ///< Tag, valid and dirty bits of each line, set by set.
+        std::vector<uint8_t> order;     ///< Each line's place in its set's replacement order, 0 = newest.
+
+        uint64_t reads = { 0 };         ///< Read accesses.
+        uint64_t writes = { 0 };        ///< Write accesses.
+        uint64_t misses = { 0 };        ///< Accesses that missed.
+        uint64_t evictions = { 0 };     ///< Valid lines replaced.
+        uint64_t writebacks = { 0 };    ///< Dirty lines written out.
+};
+
+/**
+ * @brief Class to run the fetches, loads and stores of a hart through
+ *        separate L1 instruction and data caches and, optionally, a
+ *        unified L2 cache behind them.
+ * ****************************************************************************/
+class cache_model : public hart_observer
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param l1i The shape of the L1 instruction cache.
+         * @param l1d The shape of the L1 data cache.
+         * @param l2 The shape of the L2 cache, or nullptr for none.
+         * ********************************************************************/
+        cache_model(const cache::config &l1i, const cache::config &l1d, const cache::config *l2);
+
+        /**
+         * @brief Runs an instruction's fetch, and its load or store if it
+         *        has one, through the caches.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override;
+
+        /**
+         * @brief Prints each cache's hits, misses and evictions.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+    private:
+        /**
+         * @brief Accesses every line a range of bytes touches.
+         * @param c The cache.
+         * @param addr The first byte.
+         * @param len The number of bytes.
+         * @param write true for a store.
+         * ********************************************************************/
+        static void access(cache &c, uint32_t addr, uint32_t len, bool write);
+
+        std::unique_ptr<cache> l2;      ///< The L2 cache, if any.
+        cache l1i;                      ///< The L1 instruction cache.
+        cache l1d;                      ///< The L1 data cache.
+};
+
+#endif
@@ -0,0 +1,251 @@
+//******************************************************************************
+//
+// checkpoint.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstring>
+#include <fstream>
+
+#include "checkpoint.h"
+
+static const char magic[8] = { 'R', 'V', '3', '2', 'C', 'K', 'P', 'T' };
+static constexpr uint32_t version = 1;
+
+/**
+ * @brief Writes a little-endian value.
+ * @param os The stream to write to.
+ * @param v The value.
+ * @param len The size of the value in bytes.
+ * ****************************************************************************/
+static void put(std::ostream &os, uint64_t v, int len)
+{
+    for (int i = 0; i < len; ++i)
+    {
+        os.put(static_cast<char>(v >> (8 * i)));
+    }
+}
+
+/**
+ * @brief Reads a little-endian value.
+ * @param is The stream to read from.
+ * @param len The size of the value in bytes.
+ * @return The value, or 0 if the stream ran out.
+ * ****************************************************************************/
+static uint64_t get(std::istream &is, int len)
+{
+    uint8_t b[8] = { 0 };
+    is.read(reinterpret_cast<char*>(b), len);
+
+    uint64_t v = 0;
+    for (int i = len - 1; i >= 0; --i)
+    {
+        v = (v << 8) | b[i];
+    }
+    return v;
+}
+
+// Saves the state of a simulation.
+bool checkpoint::save(const std::string &fname, const cpu_single_hart &cpu, const memory &mem, const host_syscalls &sys)
+{
+    static const std::vector<uint8_t> untouched(memory::page_size, 0xa5);
+    std::vector<uint8_t> buf(memory::page_size);
+
+    // find the pages worth saving
+    std::vector<uint32_t> saved;
+    for (uint64_t addr = 0; addr < mem.get_size(); addr += memory::page_size)
+    {
+        if (!mem.is_mapped(addr))
+            continue;
+
+        uint64_t n = std::min<uint64_t>(memory::page_size, mem.get_size() - addr);
+        mem.copy_out(addr, buf.data(), n);
+
+        if (std::memcmp(buf.data(), untouched.data(), n) != 0)
+            saved.push_back(addr / memory::page_size);
+    }
+
+    std::ofstream out(fname, std::ios::out|std::ios::binary|std::ios::trunc);
+
+    if (!out)
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing." << std::endl;
+        return false;
+    }
+
+    out.write(magic, sizeof(magic));
+    put(out, version, 4);
+    put(out, memory::page_size, 4);
+    put(out, mem.get_size(), 8);
+    put(out, cpu.get_insn_counter(), 8);
+    put(out, cpu.get_pc(), 4);
+    for (uint32_t r = 0; r < 32; ++r)
+    {
+        put(out, cpu.get_reg(r), 4);
+    }
+    put(out, sys.get_brk(), 4);
+    put(out, (cpu.is_halted() ? flag_halt : 0) | (cpu.get_compressed() ? flag_compressed : 0), 4);
+    put(out, cpu.get_halt_reason().size(), 4);
+    out << cpu.get_halt_reason();
+
+    put(out, saved.size(), 4);
+    for (uint32_t page : saved)
+    {
+        put(out, page, 4);
+    }
+
+    // the page data starts on an aligned offset so that it can be mapped
+    uint64_t pos = out.tellp();
+    put(out, 0, (data_align - pos % data_align) % data_align);
+
+    for (uint32_t page : saved)
+    {
+        std::fill(buf.begin(), buf.end(), 0xa5);    // for a short last page
+        uint64_t addr = uint64_t(page) * memory::page_size;
+        mem.copy_out(addr, buf.data(), std::min<uint64_t>(memory::page_size, mem.get_size() - addr));
+        out.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+    }
+
+    if (!out.flush())
+    {
+        std::cerr << "Can't write file '" << fname << "'." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Reads the header and page index of a checkpoint.
+bool checkpoint::load(const std::string &name)
+{
+    std::ifstream in(name, std::ios::in|std::ios::binary);
+
+    if (!in)
+    {
+        std::cerr << "Can't open file '" << name << "' for reading." << std::endl;
+        return false;
+    }
+
+    // lengths read from the file are checked against what is left of it
+    // before anything is allocated for them
+    in.seekg(0, std::ios::end);
+    uint64_t size = in.tellg();
+    in.seekg(0);
+    auto left = [&in, size]() { return in ? size - uint64_t(in.tellg()) : 0; };
+
+    char m[sizeof(magic)];
+    if (!in.read(m, sizeof(m)) || std::memcmp(m, magic, sizeof(magic)) != 0
+        || get(in, 4) != version || get(in, 4) != memory::page_size)
+    {
+        std::cerr << "'" << name << "' is not a checkpoint." << std::endl;
+        return false;
+    }
+
+    fname = name;
+    mem_size = get(in, 8);
+    insn_counter = get(in, 8);
+    pc = get(in, 4);
+    for (uint32_t r = 0; r < 32; ++r)
+    {
+        regs[r] = get(in, 4);
+    }
+    brk = get(in, 4);
+    flags = get(in, 4);
+
+    uint32_t reason_len = get(in, 4);
+    if (reason_len > max_halt_reason || reason_len > left())
+    {
+        std::cerr << "'" << name << "' is truncated." << std::endl;
+        return false;
+    }
+    halt_reason.resize(reason_len);
+    in.read(&halt_reason[0], halt_reason.size());
+
+    uint32_t page_count = get(in, 4);
+    if (page_count > left() / 4)
+    {
+        std::cerr << "'" << name << "' is truncated." << std::endl;
+        return false;
+    }
+    pages.resize(page_count);
+    for (uint32_t &page : pages)
+    {
+        page = get(in, 4);
+    }
+
+    uint64_t pos = in.tellg();
+    data_offset = pos + (data_align - pos % data_align) % data_align;
+
+    if (!in || mem_size > uint64_t(1) << 32 || data_offset + pages.size() * uint64_t(memory::page_size) > size)
+    {
+        std::cerr << "'" << name << "' is truncated." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Copies the saved pages into a dense memory.
+bool checkpoint::read_pages(memory &mem) const
+{
+    std::ifstream in(fname, std::ios::in|std::ios::binary);
+    std::vector<uint8_t> buf(memory::page_size);
+
+    in.seekg(data_offset);
+    for (uint32_t page : pages)
+    {
+        uint64_t addr = uint64_t(page) * memory::page_size;
+
+        if (addr >= mem.get_size())
+        {
+            std::cerr << "Bad page number " << hex::to_hex0x32(page) << " in '" << fname << "'." << std::endl;
+            return false;
+        }
+
+        if (!in.read(reinterpret_cast<char*>(buf.data()), buf.size()))
+        {
+            std::cerr << "Can't read file '" << fname << "'." << std::endl;
+            return false;
+        }
+
+        mem.copy_in(addr, buf.data(), std::min<uint64_t>(memory::page_size, mem.get_size() - addr));
+    }
+
+    return true;
+}
+
+// Puts a simulation back into the state load() read.
+bool checkpoint::restore(cpu_single_hart &cpu, memory &mem, host_syscalls &sys) const
+{
+    if (mem.is_paged())
+    {
+        if (!mem.map_file(fname, data_offset, pages))
+            return false;
+    }
+    else if (!read_pages(mem))
+    {
+        return false;
+    }
+
+    for (uint32_t r = 1; r < 32; ++r)
+    {
+        cpu.set_reg(r, regs[r]);
+    }
+    cpu.set_pc(pc);
+    cpu.set_insn_counter(insn_counter);
+    cpu.set_compressed(flags & flag_compressed);
+    if (flags & flag_halt)
+    {
+        cpu.set_halt(halt_reason);
+    }
+
+    sys.set_brk(brk);
+
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+//******************************************************************************
+//
+// checkpoint.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <string>
+#include <vector>
+
+#include "cpu_single_hart.h"
+#include "host_syscalls.h"
+#include "memory.h"
+
+/**
+ * @brief Class to save the state of a simulation to a file and resume it.
+ *
+ * A checkpoint holds the registers, pc, insn_counter, halt state, whether
+ * RV32C is enabled, the program break and the contents of memory. Memory
+ * is saved a page at a time, skipping every page that holds nothing but
+ * 0xa5, the value memory starts out with:
+ *
+ *     header          magic "RV32CKPT", the fields above, the page count
+ *     page index      the page number of each saved page (u32 each)
+ *     padding         up to the next multiple of data_align
+ *     page data       page_size bytes per saved page, in index order
+ *
+ * All values are little-endian. Because the page data is aligned, a
+ * restore maps it straight into a paged memory, copy-on-write, rather than
+ * reading it, so it costs about the same however large the memory is.
+ * ****************************************************************************/
+class checkpoint
+{
+    public:
+        /**
+         * @brief Saves the state of a simulation.
+         * @param fname File name of the checkpoint to write.
+         * @param cpu The hart.
+         * @param mem Its memory.
+         * @param sys Its syscall layer, whose output should already have
+         *        been flushed.
+         * @return false if the file can't be written.
+         * ********************************************************************/
+        static bool save(const std::string &fname, const cpu_single_hart &cpu, const memory &mem, const host_syscalls &sys);
+
+        /**
+         * @brief Reads the header and page index of a checkpoint.
+         * @param fname File name of the checkpoint.
+         * @return false if the file can't be read or isn't a checkpoint.
+         * ********************************************************************/
+        bool load(const std::string &fname);
+
+        /**
+         * @brief Accessor for mem_size.
+         * @return The size of the memory to restore() into.
+         * ********************************************************************/
+        uint64_t get_mem_size() const { return mem_size; }
+
+        /**
+         * @brief Puts a simulation back into the state load() read.
+         * @param cpu The hart, which must have been reset.
+         * @param mem A memory of get_mem_size() bytes that hasn't been
+         *        written to. A paged memory maps the checkpoint's pages, a
+         *        dense one has them copied in.
+         * @param sys The syscall layer.
+         * @return false if the pages can't be mapped or read.
+         * ********************************************************************/
+        bool restore(cpu_single_hart &cpu, memory &mem, host_syscalls &sys) const;
+
+    private:
+        /**
+         * @brief Copies the saved pages into a dense memory.
+         * @param mem The memory.
+         * @return false if the file can't be read or names a page outside
+         *         the memory.
+         * ********************************************************************/
+        bool read_pages(memory &mem) const;
+
+        /**
+         * @brief Alignment of the page data in the file. It is a multiple of
+         *        the page size of any host we expect to run on.
+         * ********************************************************************/
+        static constexpr uint32_t data_align = 64 * 1024;
+
+        /**
+         * @brief The longest halt reason a checkpoint may hold. The reasons
+         *        the simulator gives are a few dozen characters.
+         * ********************************************************************/
+        static constexpr uint32_t max_halt_reason = 4096;
+
+        /**
+         * @brief Flag bits saved in the header.
+         * ********************************************************************/
+        static constexpr uint32_t flag_halt = 0x1;
+        static constexpr uint32_t flag_compressed = 0x2;  ///< @copydoc flag_halt
+
+        std::string fname;                  ///< The checkpoint file.
+        uint64_t mem_size = { 0 };          ///< Size of the memory.
+        uint64_t insn_counter = { 0 };      ///< Instructions executed.
+        uint32_t pc = { 0 };                ///< The next instruction.
+        int32_t regs[32] = { 0 };           ///< The registers.
+        uint32_t brk = { 0 };               ///< The program break.
+        uint32_t flags = { 0 };             ///< flag_halt and flag_compressed.
+        std::string halt_reason;            ///< Why the hart halted, if it did.
+        std::vector<uint32_t> pages;        ///< Page numbers of the saved pages.
+        uint64_t data_offset = { 0 };       ///< File offset of the page data.
+};
+
+#endif
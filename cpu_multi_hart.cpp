@@ -0,0 +1,180 @@
+//******************************************************************************
+//
+// cpu_multi_hart.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <atomic>
+#include <thread>
+
+#include "cpu_multi_hart.h"
+#include "host_syscalls.h"
+
+// Constructor.
+cpu_multi_hart::cpu_multi_hart(memory &mem, unsigned n, uint32_t stack_size) : mem(mem), stack_size(stack_size)
+{
+    for (unsigned i = 0; i < n; ++i)
+    {
+        harts.emplace_back(new cpu_single_hart(mem));
+        harts.back()->set_mhardid(i);
+    }
+}
+
+// Reset every hart.
+void cpu_multi_hart::reset()
+{
+    for (auto &h : harts)
+    {
+        h->reset();
+    }
+}
+
+// Set the address every hart starts at after reset().
+void cpu_multi_hart::set_reset_pc(uint32_t addr)
+{
+    for (auto &h : harts)
+    {
+        h->set_reset_pc(addr);
+    }
+}
+
+// Mutator for show_instructions.
+void cpu_multi_hart::set_show_instructions(bool b)
+{
+    for (auto &h : harts)
+    {
+        h->set_show_instructions(b);
+    }
+    lockstep = lockstep || b;
+}
+
+// Mutator for show_registers.
+void cpu_multi_hart::set_show_registers(bool b)
+{
+    for (auto &h : harts)
+    {
+        h->set_show_registers(b);
+    }
+    lockstep = lockstep || b;
+}
+
+// Mutator for each hart's execution engine.
+void cpu_multi_hart::set_engine(cpu_single_hart::engine e)
+{
+    for (auto &h : harts)
+    {
+        h->set_engine(e);
+    }
+}
+
+// Mutator for compressed.
+void cpu_multi_hart::set_compressed(bool b)
+{
+    for (auto &h : harts)
+    {
+        h->set_compressed(b);
+    }
+}
+
+// Attach a syscall layer to every hart.
+void cpu_multi_hart::set_syscalls(host_syscalls *s)
+{
+    for (auto &h : harts)
+    {
+        h->set_syscalls(s);
+    }
+}
+
+// The prefix put on a hart's output.
+std::string cpu_multi_hart::header(size_t i)
+{
+    return "[" + std::to_string(i) + "] ";
+}
+
+// Run the harts until one of them halts or each has executed exec_limit instructions.
+void cpu_multi_hart::run(uint64_t exec_limit, std::ostream &os)
+{
+    uint64_t limit = exec_limit ? exec_limit : UINT64_MAX;
+
+    for (size_t i = 0; i < harts.size(); ++i)
+    {
+        // each stack sits just below the previous hart's
+        harts[i]->set_reg(2, static_cast<int32_t>(mem.get_size() - uint64_t(i) * stack_size));
+    }
+
+    if (lockstep)
+    {
+        bool running = true;
+        while (running)
+        {
+            running = false;
+            for (size_t i = 0; i < harts.size(); ++i)
+            {
+                if (harts[i]->get_insn_counter() < limit)
+                {
+                    harts[i]->tick(header(i));
+                    running = !harts[i]->is_halted();
+                    if (!running)
+                        break;
+                }
+            }
+        }
+    }
+    else
+    {
+        std::atomic<bool> stop(false);
+
+        auto body = [&stop, limit](cpu_single_hart *h)
+        {
+            h->execute(limit, &stop);
+            if (h->is_halted())
+                stop.store(true, std::memory_order_relaxed);
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < harts.size(); ++i)
+        {
+            threads.emplace_back(body, harts[i].get());
+        }
+        body(harts[0].get());
+
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+    }
+
+    if (harts[0]->get_syscalls())
+    {
+        harts[0]->get_syscalls()->flush();
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < harts.size(); ++i)
+    {
+        if (harts[i]->is_halted())
+        {
+            os << header(i) << "Execution terminated. Reason: " << harts[i]->get_halt_reason() << std::endl;
+        }
+
+        os << header(i) << harts[i]->get_insn_counter() << " instructions executed" << std::endl;
+        total += harts[i]->get_insn_counter();
+    }
+
+    os << total << " instructions executed" << std::endl;
+}
+
+// Dump the state of every hart.
+void cpu_multi_hart::dump() const
+{
+    for (size_t i = 0; i < harts.size(); ++i)
+    {
+        harts[i]->dump(header(i));
+    }
+}
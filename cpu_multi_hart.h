@@ -0,0 +1,108 @@
+#ifndef CPU_MULTI_HART_H
+#define CPU_MULTI_HART_H
+
+//******************************************************************************
+//
+// cpu_multi_hart.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <memory>
+#include <vector>
+
+#include "cpu_single_hart.h"
+
+/**
+ * @brief Class to represent a CPU with several harts sharing one memory.
+ *
+ * Each hart runs on its own host thread with the same entry point, its own
+ * stack below the previous hart's, and its index in mhartid. There are no
+ * barriers between the harts: once any of them halts the others are told to
+ * stop and finish within a few thousand instructions.
+ *
+ * Stores made by one hart are seen by the others as they happen on the host,
+ * but a hart's decoded instructions are only invalidated by its own stores,
+ * so code must not be modified while another hart may be running it.
+ *
+ * When tracing, the harts instead take turns on the calling thread, one
+ * instruction each, so that the output is readable and repeatable.
+ * ****************************************************************************/
+class cpu_multi_hart
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param mem The memory shared by the harts.
+         * @param n The number of harts.
+         * @param stack_size The bytes of stack each hart gets.
+         * ********************************************************************/
+        cpu_multi_hart(memory &mem, unsigned n, uint32_t stack_size = 0x1000);
+
+        /**
+         * @brief Reset every hart.
+         * ********************************************************************/
+        void reset();
+
+        /**
+         * @brief Set the address every hart starts at after reset().
+         * @param addr The entry point.
+         * ********************************************************************/
+        void set_reset_pc(uint32_t addr);
+
+        void set_show_instructions(bool b);         ///< Mutator for show_instructions, see rv32i_hart.
+        void set_show_registers(bool b);            ///< Mutator for show_registers, see rv32i_hart.
+        void set_engine(cpu_single_hart::engine e); ///< Mutator for each hart's execution engine.
+        void set_compressed(bool b);                ///< Mutator for compressed, see rv32i_hart.
+        void set_syscalls(host_syscalls *s);        ///< Attach one syscall layer to every hart, see rv32i_hart.
+
+        /**
+         * @brief Run the harts until one of them halts or each has executed
+         *        exec_limit instructions.
+         * @param exec_limit The maximum number of instructions each hart may
+         *        execute, or 0 for no limit.
+         * @param os Where to print why execution stopped and the number of 
+         *        instructions executed.
+         * ********************************************************************/
+        void run(uint64_t exec_limit, std::ostream &os = std::cout);
+
+        /**
+         * @brief Dump the state of every hart.
+         * ********************************************************************/
+        void dump() const;
+
+    private:
+        /**
+         * @brief The prefix put on a hart's output.
+         * @param i The hart's index.
+         * @return The prefix.
+         * ********************************************************************/
+        static std::string header(size_t i);
+
+        /**
+         * @brief The memory shared by the harts.
+         * ********************************************************************/
+        memory &mem;
+
+        /**
+         * @brief The harts, indexed by mhartid.
+         * ********************************************************************/
+        std::vector<std::unique_ptr<cpu_single_hart>> harts;
+
+        /**
+         * @brief The bytes of stack each hart gets.
+         * ********************************************************************/
+        uint32_t stack_size;
+
+        /**
+         * @brief Take turns on one thread rather than running in parallel.
+         * ********************************************************************/
+        bool lockstep = { false };
+};
+
+#endif
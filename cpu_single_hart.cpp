@@ -10,31 +10,89 @@
 //
 //******************************************************************************
 
+#include <algorithm>
+
 #include "cpu_single_hart.h"
+#include "rv32i_jit.h"
+#include "host_syscalls.h"
+#include "trace_printer.h"
+#include "hart_observer.h"
+
+// Reset the hart, with the stack pointer at the top of memory.
+void cpu_single_hart::reset()
+{
+    rv32i_hart::reset();
+    regs.set(2, static_cast<int32_t>(mem.get_size()));     // 0 for a full 4 GiB memory
+}
 
-void cpu_single_hart::run(uint64_t exec_limit)
+// Run the hart until it halts or exec_limit instructions have been executed.
+void cpu_single_hart::run(uint64_t exec_limit, std::ostream &os)
 {
-    regs.set(2, mem.get_size());
+    execute(exec_limit ? exec_limit : UINT64_MAX);
 
-    if (exec_limit)
+    if (get_syscalls())
     {
-        while (!is_halted() && get_insn_counter() < exec_limit)
-        {
-            tick();
-        }
+        get_syscalls()->flush();    // the guest's output comes before ours
     }
-    else 
+
+    if (is_halted())
     {
-        while (!is_halted()) 
-        { 
-            tick(); 
-        }
+        os << "Execution terminated. Reason: " << get_halt_reason() << std::endl;
     }
 
-    if (is_halted())
+    os << get_insn_counter() << " instructions executed" << std::endl;
+
+    for (hart_observer *o : get_observers())
     {
-        std::cout << "Execution terminated. Reason: " << get_halt_reason() << std::endl;
+        o->report(os);
     }
+}
 
-    std::cout << get_insn_counter() << " instructions executed" << std::endl;
-}
\ No newline at end of file
+// Execute instructions with the selected engine.
+void cpu_single_hart::execute(uint64_t limit, const std::atomic<bool> *stop)
+{
+    std::unique_ptr<rv32i_jit> jit;
+
+    if (exec_engine == engine::jit)
+    {
+        jit.reset(new rv32i_jit(*this));
+    }
+
+    // format -i and -r output on another thread, unless it's being recorded
+    std::unique_ptr<trace_printer> printer;
+
+    if ((get_show_instructions() || get_show_registers()) && !get_recorder())
+    {
+        printer.reset(new trace_printer(*this, get_show_instructions(), get_show_registers()));
+        set_printer(printer.get());
+    }
+
+    tick_fn step = get_tick();
+
+    while (!is_halted() && get_insn_counter() < limit && !(stop && stop->load(std::memory_order_relaxed)))
+    {
+        // come up for air now and then when something else may want us to stop
+        uint64_t chunk = stop ? std::min(limit, get_insn_counter() + stop_quantum) : limit;
+
+        // printed instructions are executed one at a time by any engine
+        if (exec_engine == engine::tick || printer)
+        {
+            while (!is_halted() && get_insn_counter() < chunk)
+            {
+                (this->*step)("");
+            }
+        }
+        else
+        {
+            while (!is_halted() && get_insn_counter() < chunk)
+            {
+                if (!jit || !jit->run(chunk))
+                {
+                    tick_block(chunk - get_insn_counter());
+                }
+            }
+        }
+    }
+    flush_retired();
+    set_printer(nullptr);   // its destructor prints whatever is left
+}
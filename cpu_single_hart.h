@@ -13,6 +13,8 @@
 //
 //******************************************************************************
 
+#include <atomic>
+
 #include "rv32i_hart.h"
 
 /**
@@ -21,15 +23,63 @@
 class cpu_single_hart : public rv32i_hart
 {
     public:
+        /**
+         * @brief The ways the CPU can drive its hart.
+         * ********************************************************************/
+        enum class engine
+        {
+            tick,   ///< One tick() per instruction.
+            block,  ///< One tick_block() per basic block.
+            jit     ///< Hot blocks translated to native code, others as block.
+        };
+
         /**
          * @brief Constructor.
          * ********************************************************************/
         cpu_single_hart(memory &mem) : rv32i_hart(mem) { }
 
         /**
-         * @brief 
+         * @brief Mutator for exec_engine.
+         * @param e The execution engine to use.
+         * ********************************************************************/
+        void set_engine(engine e) { exec_engine = e; }
+
+        /**
+         * @brief Reset the hart, with the stack pointer at the top of memory.
+         * ********************************************************************/
+        void reset();
+
+        /**
+         * @brief Run the hart until it halts or exec_limit instructions
+         *        have been executed.
+         * @param exec_limit The maximum number of instructions to execute,
+         *        or 0 for no limit.
+         * @param os Where to print why execution stopped, the number of 
+         *        instructions executed and the observers' reports.
+         * ********************************************************************/
+        void run(uint64_t exec_limit, std::ostream &os = std::cout);
+
+        /**
+         * @brief Execute instructions with the selected engine.
+         *
+         * Unlike run(), this doesn't print anything.
+         *
+         * @param limit The value insn_counter must not exceed.
+         * @param stop If not nullptr, execution also ends once this is set,
+         *        which is checked at least every stop_quantum instructions.
+         * ********************************************************************/
+        void execute(uint64_t limit, const std::atomic<bool> *stop = nullptr);
+
+    private:
+        /**
+         * @brief Most instructions executed between checks of the stop flag.
+         * ********************************************************************/
+        static constexpr uint64_t stop_quantum = 4096;
+
+        /**
+         * @brief The execution engine used by run().
          * ********************************************************************/
-        void run(uint64_t exec_limit);
+        engine exec_engine = { engine::tick };
 };
 
 #endif
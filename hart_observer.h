@@ -0,0 +1,112 @@
+#ifndef HART_OBSERVER_H
+#define HART_OBSERVER_H
+
+//******************************************************************************
+//
+// hart_observer.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "rv32i_decode.h"
+
+/**
+ * @brief An instruction as the hart hands it to its observers once it has
+ *        executed.
+ * ****************************************************************************/
+struct retired_insn
+{
+    uint32_t pc;        ///< Address of the instruction.
+    uint32_t next_pc;   ///< Address of the instruction executed after it.
+    uint32_t insn;      ///< The instruction, expanded if it was compressed.
+    uint32_t addr;      ///< The address of a load or store, rs1 + imm as it was before it executed. Unset for other instructions.
+    uint8_t len;        ///< Length of the instruction in bytes (2 or 4).
+    uint8_t rd;         ///< Destination register.
+    uint8_t rs1;        ///< First source register.
+    uint8_t rs2;        ///< Second source register.
+    int32_t value;      ///< For a load, the value it wrote back minus the value rd held before. Only set by translated code recording a trace.
+    uint32_t raw;       ///< The instruction as it is in memory, if it was compressed. Only set by translated code recording a trace.
+};
+
+/**
+ * @brief Base class for models that watch the instructions a hart executes,
+ *        such as statistics and timing models.
+ *
+ * The hart records every instruction it executes while an observer is
+ * attached and hands them over in batches, in the order they executed. The
+ * rv32i_decode helpers are inherited for picking the instructions apart.
+ * ****************************************************************************/
+class hart_observer : public rv32i_decode
+{
+    public:
+        /**
+         * @brief Destructor.
+         * ********************************************************************/
+        virtual ~hart_observer() { }
+
+        /**
+         * @brief Called after the hart has executed an instruction.
+         * @param r The instruction.
+         * ********************************************************************/
+        virtual void retired(const retired_insn &r) = 0;
+
+        /**
+         * @brief Called with a batch of instructions the hart has executed.
+         * 
+         * Hands each to retired(). Observers that are called for every 
+         * instruction can override it to save the virtual call on each.
+         * 
+         * @param r The instructions, oldest first.
+         * @param n The number of them.
+         * ********************************************************************/
+        virtual void retired_batch(const retired_insn *r, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                retired(r[i]);
+            }
+        }
+
+        /**
+         * @brief Prints what has been observed.
+         * @param os Where to print it.
+         * ********************************************************************/
+        virtual void report(std::ostream &os) const = 0;
+
+    protected:
+        /**
+         * @brief Is this register the link register of the standard
+         *        calling convention (ra, or t0 as the alternate)?
+         * @param r A register number.
+         * @return true if it is x1 or x5.
+         * ********************************************************************/
+        static bool is_link(uint32_t r) { return r == 1 || r == 5; }
+
+        /**
+         * @brief Is this jal or jalr a call?
+         * @param r The instruction.
+         * @return true if it writes the return address to a link register.
+         * ********************************************************************/
+        static bool is_call(const retired_insn &r) { return is_link(r.rd); }
+
+        /**
+         * @brief Is this jalr a return?
+         * @param r The instruction.
+         * @return true if it jumps through a link register without linking.
+         * ********************************************************************/
+        static bool is_return(const retired_insn &r)
+        {
+            return get_opcode(r.insn) == opcode_jalr && r.rd == 0 && is_link(r.rs1);
+        }
+};
+
+#endif
@@ -15,37 +15,41 @@
 // Formats an 8bit value as hex for output.
 std::string hex::to_hex8(uint8_t i)
 {
-    std::ostringstream os;
-    os << std::hex << std::setfill('0') << std::setw(2) << static_cast<uint16_t>(i);
-    return os.str();
+    char buf[2];
+    return std::string(buf, put_hex(buf, i, 2));
+}
+
+// Formats a 16bit value as hex for output.
+std::string hex::to_hex16(uint16_t i)
+{
+    char buf[4];
+    return std::string(buf, put_hex(buf, i, 4));
 }
 
 // Formats a 32bit value as hex for output.
 std::string hex::to_hex32(uint32_t i)
 {
-    std::ostringstream os;
-    os << std::hex << std::setfill('0') << std::setw(8) << i;
-    return os.str();
+    char buf[8];
+    return std::string(buf, put_hex(buf, i, 8));
 }
 
 // Formats a 12bit value as hex (with leading "0x") for output.
 std::string hex::to_hex0x12(uint32_t i)
 {
-    std::ostringstream os;
-    os << "0x" << std::hex << std::setfill('0') << std::setw(3) << i;
-    return os.str();
+    char buf[2 + 8] = { '0', 'x' };
+    return std::string(buf, put_hex(buf + 2, i, 3));
 }
 
 // Formats a 20bit value as hex (with leading "0x") for output.
 std::string hex::to_hex0x20(uint32_t i)
 {
-    std::ostringstream os;
-    os << "0x" << std::hex << std::setfill('0') << std::setw(5) << i;
-    return os.str();
+    char buf[2 + 8] = { '0', 'x' };
+    return std::string(buf, put_hex(buf + 2, i, 5));
 }
 
 // Formats a 32bit value as hex (with leading "0x") for output.
 std::string hex::to_hex0x32(uint32_t i)
 {
-    return std::string("0x")+to_hex32(i);
+    char buf[2 + 8] = { '0', 'x' };
+    return std::string(buf, put_hex(buf + 2, i, 8));
 }
@@ -24,6 +24,27 @@
 class hex
 {
     public:
+        /**
+         * @brief Writes a value as hex digits into a buffer, without
+         *        allocating anything.
+         * @param p Where to write the digits. There must be room for
+         *        digits characters; no terminating nul is written.
+         * @param i The value to format.
+         * @param digits The number of digits to write, from 1 to 8.
+         * @returns A pointer just past the last digit written.
+         * ********************************************************************/
+        static char *put_hex(char *p, uint32_t i, int digits)
+        {
+            static const char nibble[] = "0123456789abcdef";
+
+            for (int d = digits - 1; d >= 0; --d)
+            {
+                p[d] = nibble[i & 0xf];
+                i >>= 4;
+            }
+            return p + digits;
+        }
+
         /**
          * @brief Formats an 8bit value as hex for output.
          * @param i The value to format.
@@ -31,6 +52,13 @@ class hex
          * ********************************************************************/
         static std::string to_hex8(uint8_t i);
 
+        /**
+         * @brief Formats a 16bit value as hex for output.
+         * @param i The value to format.
+         * @returns A std::string containing the formatted output.
+         * ********************************************************************/
+        static std::string to_hex16(uint16_t i);
+
         /**
          * @brief Formats a 32bit value as hex for output.
          * @param i The value to format.
@@ -0,0 +1,243 @@
+//******************************************************************************
+//
+// host_syscalls.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+
+#include "host_syscalls.h"
+
+// errno values as the guest's C library knows them
+static constexpr int32_t guest_eio = 5;
+static constexpr int32_t guest_ebadf = 9;
+static constexpr int32_t guest_efault = 14;
+
+// Constructor.
+host_syscalls::host_syscalls(memory &m, std::ostream &out, std::ostream &err, int in_fd)
+    : mem(m), out(out), err(err), in_fd(in_fd), out_buf(new uint8_t[buffer_size]), in_buf(new uint8_t[buffer_size])
+{
+    brk_start = std::min<uint64_t>(mem.get_image_end(), mem.get_size() - 1);
+    brk = brk_start;
+}
+
+// Destructor.
+host_syscalls::~host_syscalls()
+{
+    flush();
+}
+
+// Is a system call implemented?
+bool host_syscalls::is_supported(uint32_t num)
+{
+    return *name(num) != '\0';
+}
+
+// The name of a system call.
+const char *host_syscalls::name(uint32_t num)
+{
+    switch (num)
+    {
+        case sys_close:         return "close";
+        case sys_read:          return "read";
+        case sys_write:         return "write";
+        case sys_fstat:         return "fstat";
+        case sys_exit:          return "exit";
+        case sys_exit_group:    return "exit_group";
+        case sys_gettimeofday:  return "gettimeofday";
+        case sys_brk:           return "brk";
+    }
+    return "";
+}
+
+// Carries out a system call.
+void host_syscalls::call(request &r)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    r.ret = 0;
+    r.store_addr = 0;
+    r.store_len = 0;
+    r.exited = false;
+
+    switch (r.num)
+    {
+        case sys_close:
+            // the standard streams belong to the simulator, leave them open
+            r.ret = r.arg[0] >= 0 && r.arg[0] <= 2 ? 0 : -guest_ebadf;
+            break;
+
+        case sys_read:          r.ret = do_read(r.arg[0], r.arg[1], r.arg[2], r); break;
+        case sys_write:         r.ret = do_write(r.arg[0], r.arg[1], r.arg[2]); break;
+        case sys_fstat:         r.ret = do_fstat(r.arg[0], r.arg[1], r); break;
+        case sys_gettimeofday:  r.ret = do_gettimeofday(r.arg[0], r); break;
+        case sys_brk:           r.ret = do_brk(r.arg[0], r); break;
+
+        case sys_exit:
+        case sys_exit_group:
+            exited = true;
+            exit_status = r.arg[0];
+            r.exited = true;
+            flush_locked();
+            break;
+    }
+}
+
+// Writes any buffered guest output to the host stream.
+void host_syscalls::flush()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    flush_locked();
+}
+
+// Writes any buffered guest output to the host stream, with lock held.
+void host_syscalls::flush_locked()
+{
+    if (out_len)
+    {
+        std::ostream &os = out_fd == 2 ? err : out;
+        os.write(reinterpret_cast<const char*>(out_buf.get()), out_len);
+        os.flush();
+        out_len = 0;
+    }
+}
+
+// write(2) to stdout or stderr.
+int32_t host_syscalls::do_write(int32_t fd, uint32_t buf, uint32_t count)
+{
+    if (fd != 1 && fd != 2)
+        return -guest_ebadf;
+
+    if (count == 0)
+        return 0;
+
+    if (!mem.in_range(buf, count))
+        return -guest_efault;
+
+    if (fd != out_fd)
+    {
+        flush_locked();     // keep stdout and stderr in order with each other
+        out_fd = fd;
+    }
+
+    for (uint32_t done = 0; done < count; )
+    {
+        uint32_t n = std::min(count - done, buffer_size - out_len);
+        mem.copy_out(buf + done, out_buf.get() + out_len, n);
+        out_len += n;
+        done += n;
+
+        if (out_len == buffer_size)
+            flush_locked();
+    }
+
+    return count;
+}
+
+// read(2) from stdin.
+int32_t host_syscalls::do_read(int32_t fd, uint32_t buf, uint32_t count, request &r)
+{
+    if (fd != 0)
+        return -guest_ebadf;
+
+    if (count == 0)
+        return 0;
+
+    if (!mem.in_range(buf, count))
+        return -guest_efault;
+
+    if (in_pos == in_len)
+    {
+        if (in_fd < 0)
+            return 0;
+
+        flush_locked();     // show any prompt before waiting for input
+
+        ssize_t n = ::read(in_fd, in_buf.get(), buffer_size);
+        if (n <= 0)
+            return n < 0 ? -guest_eio : 0;
+
+        in_pos = 0;
+        in_len = n;
+    }
+
+    uint32_t n = std::min(count, in_len - in_pos);
+    mem.copy_in(buf, in_buf.get() + in_pos, n);
+    in_pos += n;
+
+    r.store_addr = buf;
+    r.store_len = n;
+    return n;
+}
+
+// fstat(2) of one of the standard streams.
+int32_t host_syscalls::do_fstat(int32_t fd, uint32_t statbuf, request &r)
+{
+    // newlib's struct kernel_stat for RISC-V; only st_mode (at 16) is filled in
+    static constexpr uint32_t stat_size = 128;
+    static constexpr uint32_t s_ifchr = 0020000;
+
+    if (fd < 0 || fd > 2)
+        return -guest_ebadf;
+
+    if (!mem.in_range(statbuf, stat_size))
+        return -guest_efault;
+
+    mem.copy_in(statbuf, nullptr, stat_size);
+    mem.store32(statbuf + 16, s_ifchr | 0620);
+
+    r.store_addr = statbuf;
+    r.store_len = stat_size;
+    return 0;
+}
+
+// gettimeofday(2). The timezone argument is obsolete and ignored.
+int32_t host_syscalls::do_gettimeofday(uint32_t tv, request &r)
+{
+    // struct timeval with a 64-bit time_t: tv_sec at 0, tv_usec at 8
+    static constexpr uint32_t timeval_size = 16;
+
+    if (!tv)
+        return 0;
+
+    if (!mem.in_range(tv, timeval_size))
+        return -guest_efault;
+
+    int64_t usec = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    mem.store32(tv, static_cast<uint64_t>(usec / 1000000));
+    mem.store32(tv + 4, static_cast<uint64_t>(usec / 1000000) >> 32);
+    mem.store32(tv + 8, usec % 1000000);
+    mem.store32(tv + 12, 0);
+
+    r.store_addr = tv;
+    r.store_len = timeval_size;
+    return 0;
+}
+
+// brk(2). Returns the new break, or the old one if addr is out of bounds.
+int32_t host_syscalls::do_brk(uint32_t addr, request &r)
+{
+    if (addr >= brk_start && addr < mem.get_size())
+    {
+        if (addr > brk)
+        {
+            // memory handed to the heap reads as zero, as on Linux
+            mem.copy_in(brk, nullptr, addr - brk);
+            r.store_addr = brk;
+            r.store_len = addr - brk;
+        }
+        brk = addr;
+    }
+
+    return brk;
+}
@@ -0,0 +1,199 @@
+#ifndef HOST_SYSCALLS_H
+#define HOST_SYSCALLS_H
+
+//******************************************************************************
+//
+// host_syscalls.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "memory.h"
+
+/**
+ * @brief Class to carry out the system calls a guest makes with ecall.
+ *
+ * The calls are the handful newlib needs, numbered as on RISC-V Linux: the
+ * number is in a7, the arguments in a0-a2 and the result (or -errno) is
+ * returned in a0. Only the standard streams exist. Nothing the guest does
+ * can close or otherwise touch the simulator's own files.
+ *
+ * Guest output is gathered in one large buffer and written to the host
+ * stream when the buffer fills, the guest switches between stdout and
+ * stderr, reads from stdin or exits, or flush() is called. Input is read
+ * from the host a buffer at a time as well.
+ *
+ * A single instance may be shared by several harts. Calls are serialized.
+ * ****************************************************************************/
+class host_syscalls
+{
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * The program break starts at the end of the image loaded into m,
+         * so the image must be loaded first.
+         *
+         * @param m The guest's memory.
+         * @param out Where guest writes to stdout go.
+         * @param err Where guest writes to stderr go.
+         * @param in_fd Host file descriptor guest reads from stdin come
+         *        from, or -1 to give the guest an empty stdin.
+         * ********************************************************************/
+        host_syscalls(memory &m, std::ostream &out = std::cout, std::ostream &err = std::cerr, int in_fd = 0);
+
+        /**
+         * @brief Destructor. Flushes any buffered output.
+         * ********************************************************************/
+        ~host_syscalls();
+
+        static constexpr uint32_t sys_close         = 57;   ///< close(fd)
+        static constexpr uint32_t sys_read          = 63;   ///< read(fd, buf, count)
+        static constexpr uint32_t sys_write         = 64;   ///< write(fd, buf, count)
+        static constexpr uint32_t sys_fstat         = 80;   ///< fstat(fd, statbuf)
+        static constexpr uint32_t sys_exit          = 93;   ///< exit(status)
+        static constexpr uint32_t sys_exit_group    = 94;   ///< exit_group(status)
+        static constexpr uint32_t sys_gettimeofday  = 169;  ///< gettimeofday(tv, tz)
+        static constexpr uint32_t sys_brk           = 214;  ///< brk(addr)
+
+        /**
+         * @brief One system call and its outcome.
+         * ********************************************************************/
+        struct request
+        {
+            uint32_t num;           ///< The call number, from a7.
+            int32_t arg[3];         ///< The arguments, from a0-a2.
+            int32_t ret;            ///< The result for a0.
+            uint32_t store_addr;    ///< First byte of guest memory the call wrote.
+            uint32_t store_len;     ///< Number of bytes it wrote, 0 if none.
+            bool exited;            ///< The guest asked to exit with status arg[0].
+        };
+
+        /**
+         * @brief Is a system call implemented?
+         * @param num The call number.
+         * @return true if call() handles it.
+         * ********************************************************************/
+        static bool is_supported(uint32_t num);
+
+        /**
+         * @brief The name of a system call, for tracing.
+         * @param num The call number.
+         * @return Its name, or "" if it isn't supported.
+         * ********************************************************************/
+        static const char *name(uint32_t num);
+
+        /**
+         * @brief Carries out a system call.
+         * @param r The call, which must be supported. Its ret, store_addr,
+         *        store_len and exited fields are filled in.
+         * ********************************************************************/
+        void call(request &r);
+
+        /**
+         * @brief Writes any buffered guest output to the host stream.
+         * ********************************************************************/
+        void flush();
+
+        /**
+         * @brief Has the guest called exit?
+         * @return true once it has.
+         * ********************************************************************/
+        bool has_exited() const { return exited; }
+
+        /**
+         * @brief Accessor for exit_status.
+         * @return The status the guest passed to exit.
+         * ********************************************************************/
+        int32_t get_exit_status() const { return exit_status; }
+
+        /**
+         * @brief Accessor for brk.
+         * @return The current program break.
+         * ********************************************************************/
+        uint32_t get_brk() const { return brk; }
+
+        /**
+         * @brief Mutator for brk, used to resume from a checkpoint.
+         * @param addr The program break. It is also the lowest address the
+         *        guest may move it back down to.
+         * ********************************************************************/
+        void set_brk(uint32_t addr) { brk_start = brk = addr; }
+
+    private:
+        /**
+         * @brief Size of the output and input buffers.
+         * ********************************************************************/
+        static constexpr uint32_t buffer_size = 64 * 1024;
+
+        /**
+         * @brief Writes any buffered guest output to the host stream.
+         *        The caller must hold lock.
+         * ********************************************************************/
+        void flush_locked();
+
+        int32_t do_write(int32_t fd, uint32_t buf, uint32_t count);                ///< write(2)
+        int32_t do_read(int32_t fd, uint32_t buf, uint32_t count, request &r);     ///< read(2)
+        int32_t do_fstat(int32_t fd, uint32_t statbuf, request &r);                ///< fstat(2)
+        int32_t do_gettimeofday(uint32_t tv, request &r);                          ///< gettimeofday(2)
+        int32_t do_brk(uint32_t addr, request &r);                                 ///< brk(2)
+
+        /**
+         * @brief The guest's memory.
+         * ********************************************************************/
+        memory &mem;
+
+        /**
+         * @brief The host streams for guest fds 1 and 2.
+         * ********************************************************************/
+        std::ostream &out, &err;
+
+        /**
+         * @brief The host file descriptor behind guest fd 0, or -1.
+         * ********************************************************************/
+        int in_fd;
+
+        /**
+         * @brief Serializes calls from different harts.
+         * ********************************************************************/
+        std::mutex lock;
+
+        std::unique_ptr<uint8_t[]> out_buf;     ///< Guest output not yet written to the host.
+        uint32_t out_len = { 0 };               ///< Bytes in out_buf.
+        int32_t out_fd = { 1 };                 ///< The guest fd out_buf holds output for.
+
+        std::unique_ptr<uint8_t[]> in_buf;      ///< Host input not yet read by the guest.
+        uint32_t in_pos = { 0 };                ///< Next unread byte in in_buf.
+        uint32_t in_len = { 0 };                ///< Bytes in in_buf.
+
+        /**
+         * @brief The lowest address the program break may be set to.
+         * ********************************************************************/
+        uint32_t brk_start;
+
+        /**
+         * @brief The current program break.
+         * ********************************************************************/
+        uint32_t brk;
+
+        /**
+         * @brief Set when the guest calls exit.
+         * ********************************************************************/
+        bool exited = { false };
+
+        /**
+         * @brief The status the guest passed to exit.
+         * ********************************************************************/
+        int32_t exit_status = { 0 };
+};
+
+#endif
@@ -0,0 +1,255 @@
+//******************************************************************************
+//
+// insn_stats.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <iomanip>
+
+#include "insn_stats.h"
+
+static const char *const width_names[] = { "byte", "half", "word" };
+
+// Counts an instruction.
+void insn_stats::retired(const retired_insn &r)
+{
+    uint32_t opcode = get_opcode(r.insn);
+    uint32_t funct3 = get_funct3(r.insn);
+
+    ++total;
+    ++counts[opcode][funct3];
+
+    switch (opcode)
+    {
+        case opcode_btype:
+            ++(r.next_pc != r.pc + r.len ? taken : not_taken)[funct3];
+            break;
+
+        case opcode_load_imm:
+            ++loads[funct3 & 3];    // lb/lbu, lh/lhu, lw
+            break;
+
+        case opcode_stype:
+            ++stores[funct3 & 3];
+            break;
+
+        case opcode_jal:
+            ++(is_call(r) ? calls : jumps);
+            break;
+
+        case opcode_jalr:
+            ++(is_call(r) ? indirect_calls : is_return(r) ? returns : jumps);
+            break;
+    }
+}
+
+// Counts a batch of instructions.
+void insn_stats::retired_batch(const retired_insn *r, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        insn_stats::retired(r[i]);
+    }
+}
+
+// Prints the counts as a table, then as JSON.
+void insn_stats::report(std::ostream &os) const
+{
+    print_table(os);
+    print_json(os);
+}
+
+// Prints the counts as a table.
+void insn_stats::print_table(std::ostream &os) const
+{
+    auto pct = [](uint64_t n, uint64_t of)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2) << (of ? 100.0 * n / of : 0.0) << "%";
+        return ss.str();
+    };
+
+    os << std::left << std::setw(24) << "Instruction mix" << std::right << std::setw(14) << "count"
+       << std::setw(9) << "%" << std::endl;
+
+    for (uint32_t opcode = 0; opcode < 128; ++opcode)
+    {
+        uint64_t n = opcode_count(opcode);
+        if (!n)
+            continue;
+
+        os << "  " << std::left << std::setw(22) << opcode_name(opcode) << std::right << std::setw(14) << n
+           << std::setw(9) << pct(n, total) << std::endl;
+
+        if (!has_funct3(opcode))
+            continue;
+
+        for (uint32_t funct3 = 0; funct3 < 8; ++funct3)
+        {
+            if (counts[opcode][funct3])
+            {
+                os << "    " << std::left << std::setw(20) << funct3_name(opcode, funct3) << std::right
+                   << std::setw(14) << counts[opcode][funct3] << std::setw(9) << pct(counts[opcode][funct3], total) << std::endl;
+            }
+        }
+    }
+
+    os << std::left << std::setw(24) << "Branches" << std::right << std::setw(14) << "taken"
+       << std::setw(14) << "not taken" << std::setw(9) << "taken %" << std::endl;
+
+    uint64_t all_taken = 0, all_not_taken = 0;
+    for (uint32_t funct3 = 0; funct3 < 8; ++funct3)
+    {
+        if (taken[funct3] || not_taken[funct3])
+        {
+            os << "  " << std::left << std::setw(22) << funct3_name(opcode_btype, funct3) << std::right
+               << std::setw(14) << taken[funct3] << std::setw(14) << not_taken[funct3]
+               << std::setw(9) << pct(taken[funct3], taken[funct3] + not_taken[funct3]) << std::endl;
+            all_taken += taken[funct3];
+            all_not_taken += not_taken[funct3];
+        }
+    }
+    os << "  " << std::left << std::setw(22) << "all" << std::right << std::setw(14) << all_taken
+       << std::setw(14) << all_not_taken << std::setw(9) << pct(all_taken, all_taken + all_not_taken) << std::endl;
+
+    os << std::left << std::setw(24) << "Memory accesses" << std::right << std::setw(14) << "loads"
+       << std::setw(14) << "stores" << std::endl;
+
+    for (uint32_t w = 0; w < 3; ++w)
+    {
+        os << "  " << std::left << std::setw(22) << width_names[w] << std::right << std::setw(14) << loads[w]
+           << std::setw(14) << stores[w] << std::endl;
+    }
+
+    os << std::left << std::setw(24) << "Jumps" << std::right << std::setw(14) << "count" << std::endl;
+    os << "  " << std::left << std::setw(22) << "calls (jal)" << std::right << std::setw(14) << calls << std::endl;
+    os << "  " << std::left << std::setw(22) << "calls (jalr)" << std::right << std::setw(14) << indirect_calls << std::endl;
+    os << "  " << std::left << std::setw(22) << "returns" << std::right << std::setw(14) << returns << std::endl;
+    os << "  " << std::left << std::setw(22) << "other" << std::right << std::setw(14) << jumps << std::endl;
+}
+
+// Prints the counts as one line of JSON.
+void insn_stats::print_json(std::ostream &os) const
+{
+    os << "{\"instructions\":" << total << ",\"opcodes\":{";
+
+    const char *sep = "";
+    for (uint32_t opcode = 0; opcode < 128; ++opcode)
+    {
+        uint64_t n = opcode_count(opcode);
+        if (!n)
+            continue;
+
+        os << sep << "\"" << opcode_name(opcode) << "\":{\"count\":" << n;
+        sep = ",";
+
+        if (has_funct3(opcode))
+        {
+            os << ",\"funct3\":{";
+            const char *sep3 = "";
+            for (uint32_t funct3 = 0; funct3 < 8; ++funct3)
+            {
+                if (counts[opcode][funct3])
+                {
+                    os << sep3 << "\"" << funct3_name(opcode, funct3) << "\":" << counts[opcode][funct3];
+                    sep3 = ",";
+                }
+            }
+            os << "}";
+        }
+        os << "}";
+    }
+
+    os << "},\"branches\":{";
+    sep = "";
+    for (uint32_t funct3 = 0; funct3 < 8; ++funct3)
+    {
+        if (taken[funct3] || not_taken[funct3])
+        {
+            os << sep << "\"" << funct3_name(opcode_btype, funct3) << "\":{\"taken\":" << taken[funct3]
+               << ",\"not_taken\":" << not_taken[funct3] << "}";
+            sep = ",";
+        }
+    }
+
+    os << "},\"loads\":{";
+    for (uint32_t w = 0; w < 3; ++w)
+    {
+        os << (w ? "," : "") << "\"" << width_names[w] << "\":" << loads[w];
+    }
+    os << "},\"stores\":{";
+    for (uint32_t w = 0; w < 3; ++w)
+    {
+        os << (w ? "," : "") << "\"" << width_names[w] << "\":" << stores[w];
+    }
+
+    os << "},\"calls\":" << calls << ",\"indirect_calls\":" << indirect_calls
+       << ",\"returns\":" << returns << ",\"other_jumps\":" << jumps << "}" << std::endl;
+}
+
+// Does an opcode have a funct3 field?
+bool insn_stats::has_funct3(uint32_t opcode)
+{
+    return opcode != opcode_lui && opcode != opcode_auipc && opcode != opcode_jal;
+}
+
+// The name of an opcode.
+std::string insn_stats::opcode_name(uint32_t opcode)
+{
+    switch (opcode)
+    {
+        default:                    return to_hex0x12(opcode);
+        case opcode_lui:            return "lui";
+        case opcode_auipc:          return "auipc";
+        case opcode_jal:            return "jal";
+        case opcode_jalr:           return "jalr";
+        case opcode_btype:          return "branch";
+        case opcode_load_imm:       return "load";
+        case opcode_stype:          return "store";
+        case opcode_alu_imm:        return "op-imm";
+        case opcode_rtype:          return "op";
+        case opcode_system:         return "system";
+    }
+}
+
+// The mnemonic(s) of an opcode and funct3.
+std::string insn_stats::funct3_name(uint32_t opcode, uint32_t funct3)
+{
+    static const char *const btype[] = { "beq", "bne", "", "", "blt", "bge", "bltu", "bgeu" };
+    static const char *const load[] = { "lb", "lh", "lw", "", "lbu", "lhu", "", "" };
+    static const char *const stype[] = { "sb", "sh", "sw", "", "", "", "", "" };
+    static const char *const alu_imm[] = { "addi", "slli", "slti", "sltiu", "xori", "srli/srai", "ori", "andi" };
+    static const char *const rtype[] = { "add/sub/mul", "sll/mulh", "slt/mulhsu", "sltu/mulhu", "xor/div", "srl/sra/divu", "or/rem", "and/remu" };
+    static const char *const sys[] = { "ecall/ebreak", "csrrw", "csrrs", "csrrc", "", "csrrwi", "csrrsi", "csrrci" };
+    static const char *const jalr[] = { "jalr", "", "", "", "", "", "", "" };
+
+    const char *name = "";
+    switch (opcode)
+    {
+        case opcode_jalr:           name = jalr[funct3]; break;
+        case opcode_btype:          name = btype[funct3]; break;
+        case opcode_load_imm:       name = load[funct3]; break;
+        case opcode_stype:          name = stype[funct3]; break;
+        case opcode_alu_imm:        name = alu_imm[funct3]; break;
+        case opcode_rtype:          name = rtype[funct3]; break;
+        case opcode_system:         name = sys[funct3]; break;
+    }
+    return *name ? std::string(name) : "funct3=" + std::to_string(funct3);
+}
+
+// The total of an opcode's counts.
+uint64_t insn_stats::opcode_count(uint32_t opcode) const
+{
+    uint64_t n = 0;
+    for (uint32_t funct3 = 0; funct3 < 8; ++funct3)
+    {
+        n += counts[opcode][funct3];
+    }
+    return n;
+}
@@ -0,0 +1,103 @@
+#ifndef INSN_STATS_H
+#define INSN_STATS_H
+
+//******************************************************************************
+//
+// insn_stats.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include "hart_observer.h"
+
+/**
+ * @brief Class to count the instructions a hart executes: the mix of
+ *        opcodes and funct3 values, how often each kind of branch is taken,
+ *        loads and stores by width, and calls and returns.
+ *
+ * Counting is a handful of increments per instruction. The report is a
+ * table followed by the same numbers as a single line of JSON.
+ * ****************************************************************************/
+class insn_stats : public hart_observer
+{
+    public:
+        /**
+         * @brief Counts an instruction.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override;
+
+        /**
+         * @brief Counts a batch of instructions.
+         * @param r The instructions.
+         * @param n The number of them.
+         * ********************************************************************/
+        void retired_batch(const retired_insn *r, size_t n) override;
+
+        /**
+         * @brief Prints the counts as a table, then as JSON.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+    private:
+        /**
+         * @brief Prints the counts as a table.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void print_table(std::ostream &os) const;
+
+        /**
+         * @brief Prints the counts as one line of JSON.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void print_json(std::ostream &os) const;
+
+        /**
+         * @brief Does an opcode have a funct3 field?
+         * @param opcode The opcode.
+         * @return false for lui, auipc and jal, whose bits 12-14 are part of
+         *         the immediate.
+         * ********************************************************************/
+        static bool has_funct3(uint32_t opcode);
+
+        /**
+         * @brief The name of an opcode.
+         * @param opcode The opcode.
+         * @return Its name, or its value in hex if it isn't an RV32IM one.
+         * ********************************************************************/
+        static std::string opcode_name(uint32_t opcode);
+
+        /**
+         * @brief The mnemonic(s) of an opcode and funct3.
+         * @param opcode The opcode.
+         * @param funct3 The funct3 value.
+         * @return The mnemonics the pair can be, or "funct3=N" if none.
+         * ********************************************************************/
+        static std::string funct3_name(uint32_t opcode, uint32_t funct3);
+
+        /**
+         * @brief The total of an opcode's counts.
+         * @param opcode The opcode.
+         * @return The number of times it was executed.
+         * ********************************************************************/
+        uint64_t opcode_count(uint32_t opcode) const;
+
+        uint64_t total = { 0 };                 ///< Instructions executed.
+        uint64_t counts[128][8] = { { 0 } };    ///< By opcode and funct3.
+        uint64_t taken[8] = { 0 };              ///< Branches taken, by funct3.
+        uint64_t not_taken[8] = { 0 };          ///< Branches not taken, by funct3.
+        uint64_t loads[4] = { 0 };              ///< Loads by log2 of their width.
+        uint64_t stores[4] = { 0 };             ///< Stores by log2 of their width.
+        uint64_t calls = { 0 };                 ///< jal that link.
+        uint64_t indirect_calls = { 0 };        ///< jalr that link.
+        uint64_t returns = { 0 };               ///< jalr through a link register that don't.
+        uint64_t jumps = { 0 };                 ///< All other jal and jalr.
+};
+
+#endif
@@ -14,8 +14,20 @@
 
 #include "hex.h"
 #include "memory.h"
+#include "symbol_table.h"
+#include "batch_runner.h"
 #include "rv32i_decode.h"
 #include "cpu_single_hart.h"
+#include "cpu_multi_hart.h"
+#include "host_syscalls.h"
+#include "checkpoint.h"
+#include "binary_trace.h"
+#include "insn_stats.h"
+#include "pc_profiler.h"
+#include "cache_model.h"
+#include "branch_model.h"
+#include "pipeline_model.h"
+#include "ooo_model.h"
 
 using std::cerr;
 using std::cout;
@@ -26,26 +38,78 @@ using std::endl;
  * ****************************************************************************/
 static void usage()
 {
-	cerr << "Usage: rv32i [-d] [-i] [-r] [-z] [-l exec-limit] [-m hex-mem-size] infile" << endl;
+	cerr << "Usage: rv32i [-c] [-d] [-i] [-p] [-r] [-s] [-z] [-e engine] [-l exec-limit] [-m hex-mem-size] [-n harts] [-t tracefile] infile" << endl;
+	cerr << "       rv32i [-p] [-e engine] [-j threads] -b manifest" << endl;
+	cerr << "       rv32i [options] [--checkpoint-at insn [--checkpoint-file file]] infile" << endl;
+	cerr << "       rv32i [options] --restore file" << endl;
+	cerr << "       rv32i [options] --profile period [--profile-folded file] infile" << endl;
+	cerr << "       rv32i [options] [--l1i cache] [--l1d cache] [--l2 cache] [--bpred] infile" << endl;
+	cerr << "       rv32i [options] --timing inorder|ooo [--latency class=cycles,...] [--core name=value,...] infile" << endl;
+	cerr << "    -b run the jobs in manifest in parallel and report on them" << endl;
+	cerr << "    -c execute compressed (RV32C) instructions (default for ELF files built with them)" << endl;
 	cerr << "    -d show disassembly before program execution" << endl;
+	cerr << "    -e execution engine: tick, block or jit (default = tick)" << endl;
 	cerr << "    -i show instruction printing during execution" << endl;
+	cerr << "    -j number of threads for -b (default = one per hardware thread)" << endl;
 	cerr << "    -l maximum number of instructions to exec" << endl;
-	cerr << "    -m specify memory size (default = 0x100)" << endl;
+	cerr << "    -m specify memory size (default = 0x100, at most 0x100000000)" << endl;
+	cerr << "    -n number of harts, each on its own thread with a 0x1000 byte stack (default = 1)" << endl;
+	cerr << "    -p use sparse paged memory, allocated on first write" << endl;
 	cerr << "    -r show register printing during execution" << endl;
+	cerr << "    -s show statistics on the instructions executed, as a table and as JSON" << endl;
+	cerr << "    -t record a binary trace of execution for rv32i_trace, instead of -i and -r" << endl;
 	cerr << "    -z show a dump of the regs & memory after simulation" << endl;
+	cerr << "    --checkpoint-at save the state after this many (hex) instructions, then carry on" << endl;
+	cerr << "    --checkpoint-file where --checkpoint-at saves the state (default = infile.ckpt, or file.ckpt with --restore)" << endl;
+	cerr << "    --restore resume from a saved state instead of loading infile" << endl;
+	cerr << "    --profile sample the pc every period (hex) instructions and print a flat profile" << endl;
+	cerr << "    --profile-folded write the --profile samples as folded stacks for flamegraph.pl" << endl;
+	cerr << "    --l1i, --l1d, --l2 simulate caches, each given as size:ways:line[:lru|fifo|random[:wb|wt]]" << endl;
+	cerr << "        (default L1s = 32k:4:64:lru:wb, no L2)" << endl;
+	cerr << "    --bpred run branches through static, bimodal, gshare and TAGE predictors and a return address stack" << endl;
+	cerr << "    --timing estimate cycles and CPI on a 5-stage in-order pipeline or an out-of-order core" << endl;
+	cerr << "    --latency set the cycles of the classes alu, mul, div, mem, branch and jump" << endl;
+	cerr << "        (default alu=1,mul=3,div=20,mem=1,branch=2,jump=1)" << endl;
+	cerr << "    --core set the out-of-order core's width, rob, regs and alu, mul, div and mem units" << endl;
+	cerr << "        (default width=4,rob=128,regs=128,alu=4,mul=1,div=1,mem=2)" << endl;
 	exit(1);
 }
 
 /**
  * @brief Disassembles all instructions in simulated memory.
  * @param mem The simulated memory.
+ * @param syms The program's symbols, printed as labels.
+ * @param compressed Decode 16-bit RV32C instructions as well, showing 
+ *        each as the 32-bit instruction it expands to.
  * ****************************************************************************/
-static void disassemble(const memory &mem)
+static void disassemble(const memory &mem, const symbol_table &syms, bool compressed)
 {
-	for (uint32_t i = 0; i < mem.get_size(); i += 4)
+	for (uint64_t i = 0; i < mem.get_size(); )
 	{
-		cout << hex::to_hex32(i) << ": " << hex::to_hex32(mem.get32(i)) << "  " << rv32i_decode::decode(i, mem.get32(i)) << endl;
+		if (!mem.is_mapped(i))
+		{
+			i = (i / memory::page_size + 1) * memory::page_size;	// skip pages nothing was loaded into
+			continue;
+		}
+
+		if (const symbol_table::symbol *s = syms.at(i))
+		{
+			cout << s->name << ":" << '\n';
+		}
+
+		uint16_t half = mem.get16(i);
+
+		if (compressed && rv32i_decode::is_compressed(half))
+		{
+			cout << hex::to_hex32(i) << ":     " << hex::to_hex16(half) << "  " << rv32i_decode::decode_cached(i, rv32i_decode::expand_compressed(half)) << '\n';
+			i += 2;
+			continue;
+		}
+
+		cout << hex::to_hex32(i) << ": " << hex::to_hex32(mem.get32(i)) << "  " << rv32i_decode::decode_cached(i, mem.get32(i)) << '\n';
+		i += 4;
 	}
+	cout.flush();
 }
 
 /**
@@ -53,26 +117,155 @@ static void disassemble(const memory &mem)
  * ****************************************************************************/
 int main(int argc, char **argv)
 {
-	uint32_t memory_limit = 0x100;	// default memory size is 0x100
+	uint64_t memory_limit = 0x100;	// default memory size is 0x100
+	bool paged_memory = false;
 	uint64_t exec_limit = 0;
+	bool compressed = false;
 	bool show_disassemble = false;
 	bool show_instructions = false;
 	bool show_registers = false;
 	bool dump_hart = false;
+	bool show_stats = false;
+	cpu_single_hart::engine engine = cpu_single_hart::engine::tick;
+	std::string manifest;
+	unsigned threads = 0;
+	unsigned hart_count = 1;
+	uint64_t checkpoint_at = 0;
+	std::string checkpoint_file;
+	std::string restore_file;
+	std::string trace_file;
+	uint64_t profile_period = 0;
+	std::string profile_file;
+	bool cache_sim = false;
+	cache::config l1i_config, l1d_config, l2_config;
+	bool has_l2 = false;
+	bool branch_sim = false;
+	std::string timing;
+	latencies lat;
+	ooo_model::config core;
+
+	static const struct option long_options[] =
+	{
+		{ "checkpoint-at",		required_argument,	nullptr, 'C' },
+		{ "checkpoint-file",	required_argument,	nullptr, 'F' },
+		{ "restore",			required_argument,	nullptr, 'R' },
+		{ "profile",			required_argument,	nullptr, 'P' },
+		{ "profile-folded",		required_argument,	nullptr, 'G' },
+		{ "l1i",				required_argument,	nullptr, 'I' },
+		{ "l1d",				required_argument,	nullptr, 'D' },
+		{ "l2",					required_argument,	nullptr, 'L' },
+		{ "bpred",				no_argument,		nullptr, 'B' },
+		{ "timing",				required_argument,	nullptr, 'T' },
+		{ "latency",			required_argument,	nullptr, 'Y' },
+		{ "core",				required_argument,	nullptr, 'K' },
+		{ nullptr,				0,					nullptr, 0 }
+	};
 
 	int opt;
-	while ((opt = getopt(argc, argv, "dil:m:rz")) != -1)
+	while ((opt = getopt_long(argc, argv, "b:cde:ij:l:m:n:prst:z", long_options, nullptr)) != -1)
 	{
 		switch(opt)
 		{
+			case 'C':
+				{
+					std::istringstream iss(optarg);
+					if (!(iss >> std::hex >> checkpoint_at) || checkpoint_at == 0)
+						usage();
+				}
+				break;
+
+			case 'F':
+				checkpoint_file = optarg;
+				break;
+
+			case 'R':
+				restore_file = optarg;
+				break;
+
+			case 'P':
+				{
+					std::istringstream iss(optarg);
+					if (!(iss >> std::hex >> profile_period) || profile_period == 0)
+						usage();
+				}
+				break;
+
+			case 'G':
+				profile_file = optarg;
+				break;
+
+			case 'I':
+				if (!cache::parse(optarg, l1i_config))
+					usage();
+				cache_sim = true;
+				break;
+
+			case 'D':
+				if (!cache::parse(optarg, l1d_config))
+					usage();
+				cache_sim = true;
+				break;
+
+			case 'L':
+				if (!cache::parse(optarg, l2_config))
+					usage();
+				cache_sim = has_l2 = true;
+				break;
+
+			case 'B':
+				branch_sim = true;
+				break;
+
+			case 'T':
+				timing = optarg;
+				if (timing != "inorder" && timing != "ooo")
+					usage();
+				break;
+
+			case 'Y':
+				if (!latencies::parse(optarg, lat))
+					usage();
+				break;
+
+			case 'K':
+				if (!ooo_model::config::parse(optarg, core))
+					usage();
+				break;
+
+			case 'b':
+				manifest = optarg;
+				break;
+
+			case 'c':
+				compressed = true;
+				break;
+
 			case 'd':
 				show_disassemble = true;
 				break;
 
+			case 'e':
+				if (std::string(optarg) == "tick")
+					engine = cpu_single_hart::engine::tick;
+				else if (std::string(optarg) == "block")
+					engine = cpu_single_hart::engine::block;
+				else if (std::string(optarg) == "jit")
+					engine = cpu_single_hart::engine::jit;
+				else
+					usage();
+				break;
+
 			case 'i':
 				show_instructions = true;
 				break;
 
+			case 'j':
+				{
+					std::istringstream iss(optarg);
+					iss >> threads;
+				}
+				break;
+
 			case 'l':
 				{
 					std::istringstream iss(optarg);
@@ -87,10 +280,30 @@ int main(int argc, char **argv)
 				}
 				break;
 
+			case 'n':
+				{
+					std::istringstream iss(optarg);
+					if (!(iss >> hart_count) || hart_count == 0)
+						usage();
+				}
+				break;
+
+			case 'p':
+				paged_memory = true;
+				break;
+
 			case 'r':
 				show_registers = true;
 				break;
 
+			case 's':
+				show_stats = true;
+				break;
+
+			case 't':
+				trace_file = optarg;
+				break;
+
 			case 'z':
 				dump_hart = true;
 				break;
@@ -100,30 +313,156 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (optind >= argc)
+	if (!manifest.empty())
+	{
+		batch_runner batch(paged_memory, engine);
+
+		if (!batch.load_manifest(manifest))
+			usage();
+
+		batch.run(threads);
+		return batch.report(cout) ? 0 : 1;
+	}
+
+	if ((restore_file.empty() && optind >= argc) || ((checkpoint_at || !restore_file.empty() || !trace_file.empty() || show_stats || profile_period || cache_sim || branch_sim || !timing.empty()) && hart_count > 1))
 		usage();
 
-	memory mem(memory_limit);
+	checkpoint restore;
 
-	if (!mem.load_file(argv[optind]))
+	if (!restore_file.empty() && !restore.load(restore_file))
 		usage();
 
+	memory mem(restore_file.empty() ? memory_limit : restore.get_mem_size(), paged_memory);
+
+	symbol_table syms;
+	uint32_t entry = 0;
+
+	if (restore_file.empty())	// otherwise everything comes from the checkpoint
+	{
+		if (memory::is_elf(argv[optind]))
+		{
+			uint32_t flags = 0;
+			if (!mem.load_elf(argv[optind], entry, &syms, &flags))
+				usage();
+			compressed = compressed || (flags & memory::elf_flag_rvc);
+		}
+		else if (!mem.load_file(argv[optind]))
+			usage();
+	}
+
 	if (show_disassemble)
 	{
-		disassemble(mem);
+		disassemble(mem, syms, compressed);
+	}
+
+	host_syscalls syscalls(mem);
+
+	if (hart_count > 1)
+	{
+		cpu_multi_hart cpu(mem, hart_count);
+		cpu.set_reset_pc(entry);
+		cpu.reset();
+		cpu.set_show_instructions(show_instructions);
+		cpu.set_show_registers(show_registers);
+		cpu.set_engine(engine);
+		cpu.set_compressed(compressed);
+		cpu.set_syscalls(&syscalls);
+		cpu.run(exec_limit);
+
+		if (dump_hart)
+		{
+			cpu.dump();
+			mem.dump();
+		}
+
+		return syscalls.get_exit_status() & 0xff;
 	}
 
 	cpu_single_hart cpu(mem);
+	cpu.set_reset_pc(entry);
 	cpu.reset();
 	cpu.set_show_instructions(show_instructions);
 	cpu.set_show_registers(show_registers);
+	cpu.set_engine(engine);
+	cpu.set_compressed(compressed);
+	cpu.set_syscalls(&syscalls);
+
+	if (!restore_file.empty() && !restore.restore(cpu, mem, syscalls))
+		return 1;
+
+	trace_writer trace;
+
+	if (!trace_file.empty())
+	{
+		if (!trace.open(trace_file))
+			return 1;
+
+		trace.start(cpu);
+		cpu.set_recorder(&trace);
+	}
+
+	insn_stats stats;
+
+	if (show_stats)
+		cpu.add_observer(&stats);
+
+	pc_profiler profiler(syms, profile_period);
+
+	if (profile_period)
+		cpu.add_observer(&profiler);
+
+	std::unique_ptr<cache_model> caches;
+
+	if (cache_sim)
+	{
+		caches.reset(new cache_model(l1i_config, l1d_config, has_l2 ? &l2_config : nullptr));
+		cpu.add_observer(caches.get());
+	}
+
+	std::unique_ptr<branch_model> branches;
+
+	if (branch_sim)
+	{
+		branches.reset(new branch_model(syms));
+		cpu.add_observer(branches.get());
+	}
+
+	std::unique_ptr<timing_model> pipeline;
+
+	if (!timing.empty())
+	{
+		if (timing == "ooo")
+			pipeline.reset(new ooo_model(core, lat));
+		else
+			pipeline.reset(new pipeline_model(lat));
+		cpu.add_observer(pipeline.get());
+	}
+
+	if (checkpoint_at && (!exec_limit || checkpoint_at <= exec_limit))
+	{
+		cpu.execute(checkpoint_at);
+		syscalls.flush();	// output so far belongs before the checkpoint
+
+		if (checkpoint_file.empty())
+			checkpoint_file = (restore_file.empty() ? std::string(argv[optind]) : restore_file) + ".ckpt";
+
+		if (!checkpoint::save(checkpoint_file, cpu, mem, syscalls))
+			return 1;
+	}
+
 	cpu.run(exec_limit);
 
+	if (!trace.finish())
+		return 1;
+
+	if (profile_period && !profile_file.empty() && !profiler.write_folded(profile_file))
+		return 1;
+
 	if (dump_hart)
 	{
 		cpu.dump();
 		mem.dump();
 	}
 
-	return 0;
+	return syscalls.get_exit_status() & 0xff;	// 0 unless the program exited with a status
 }
@@ -10,24 +10,59 @@
 //
 //******************************************************************************
 
+#include <algorithm>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "memory.h"
 
 // Allocate siz bytes in the mem vector and initialize every byte/element to 0xa5.
-memory::memory(uint32_t siz)
+memory::memory(uint64_t siz, bool paged) : paged(paged)
 {
-    siz = (siz+15)&0xfffffff0; // round the length up, mod-16
-    mem.resize(siz);
+    siz = (siz+15)&~uint64_t(15); // round the length up, mod-16
+    size = std::min<uint64_t>(siz, uint64_t(1) << 32);
 
-    for (size_t i = 0; i < mem.size(); ++i)
+    if (paged)
     {
-        mem.at(i) = 0xa5;
+        static const std::vector<uint8_t> pattern(page_size, 0xa5);
+
+        page_dir_size = (size + uint64_t(page_size) * table_size - 1) / (uint64_t(page_size) * table_size);
+        page_dir.reset(new std::atomic<page_table*>[page_dir_size]());
+        unmapped_page = pattern.data();
+        return;
     }
+
+    mem.assign(size, 0xa5);
 }
 
 // Destructor
 memory::~memory()
 {
     mem.clear();
+
+    for (uint32_t i = 0; i < page_dir_size; ++i)
+    {
+        page_table *t = page_dir[i].load();
+
+        if (t && file_map)
+        {
+            // pages in the file mapping aren't the page table's to delete
+            for (auto &p : t->page)
+            {
+                if (p.load() >= file_map && p.load() < file_map + file_map_len)
+                    p.store(nullptr);
+            }
+        }
+
+        delete t;
+    }
+
+    if (file_map)
+    {
+        munmap(file_map, file_map_len);
+    }
 }
 
  // Prints a warning message if an address is out of bounds.
@@ -35,33 +70,130 @@ bool memory::check_illegal(uint32_t addr) const
 {
     if (addr >= get_size())
     {
-        std::cerr << "WARNING: Address out of range: " << to_hex0x32(addr) << std::endl;
+        if (warnings)
+            std::cerr << "WARNING: Address out of range: " << to_hex0x32(addr) << std::endl;
         return true;
     }
     else return false;
 }
 
 // Gets the size of simulated memory.
-uint32_t memory::get_size() const
+uint64_t memory::get_size() const
+{
+    return size;
+}
+
+// Is the page holding addr backed by storage?
+bool memory::is_mapped(uint32_t addr) const
+{
+    if (!paged) { return true; }
+
+    const page_table *t = page_dir[addr / page_size / table_size].load(std::memory_order_acquire);
+    return t && t->page[addr / page_size % table_size].load(std::memory_order_acquire);
+}
+
+// Allocates the page holding addr and fills it with 0xa5.
+uint8_t *memory::map_page(uint32_t addr)
 {
-    return mem.size();
+    std::lock_guard<std::mutex> guard(map_lock);
+
+    std::atomic<page_table*> &t = page_dir[addr / page_size / table_size];
+
+    if (!t.load())
+    {
+        t.store(new page_table(), std::memory_order_release);
+    }
+
+    std::atomic<uint8_t*> &p = t.load()->page[addr / page_size % table_size];
+
+    if (!p.load())      // another thread may have just mapped it
+    {
+        uint8_t *page = new uint8_t[page_size];
+        std::memset(page, 0xa5, page_size);
+        p.store(page, std::memory_order_release);
+    }
+
+    return p.load();
+}
+
+// Backs pages of a paged memory with a copy-on-write mapping of a file.
+bool memory::map_file(const std::string &fname, uint64_t offset, const std::vector<uint32_t> &pages)
+{
+    if (!paged || file_map)
+    {
+        return false;
+    }
+
+    if (pages.empty())
+    {
+        return true;
+    }
+
+    int fd = open(fname.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        std::cerr << "Can't open file '" << fname << "' for reading." << std::endl;
+        return false;
+    }
+
+    size_t len = pages.size() * size_t(page_size);
+    void *p = mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, offset);
+    close(fd);
+
+    if (p == MAP_FAILED)
+    {
+        std::cerr << "Can't map file '" << fname << "'." << std::endl;
+        return false;
+    }
+
+    file_map = static_cast<uint8_t*>(p);
+    file_map_len = len;
+
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        uint64_t addr = uint64_t(pages[i]) * page_size;
+
+        if (addr >= get_size() || is_mapped(addr))
+        {
+            std::cerr << "Bad page number " << to_hex0x32(pages[i]) << " in '" << fname << "'." << std::endl;
+            return false;
+        }
+
+        std::atomic<page_table*> &t = page_dir[addr / page_size / table_size];
+
+        if (!t.load())
+        {
+            t.store(new page_table(), std::memory_order_release);
+        }
+
+        t.load()->page[addr / page_size % table_size].store(file_map + i * page_size, std::memory_order_release);
+    }
+
+    return true;
 }
 
 // Gets an 8bit value from memory.
 uint8_t memory::get8(uint32_t addr) const
 {
-    return check_illegal(addr) ? 0 : mem.at(addr);
+    if (in_range(addr, 1)) { return load8(addr); }
+
+    return check_illegal(addr) ? 0 : load8(addr);
 }
 
 // Gets a 16bit value from memory.
 uint16_t memory::get16(uint32_t addr) const
 {
+    if (in_range(addr, 2)) { return load16(addr); }
+
     return get8(addr) | get8(addr + 1) << 8;
 }
 
 // Gets a 32bit value from memory.
 uint32_t memory::get32(uint32_t addr) const
 {
+    if (in_range(addr, 4)) { return load32(addr); }
+
     return get16(addr) | get16(addr + 2) << 16;
 }
 
@@ -86,13 +218,17 @@ int32_t memory::get32_sx(uint32_t addr) const
 // Writes a 8bit value into memory if address is valid.
 void memory::set8(uint32_t addr, uint8_t val)
 {
+    if (in_range(addr, 1)) { store8(addr, val); return; }
+
     if (check_illegal(addr)) { return; }
-    else mem.at(addr) = val;
+    else store8(addr, val);
 }
 
 // Writes a 16bit value into memory if address is valid.
 void memory::set16(uint32_t addr, uint16_t val)
 {
+    if (in_range(addr, 2)) { store16(addr, val); return; }
+
     if (check_illegal(addr)) { return; }
     else
     {
@@ -104,6 +240,8 @@ void memory::set16(uint32_t addr, uint16_t val)
 // Writes a 32bit value into memory if address is valid.
 void memory::set32(uint32_t addr, uint32_t val)
 {
+    if (in_range(addr, 4)) { store32(addr, val); return; }
+
     if (check_illegal(addr)) { return; }
     else
     {
@@ -115,32 +253,45 @@ void memory::set32(uint32_t addr, uint32_t val)
 // Formats and dumps the contents of memory.
 void memory::dump() const
 {
-    for (uint32_t i = 0; i < get_size(); ++i)
+    // each line is formatted into a buffer and written at once
+    char line[8 + 2 + 16 * 3 + 1 + 1 + 16 + 1 + 1];
+
+    for (uint64_t i = 0; i < get_size(); i += 16)
     {
-        if (i % 16 == 0)
+        if (i % page_size == 0 && !is_mapped(i))
         {
-            std::cout << to_hex32(i) << ": ";
+            i += page_size - 16;    // nothing has been stored in this page
+            continue;
         }
 
-        if (i && (i % 8 == 0) && (i % 16 != 0))
-        {
-            std::cout << " ";
-        }
+        uint8_t bytes[16];
+        copy_out(i, bytes, 16);
 
-        std::cout << to_hex8(get8(i)) << " ";
+        char *p = put_hex(line, i, 8);
+        *p++ = ':';
+        *p++ = ' ';
 
-        if (i && (i + 1) % 16 == 0)
+        for (int j = 0; j < 16; ++j)
         {
-            std::cout << "*";
-
-            for (uint32_t j = i - 15; j <= i; ++j)
+            if (j == 8)
             {
-                isprint(get8(j)) ? std::cout << get8(j) : std::cout << ".";
+                *p++ = ' ';
             }
+            p = put_hex(p, bytes[j], 2);
+            *p++ = ' ';
+        }
 
-            std::cout << "*" << std::endl;
+        *p++ = '*';
+        for (int j = 0; j < 16; ++j)
+        {
+            *p++ = isprint(bytes[j]) ? bytes[j] : '.';
         }
+        *p++ = '*';
+        *p++ = '\n';
+
+        std::cout.write(line, p - line);
     }
+    std::cout.flush();
 }
 
 // Loads contents of an input file into memory.
@@ -154,21 +305,205 @@ bool memory::load_file(const std::string & fname )
         return false;
     }
 
-    uint8_t i;
-    infile >> std::noskipws;
-    
-    for (uint32_t addr = 0; infile >> i; ++addr)
+    infile.seekg(0, std::ios::end);
+    uint64_t len = infile.tellg();
+    infile.seekg(0, std::ios::beg);
+
+    if (len > get_size())
     {
-        if (check_illegal(addr))
+        check_illegal(get_size());      // warn about the first byte that doesn't fit
+        std::cerr << "Program too big." << std::endl;
+        return false;
+    }
+
+    // read straight into memory, one page at a time when paged
+    for (uint64_t addr = 0; addr < len; )
+    {
+        uint64_t n = paged ? std::min<uint64_t>(len - addr, page_size - addr % page_size) : len;
+
+        if (!infile.read(reinterpret_cast<char*>(write_ptr(addr)), n))
         {
-            std::cerr << "Program too big." << std::endl;
+            std::cerr << "Can't read file '" << fname << "'." << std::endl;
             return false;
         }
 
-        set8(addr, i);
+        addr += n;
     }
 
     infile.close();
+    image_end = len;
+
+    return true;
+}
+
+// Copies len bytes into memory starting at addr.
+void memory::copy_in(uint32_t addr, const uint8_t *src, uint64_t len)
+{
+    for (uint64_t done = 0; done < len; )
+    {
+        uint32_t a = addr + done;
+        uint64_t n = paged ? std::min<uint64_t>(len - done, page_size - a % page_size) : len - done;
+
+        if (src)
+            std::memcpy(write_ptr(a), src + done, n);
+        else
+            std::memset(write_ptr(a), 0, n);
+
+        done += n;
+    }
+}
+
+// Copies len bytes out of memory starting at addr.
+void memory::copy_out(uint32_t addr, uint8_t *dst, uint64_t len) const
+{
+    for (uint64_t done = 0; done < len; )
+    {
+        uint32_t a = addr + done;
+        uint64_t n = paged ? std::min<uint64_t>(len - done, page_size - a % page_size) : len - done;
+
+        std::memcpy(dst + done, read_ptr(a), n);
+        done += n;
+    }
+}
+
+/**
+ * @brief Reads a little-endian field out of an ELF image.
+ * @param img The file contents.
+ * @param off The offset of the field, which must be inside of img.
+ * @param len The size of the field in bytes.
+ * @return The value of the field.
+ * ****************************************************************************/
+static uint32_t elf_field(const std::vector<uint8_t> &img, uint64_t off, int len)
+{
+    uint32_t v = 0;
+    for (int i = len - 1; i >= 0; --i)
+    {
+        v = (v << 8) | img[off + i];
+    }
+    return v;
+}
+
+// Is the file an ELF executable rather than a flat image?
+bool memory::is_elf(const std::string &fname)
+{
+    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+    char magic[4];
+
+    return infile.read(magic, sizeof(magic)) && std::memcmp(magic, "\x7f" "ELF", 4) == 0;
+}
+
+// Loads an ELF32 RISC-V executable into memory.
+bool memory::load_elf(const std::string &fname, uint32_t &entry, symbol_table *syms, uint32_t *flags)
+{
+    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+
+    if (!infile)
+    {
+        std::cerr << "Can't open file '" << fname << "' for reading." << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> img((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+
+    // a 32-bit, little-endian, RISC-V executable
+    if (img.size() < 52 || std::memcmp(img.data(), "\x7f" "ELF", 4) != 0 || img[4] != 1 || img[5] != 1
+        || elf_field(img, 16, 2) != 2 || elf_field(img, 18, 2) != 243)
+    {
+        std::cerr << "'" << fname << "' is not an ELF32 RISC-V executable." << std::endl;
+        return false;
+    }
+
+    entry = elf_field(img, 24, 4);
+    if (flags)
+    {
+        *flags = elf_field(img, 36, 4);
+    }
+    uint64_t phoff = elf_field(img, 28, 4);
+    uint64_t shoff = elf_field(img, 32, 4);
+    uint32_t phentsize = elf_field(img, 42, 2);
+    uint32_t phnum = elf_field(img, 44, 2);
+    uint32_t shentsize = elf_field(img, 46, 2);
+    uint32_t shnum = elf_field(img, 48, 2);
+
+    if ((phnum && (phentsize < 32 || phoff + uint64_t(phnum) * phentsize > img.size()))
+        || (shnum && (shentsize < 40 || shoff + uint64_t(shnum) * shentsize > img.size())))
+    {
+        std::cerr << "'" << fname << "' is truncated." << std::endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < phnum; ++i)
+    {
+        uint64_t ph = phoff + uint64_t(i) * phentsize;
+
+        if (elf_field(img, ph, 4) != 1)     // PT_LOAD
+            continue;
+
+        uint64_t offset = elf_field(img, ph + 4, 4);
+        uint64_t vaddr = elf_field(img, ph + 8, 4);
+        uint64_t filesz = elf_field(img, ph + 16, 4);
+        uint64_t memsz = elf_field(img, ph + 20, 4);
+
+        if (filesz > memsz || offset + filesz > img.size())
+        {
+            std::cerr << "'" << fname << "' is truncated." << std::endl;
+            return false;
+        }
+
+        if (vaddr + memsz > get_size())
+        {
+            check_illegal(std::max(vaddr, get_size()));     // warn about the first byte that doesn't fit
+            std::cerr << "Program too big." << std::endl;
+            return false;
+        }
+
+        copy_in(vaddr, img.data() + offset, filesz);
+        copy_in(vaddr + filesz, nullptr, memsz - filesz);   // .bss
+        image_end = std::max<uint64_t>(image_end, vaddr + memsz);
+    }
+
+    if (!syms)
+        return true;
+
+    for (uint32_t i = 0; i < shnum; ++i)
+    {
+        uint64_t sh = shoff + uint64_t(i) * shentsize;
+
+        if (elf_field(img, sh + 4, 4) != 2)     // SHT_SYMTAB
+            continue;
+
+        uint64_t offset = elf_field(img, sh + 16, 4);
+        uint64_t size = elf_field(img, sh + 20, 4);
+        uint32_t link = elf_field(img, sh + 24, 4);
+        uint64_t entsize = elf_field(img, sh + 36, 4);
+
+        if (link >= shnum || entsize < 16 || offset + size > img.size())
+            continue;
+
+        uint64_t str = shoff + uint64_t(link) * shentsize;
+        uint64_t stroff = elf_field(img, str + 16, 4);
+        uint64_t strsize = elf_field(img, str + 20, 4);
+
+        if (stroff + strsize > img.size())
+            continue;
+
+        for (uint64_t sym = offset; sym + entsize <= offset + size; sym += entsize)
+        {
+            uint32_t name = elf_field(img, sym, 4);
+            uint32_t type = img[sym + 12] & 0xf;
+            uint32_t shndx = elf_field(img, sym + 14, 2);
+
+            // named functions, objects and labels that are defined somewhere
+            if (name == 0 || name >= strsize || type > 2 || shndx == 0 || shndx >= 0xff00)
+                continue;
+
+            const char *s = reinterpret_cast<const char*>(img.data() + stroff + name);
+            const char *e = std::find(s, reinterpret_cast<const char*>(img.data() + stroff + strsize), '\0');
+            syms->add(elf_field(img, sym + 4, 4), elf_field(img, sym + 8, 4), std::string(s, e));
+        }
+    }
+
+    syms->sort();
 
     return true;
 }
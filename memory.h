@@ -13,11 +13,17 @@
 //
 //******************************************************************************
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <cctype>
+#include <cstring>
 #include <fstream>
 
 #include "hex.h"
+#include "symbol_table.h"
 
 /**
  * @brief Class to handle reading from/writing to simulated memory.
@@ -28,8 +34,17 @@ class memory : public hex
         /**
          * @brief Allocate siz bytes in the mem vector and initialize every 
          *        byte/element to 0xa5.
+         * 
+         * When paged is true nothing is allocated up front. Instead pages of 
+         * page_size bytes are allocated the first time they are written to, 
+         * and pages that have never been written read as 0xa5. This makes 
+         * even a memory spanning the whole 32-bit address space (siz = 
+         * 0x100000000) cost only as much as the pages actually used.
+         * 
+         * @param siz The number of bytes of memory, at most 0x100000000.
+         * @param paged Use sparse pages instead of one dense vector.
          * ****************************************************************************/
-        memory(uint32_t siz); 
+        memory(uint64_t siz, bool paged = false); 
 
         /**
          * @brief Destructor
@@ -43,11 +58,80 @@ class memory : public hex
          * ****************************************************************************/
         bool check_illegal(uint32_t addr) const;
 
+        /**
+         * @brief Mutator for warnings.
+         * @param b false to stop check_illegal() from printing anything.
+         * ****************************************************************************/
+        void set_warnings(bool b) { warnings = b; }
+
+        /**
+         * @brief Checks that an access lies entirely inside of memory 
+         *        without printing anything.
+         * @param addr The address of the first byte.
+         * @param len The number of bytes accessed.
+         * @return true if every byte of the access is in range.
+         * ****************************************************************************/
+        bool in_range(uint32_t addr, uint32_t len) const { return addr < size && len <= size - addr; }
+
+        /**
+         * @brief Fast-path accessors. These do no range checking: the caller 
+         *        must have checked the access with in_range(). Values are 
+         *        little-endian, as with the get/set methods.
+         * ****************************************************************************/
+        uint8_t load8(uint32_t addr) const { return *read_ptr(addr); }
+        uint16_t load16(uint32_t addr) const { return from_le(load<uint16_t>(addr)); }   ///< @copydoc load8
+        uint32_t load32(uint32_t addr) const { return from_le(load<uint32_t>(addr)); }   ///< @copydoc load8
+        void store8(uint32_t addr, uint8_t val) { *write_ptr(addr) = val; }              ///< @copydoc load8
+        void store16(uint32_t addr, uint16_t val) { store<uint16_t>(addr, from_le(val)); } ///< @copydoc load8
+        void store32(uint32_t addr, uint32_t val) { store<uint32_t>(addr, from_le(val)); } ///< @copydoc load8
+
+        /**
+         * @brief Copies len bytes into memory starting at addr.
+         * @param addr The first address, with [addr, addr + len) in range.
+         * @param src The bytes to copy, or nullptr to store zeros.
+         * @param len The number of bytes.
+         * ****************************************************************************/
+        void copy_in(uint32_t addr, const uint8_t *src, uint64_t len);
+
+        /**
+         * @brief Copies len bytes out of memory starting at addr.
+         * @param addr The first address, with [addr, addr + len) in range.
+         * @param dst Where to copy the bytes to.
+         * @param len The number of bytes.
+         * ****************************************************************************/
+        void copy_out(uint32_t addr, uint8_t *dst, uint64_t len) const;
+
+        /**
+         * @brief Gets the end of the loaded program.
+         * @return One past the highest address written by load_file() or 
+         *         load_elf() (including .bss), or 0 if nothing was loaded.
+         * ****************************************************************************/
+        uint64_t get_image_end() const { return image_end; }
+
         /**
          * @brief Gets the size of simulated memory.
          * @return The (rounded up) number of bytes in the simulated memory.
          * ****************************************************************************/
-        uint32_t get_size() const;
+        uint64_t get_size() const;
+
+        /**
+         * @brief Is the memory sparse pages rather than one dense vector?
+         * @return The paged flag given to the constructor.
+         * ****************************************************************************/
+        bool is_paged() const { return paged; }
+
+        /**
+         * @brief Is the page holding addr backed by storage? 
+         * @param addr The address to check.
+         * @return Always true for dense memory. For paged memory, true once
+         *         the page has been written to.
+         * ****************************************************************************/
+        bool is_mapped(uint32_t addr) const;
+
+        /**
+         * @brief Number of bytes in one page of paged memory.
+         * ****************************************************************************/
+        static constexpr uint32_t page_size = 4096;
 
         /**
          * @brief Gets an 8bit value from memory.
@@ -125,17 +209,246 @@ class memory : public hex
 
         /**
          * @brief Loads contents of an input file into memory.
+         * 
+         * The file's size is checked against the memory size once, then the
+         * whole file is read straight into the backing storage.
+         * 
          * @param fname File name of the file to load.
          * @returns True if file imported successfully, otherwise false.
          * ****************************************************************************/
         bool load_file(const std::string & fname );
 
+        /**
+         * @brief Is the file an ELF executable rather than a flat image?
+         * @param fname File name of the file to check.
+         * @returns True if the file starts with the ELF magic number.
+         * ****************************************************************************/
+        static bool is_elf(const std::string &fname);
+
+        /**
+         * @brief Loads an ELF32 RISC-V executable into memory.
+         * 
+         * Each PT_LOAD segment is copied to its virtual address and the part 
+         * of it that isn't in the file (.bss) is zero-filled. Nothing else in
+         * memory is touched.
+         * 
+         * @param fname File name of the file to load.
+         * @param entry Set to the program's entry point.
+         * @param syms If not nullptr, the program's function and object 
+         *        symbols are added to it and it is sorted.
+         * @param flags If not nullptr, set to the header's e_flags, which 
+         *        say (in elf_flag_rvc) whether the code uses RV32C.
+         * @returns True if file imported successfully, otherwise false.
+         * ****************************************************************************/
+        bool load_elf(const std::string &fname, uint32_t &entry, symbol_table *syms = nullptr, uint32_t *flags = nullptr);
+
+        /**
+         * @brief Backs pages of a paged memory with a copy-on-write mapping
+         *        of a file, so that they needn't be read in or copied.
+         * 
+         * Stores to the pages change only the memory, never the file. The
+         * file may be removed once this returns.
+         * 
+         * @param fname File name of the file to map.
+         * @param offset Offset in the file of the first page's contents, a
+         *        multiple of the host's page size.
+         * @param pages The page numbers (address / page_size) of the pages,
+         *        in the order their contents appear in the file. None may 
+         *        be mapped yet.
+         * @returns True if the file was mapped, otherwise false.
+         * ****************************************************************************/
+        bool map_file(const std::string &fname, uint64_t offset, const std::vector<uint32_t> &pages);
+
+        /**
+         * @brief The e_flags bit set in executables that contain compressed
+         *        (RV32C) instructions.
+         * ****************************************************************************/
+        static constexpr uint32_t elf_flag_rvc = 0x1;
+
     private:
+
+        /**
+         * @brief Host-width load of an unaligned value.
+         * @param addr The address of the first byte.
+         * @return The bytes at addr in host order.
+         * ****************************************************************************/
+        template<typename T>
+        T load(uint32_t addr) const
+        {
+            T v;
+            if (!paged || addr % page_size <= page_size - sizeof(T))
+            {
+                std::memcpy(&v, read_ptr(addr), sizeof(v));
+            }
+            else
+            {
+                uint8_t b[sizeof(T)];   // straddles two pages
+                for (size_t i = 0; i < sizeof(T); ++i) { b[i] = *read_ptr(addr + i); }
+                std::memcpy(&v, b, sizeof(v));
+            }
+            return v;
+        }
+
+        /**
+         * @brief Host-width store of an unaligned value.
+         * @param addr The address of the first byte.
+         * @param v The value, in host order.
+         * ****************************************************************************/
+        template<typename T>
+        void store(uint32_t addr, T v)
+        {
+            if (!paged || addr % page_size <= page_size - sizeof(T))
+            {
+                std::memcpy(write_ptr(addr), &v, sizeof(v));
+            }
+            else
+            {
+                uint8_t b[sizeof(T)];   // straddles two pages
+                std::memcpy(b, &v, sizeof(v));
+                for (size_t i = 0; i < sizeof(T); ++i) { *write_ptr(addr + i) = b[i]; }
+            }
+        }
+
+        /**
+         * @brief Finds the byte at addr for reading.
+         * @param addr An address that is in range.
+         * @return A pointer to the byte. For a paged memory the rest of the 
+         *         page follows it, and unmapped pages point into a shared 
+         *         page of 0xa5 bytes.
+         * ****************************************************************************/
+        const uint8_t *read_ptr(uint32_t addr) const
+        {
+            if (!paged) { return &mem[addr]; }
+
+            const page_table *t = page_dir[addr / page_size / table_size].load(std::memory_order_acquire);
+            const uint8_t *p = t ? t->page[addr / page_size % table_size].load(std::memory_order_acquire) : nullptr;
+            return (p ? p : unmapped_page) + addr % page_size;
+        }
+
+        /**
+         * @brief Finds the byte at addr for writing, allocating its page 
+         *        first if needed.
+         * @param addr An address that is in range.
+         * @return A pointer to the byte.
+         * ****************************************************************************/
+        uint8_t *write_ptr(uint32_t addr)
+        {
+            if (!paged) { return &mem[addr]; }
+
+            page_table *t = page_dir[addr / page_size / table_size].load(std::memory_order_acquire);
+            uint8_t *p = t ? t->page[addr / page_size % table_size].load(std::memory_order_acquire) : nullptr;
+            return (p ? p : map_page(addr)) + addr % page_size;
+        }
+
+        /**
+         * @brief Allocates the page holding addr and fills it with 0xa5.
+         * 
+         * Harts on other threads may be looking pages up at the same time,
+         * so new tables and pages are published atomically under map_lock.
+         * 
+         * @param addr An address in the page.
+         * @return A pointer to the start of the new page.
+         * ****************************************************************************/
+        uint8_t *map_page(uint32_t addr);
+
+        /**
+         * @brief Converts between little-endian and host byte order.
+         * @param v The value to convert.
+         * @return v, byte swapped on big-endian hosts.
+         * ****************************************************************************/
+        static uint16_t from_le(uint16_t v)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return __builtin_bswap16(v);
+#else
+            return v;
+#endif
+        }
+
+        /**
+         * @copydoc from_le(uint16_t)
+         * ****************************************************************************/
+        static uint32_t from_le(uint32_t v)
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return __builtin_bswap32(v);
+#else
+            return v;
+#endif
+        }
     
         /**
-         * @brief A vector of bytes representing the simulated memory.
+         * @brief Number of pages described by one second-level page table.
+         * ****************************************************************************/
+        static constexpr uint32_t table_size = 1024;
+
+        /**
+         * @brief A second-level page table. It owns its pages.
+         * ****************************************************************************/
+        struct page_table
+        {
+            std::array<std::atomic<uint8_t*>, table_size> page; ///< The pages, nullptr if unmapped.
+
+            ~page_table() { for (auto &p : page) { delete[] p.load(); } }
+        };
+
+        /**
+         * @brief The (rounded up) number of bytes in the simulated memory.
+         * ****************************************************************************/
+        uint64_t size;
+
+        /**
+         * @brief True if memory is sparse pages rather than the mem vector.
+         * ****************************************************************************/
+        bool paged;
+
+        /**
+         * @brief True if check_illegal() prints warnings.
+         * ****************************************************************************/
+        bool warnings = { true };
+
+        /**
+         * @brief One past the highest address of the loaded program.
+         * ****************************************************************************/
+        uint64_t image_end = { 0 };
+
+        /**
+         * @brief A vector of bytes representing the simulated memory. Empty
+         *        when paged.
          * ****************************************************************************/
         std::vector<uint8_t> mem;
+
+        /**
+         * @brief The top-level page table of a paged memory, indexed by the 
+         *        upper bits of the address.
+         * ****************************************************************************/
+        std::unique_ptr<std::atomic<page_table*>[]> page_dir;
+
+        /**
+         * @brief Number of entries in page_dir.
+         * ****************************************************************************/
+        uint32_t page_dir_size = { 0 };
+
+        /**
+         * @brief Serializes map_page().
+         * ****************************************************************************/
+        std::mutex map_lock;
+
+        /**
+         * @brief A page of 0xa5 bytes that stands in for unmapped pages.
+         * ****************************************************************************/
+        const uint8_t *unmapped_page = { nullptr };
+
+        /**
+         * @brief The mapping made by map_file(), if any. Its pages belong 
+         *        to it rather than to the page tables.
+         * ****************************************************************************/
+        uint8_t *file_map = { nullptr };
+
+        /**
+         * @brief The length of file_map in bytes.
+         * ****************************************************************************/
+        size_t file_map_len = { 0 };
 };
 
 #endif
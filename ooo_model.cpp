@@ -0,0 +1,428 @@
+//******************************************************************************
+//
+// ooo_model.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include "ooo_model.h"
+
+// Parses a list of name=value pairs.
+bool ooo_model::config::parse(const std::string &spec, config &c)
+{
+    std::istringstream iss(spec);
+    std::string item;
+    config n = c;
+
+    while (std::getline(iss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq + 1 == item.size())
+            return false;
+
+        char *end;
+        std::string value = item.substr(eq + 1);
+        unsigned long v = std::strtoul(value.c_str(), &end, 0);
+        if (*end || v == 0 || v > 4096)
+            return false;
+
+        std::string name = item.substr(0, eq);
+        if (name == "width")
+            n.width = v;
+        else if (name == "rob")
+            n.rob = v;
+        else if (name == "regs")
+            n.regs = v;
+        else if (name == "alu")
+            n.alu = v;
+        else if (name == "mul")
+            n.mul = v;
+        else if (name == "div")
+            n.div = v;
+        else if (name == "mem")
+            n.mem = v;
+        else
+            return false;
+    }
+
+    // the architectural registers are always mapped, so rename needs more
+    if (n.regs <= 32 || n.width > 64)
+        return false;
+
+    c = n;
+    return true;
+}
+
+// Constructor. Starts the model's thread.
+ooo_model::ooo_model(const config &c, const latencies &lat)
+    : cfg(c), lat(lat), rob_commits(c.rob), reg_commits(c.regs - 32), issue_slots(issue_window),
+      stores(store_table_size), targets(target_table_size), ras(ras_depth)
+{
+    units[unit_alu] = c.alu;
+    units[unit_mul] = c.mul;
+    units[unit_div] = c.div;
+    units[unit_mem] = c.mem;
+
+    for (auto &u : unit_slots)
+    {
+        u.resize(issue_window);
+    }
+
+    thread = std::thread(&ooo_model::run, this);
+}
+
+// Destructor.
+ooo_model::~ooo_model()
+{
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+}
+
+// Queues a batch of instructions for the model's thread.
+void ooo_model::retired_batch(const retired_insn *r, size_t n)
+{
+    while (n)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t room;
+
+        while ((room = ring_size - (h - tail.load(std::memory_order_acquire))) == 0)
+        {
+            std::this_thread::yield();      // full, wait for the model to catch up
+        }
+
+        // copy up to the end of the ring, then around to its start
+        size_t k = std::min<uint64_t>(n, room);
+        size_t first = std::min<uint64_t>(k, ring_size - h % ring_size);
+        std::copy(r, r + first, &ring[h % ring_size]);
+        std::copy(r + first, r + k, &ring[0]);
+        head.store(h + k, std::memory_order_release);
+
+        r += k;
+        n -= k;
+    }
+}
+
+// The model's thread.
+void ooo_model::run()
+{
+    uint64_t n = tail.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        uint64_t end = head.load(std::memory_order_acquire);
+
+        if (n != end)
+        {
+            for (uint64_t stop = std::min(end, n + release_quantum); n != stop; ++n)
+            {
+                model(ring[n % ring_size]);
+            }
+            tail.store(n, std::memory_order_release);
+            continue;
+        }
+
+        // stopping is set after the last instruction is pushed, so look again
+        if (stopping.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == n)
+            return;
+
+        std::this_thread::yield();
+    }
+}
+
+// Times one instruction.
+void ooo_model::model(const retired_insn &r)
+{
+    insn_class cls = classify(r.insn);
+    uint32_t rd = destination(r);
+
+    // dispatch, in order
+    uint64_t d = dispatched == cfg.width ? dispatch_cycle + 1 : dispatch_cycle;
+
+    if (fetch_ready > d)
+    {
+        frontend_stalls += fetch_ready - d;
+        d = fetch_ready;
+    }
+    if (seq >= cfg.rob && rob_commits[seq % cfg.rob] + 1 > d)
+    {
+        rob_stalls += rob_commits[seq % cfg.rob] + 1 - d;      // the oldest entry's commit frees one
+        d = rob_commits[seq % cfg.rob] + 1;
+    }
+
+    uint32_t rename_regs = cfg.regs - 32;
+    if (rd && writers >= rename_regs && reg_commits[writers % rename_regs] + 1 > d)
+    {
+        reg_stalls += reg_commits[writers % rename_regs] + 1 - d;
+        d = reg_commits[writers % rename_regs] + 1;
+    }
+
+    if (d != dispatch_cycle)
+    {
+        dispatch_cycle = d;
+        dispatched = 0;
+    }
+    ++dispatched;
+
+    // issue, once the operands are ready and a unit is free
+    uint64_t issue = d + 1;
+
+    uint32_t src[2];
+    sources(r, src);
+    for (uint32_t s : src)
+    {
+        if (s)
+        {
+            issue = std::max(issue, ready[s]);
+        }
+    }
+
+    bool memory = cls == insn_class::load || cls == insn_class::store;
+    uint32_t word = r.addr >> 2;
+    std::pair<uint32_t, uint64_t> &store = stores[word % store_table_size];
+
+    if (cls == insn_class::load && store.first == word && store.second > issue)
+    {
+        ++store_waits;
+        issue = store.second;
+    }
+
+    unit_kind kind = cls == insn_class::mul ? unit_mul : cls == insn_class::div ? unit_div : memory ? unit_mem : unit_alu;
+    uint32_t busy = kind == unit_div ? lat.div : 1;        // only the dividers aren't pipelined
+    uint64_t operands = issue;
+    bool unit_wait = false, width_wait = false;
+
+    for (;; ++issue)
+    {
+        if (!unit_free(kind, issue, busy))
+            unit_wait = true;
+        else if (slot(issue_slots, issue) == cfg.width)
+            width_wait = true;
+        else
+            break;
+    }
+
+    ++slot(issue_slots, issue);
+    for (uint32_t i = 0; i < busy; ++i)
+    {
+        ++slot(unit_slots[kind], issue + i);
+    }
+
+    // a wait is blamed on whatever held the instruction up first
+    if (unit_wait)
+    {
+        ++unit_waits[kind];
+        unit_wait_cycles[kind] += issue - operands;
+    }
+    else if (width_wait)
+    {
+        ++width_waits;
+        width_wait_cycles += issue - operands;
+    }
+
+    uint32_t latency = kind == unit_mul ? lat.mul : kind == unit_div ? lat.div : memory ? lat.alu + lat.mem : lat.alu;
+    uint64_t complete = issue + latency;
+
+    if (rd)
+    {
+        ready[rd] = complete;
+    }
+    if (cls == insn_class::store)
+    {
+        store = std::make_pair(word, complete);
+    }
+
+    if (mispredicted(r, cls))
+    {
+        ++mispredicts;
+        fetch_ready = std::max(fetch_ready, complete + lat.branch);
+    }
+
+    // commit, in order
+    uint64_t c = std::max(complete, commit_cycle);
+    if (c == commit_cycle && committed == cfg.width)
+    {
+        ++c;
+    }
+    if (c != commit_cycle)
+    {
+        commit_cycle = c;
+        committed = 0;
+    }
+    ++committed;
+
+    rob_commits[seq % cfg.rob] = c;
+    if (rd)
+    {
+        reg_commits[writers % rename_regs] = c;
+        ++writers;
+    }
+    ++seq;
+    cycles = c + 1;
+}
+
+// Decides whether the front end would have mispredicted a branch or jump.
+bool ooo_model::mispredicted(const retired_insn &r, insn_class cls)
+{
+    switch (cls)
+    {
+        default:
+            return false;
+
+        case insn_class::branch:
+        {
+            bool taken = r.next_pc != r.pc + r.len;
+            bool miss = gshare.predict(r.pc, r.pc + get_imm_b(r.insn)) != taken;
+            gshare.update(r.pc, taken);
+            return miss;
+        }
+
+        case insn_class::jal:
+            if (is_call(r))
+            {
+                ras_top = (ras_top + 1) % ras_depth;
+                ras[ras_top] = r.pc + r.len;
+            }
+            return false;       // the target is known once it is decoded
+
+        case insn_class::jalr:
+            if (is_return(r))
+            {
+                bool miss = ras[ras_top] != r.next_pc;
+                ras_top = (ras_top + ras_depth - 1) % ras_depth;
+                return miss;
+            }
+
+            uint32_t &target = targets[(r.pc >> 1) % target_table_size];
+            bool miss = target != r.next_pc;
+            target = r.next_pc;
+
+            if (is_call(r))
+            {
+                ras_top = (ras_top + 1) % ras_depth;
+                ras[ras_top] = r.pc + r.len;
+            }
+            return miss;
+    }
+}
+
+// The number of things counted against a cycle.
+uint32_t &ooo_model::slot(std::vector<std::pair<uint64_t, uint32_t>> &slots, uint64_t cycle)
+{
+    if (cycle - dispatch_cycle >= slots.size())
+    {
+        grow_window(cycle - dispatch_cycle + 1);
+    }
+
+    std::pair<uint64_t, uint32_t> &s = slots[cycle % slots.size()];
+
+    if (s.first != cycle)
+    {
+        s = std::make_pair(cycle, 0u);
+    }
+    return s.second;
+}
+
+// Grows the windows of cycles, keeping the counts still in use.
+void ooo_model::grow_window(uint64_t span)
+{
+    size_t size = issue_slots.size();
+
+    while (size < span)
+    {
+        size *= 2;
+    }
+
+    auto regrow = [&](std::vector<std::pair<uint64_t, uint32_t>> &slots)
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> grown(size);
+
+        for (const auto &s : slots)
+        {
+            if (s.first >= dispatch_cycle)      // nothing can issue in the cycles before it
+                grown[s.first % size] = s;
+        }
+        slots.swap(grown);
+    };
+
+    regrow(issue_slots);
+    for (auto &u : unit_slots)
+    {
+        regrow(u);
+    }
+}
+
+// Is a unit of a kind free for a span of cycles?
+bool ooo_model::unit_free(unit_kind kind, uint64_t cycle, uint32_t span)
+{
+    for (uint32_t i = 0; i < span; ++i)
+    {
+        if (slot(unit_slots[kind], cycle + i) == units[kind])
+            return false;
+    }
+    return true;
+}
+
+// Prints the cycles, the IPC, what held up dispatch and the structural hazards.
+void ooo_model::report(std::ostream &os) const
+{
+    while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+
+    auto ratio = [](uint64_t n, uint64_t of)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3) << (of ? double(n) / of : 0.0);
+        return ss.str();
+    };
+    auto pct = [](uint64_t n, uint64_t of)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2) << (of ? 100.0 * n / of : 0.0) << "%";
+        return ss.str();
+    };
+
+    os << "Timing (out-of-order, width " << cfg.width << ", rob " << cfg.rob << ", " << cfg.regs << " registers, "
+       << cfg.alu << " alu, " << cfg.mul << " mul, " << cfg.div << " div, " << cfg.mem << " mem): "
+       << cycles << " cycles, " << seq << " instructions, IPC " << ratio(seq, cycles) << std::endl;
+
+    os << std::left << std::setw(24) << "Dispatch stalls" << std::right << std::setw(14) << "cycles"
+       << std::setw(9) << "%" << std::endl;
+
+    const std::pair<const char *, uint64_t> stalls[] =
+    {
+        { "reorder buffer full", rob_stalls },
+        { "registers full", reg_stalls },
+        { "mispredict refill", frontend_stalls },
+    };
+    for (const auto &row : stalls)
+    {
+        os << "  " << std::left << std::setw(22) << row.first << std::right << std::setw(14) << row.second
+           << std::setw(9) << pct(row.second, cycles) << std::endl;
+    }
+    os << "  " << mispredicts << " mispredicted branches and jumps, " << store_waits << " loads waited on a store" << std::endl;
+
+    os << std::left << std::setw(24) << "Structural hazards" << std::right << std::setw(14) << "instructions"
+       << std::setw(14) << "cycles" << std::endl;
+
+    static const char *const unit_names[unit_kinds] = { "alu busy", "mul busy", "div busy", "mem port busy" };
+    for (int k = 0; k < unit_kinds; ++k)
+    {
+        os << "  " << std::left << std::setw(22) << unit_names[k] << std::right << std::setw(14) << unit_waits[k]
+           << std::setw(14) << unit_wait_cycles[k] << std::endl;
+    }
+    os << "  " << std::left << std::setw(22) << "issue width" << std::right << std::setw(14) << width_waits
+       << std::setw(14) << width_wait_cycles << std::endl;
+}
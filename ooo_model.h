@@ -0,0 +1,238 @@
+#ifndef OOO_MODEL_H
+#define OOO_MODEL_H
+
+//******************************************************************************
+//
+// ooo_model.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "branch_model.h"
+#include "timing_model.h"
+
+/**
+ * @brief Class to estimate the cycles a program takes on a superscalar
+ *        out-of-order core.
+ *
+ * Instructions are dispatched in order, up to width a cycle, into a
+ * reorder buffer, renamed onto physical registers, issued to a functional
+ * unit once their operands are ready, and committed in order, up to width
+ * a cycle. Dispatch waits for a free reorder buffer entry, for a free
+ * physical register if the instruction writes one, and after a mispredicted
+ * branch, for the branch to execute and the front end to refill. Branches
+ * are predicted by a gshare predictor, returns by a return address stack
+ * and other jalr by the target they last went to. A load waits for an
+ * earlier store to the same word.
+ *
+ * The model is trace driven: it is fed the instructions the hart commits,
+ * so wrong-path instructions are not simulated, only the time they waste.
+ * The hart pushes each batch of instructions into a lock-free single-
+ * producer/single-consumer ring and the model runs on a thread of its own.
+ * Modelling an instruction takes longer than executing it, so the hart
+ * runs up to a ring ahead and then waits for the model: with a core to
+ * spare a run takes about as long as the model alone, on one core as long
+ * as both.
+ * ****************************************************************************/
+class ooo_model : public timing_model
+{
+    public:
+        /**
+         * @brief The shape of the core.
+         * ********************************************************************/
+        struct config
+        {
+            uint32_t width = { 4 };     ///< Instructions dispatched, issued and committed a cycle.
+            uint32_t rob = { 128 };     ///< Reorder buffer entries.
+            uint32_t regs = { 128 };    ///< Physical integer registers, the 32 architectural ones included.
+            uint32_t alu = { 4 };       ///< Integer units, which also execute branches, jumps and system instructions.
+            uint32_t mul = { 1 };       ///< Pipelined multipliers.
+            uint32_t div = { 1 };       ///< Dividers, each busy until its divide is done.
+            uint32_t mem = { 2 };       ///< Load/store ports.
+
+            /**
+             * @brief Parses a list of name=value pairs separated by commas,
+             *        such as width=8,rob=256. The names are width, rob,
+             *        regs, alu, mul, div and mem.
+             * @param spec The list.
+             * @param c Where to put it. Names that spec leaves out are left
+             *        as they are.
+             * @return false if spec is malformed, names something unknown
+             *         or gives a value out of range.
+             * ****************************************************************/
+            static bool parse(const std::string &spec, config &c);
+        };
+
+        /**
+         * @brief Constructor. Starts the model's thread.
+         * @param c The shape of the core.
+         * @param lat The latencies of each class of instruction.
+         * ********************************************************************/
+        ooo_model(const config &c, const latencies &lat);
+
+        /**
+         * @brief Destructor. Stops the model's thread.
+         * ********************************************************************/
+        ~ooo_model();
+
+        /**
+         * @brief Queues an instruction for the model's thread.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override
+        {
+            uint64_t n = head.load(std::memory_order_relaxed);
+
+            while (n - tail.load(std::memory_order_acquire) == ring_size)
+            {
+                std::this_thread::yield();      // full, wait for the model to catch up
+            }
+
+            ring[n % ring_size] = r;
+            head.store(n + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Queues a batch of instructions for the model's thread, as
+         *        much of it at a time as the ring has room for.
+         * @param r The instructions.
+         * @param n The number of them.
+         * ********************************************************************/
+        void retired_batch(const retired_insn *r, size_t n) override;
+
+        /**
+         * @brief Waits for the model to catch up, then prints the cycles,
+         *        the IPC, what held up dispatch and the structural hazards.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+    private:
+        static constexpr uint64_t ring_size = 64 * 1024;        ///< Instructions the ring holds.
+        static constexpr uint64_t release_quantum = 256;        ///< Instructions modelled between updates of tail.
+        static constexpr uint32_t issue_window = 4096;          ///< Cycles ahead whose issue slots are counted, to start with.
+        static constexpr uint32_t store_table_size = 1024;      ///< Recent stores remembered for loads to wait on.
+        static constexpr uint32_t target_table_size = 256;      ///< jalr targets remembered.
+        static constexpr uint32_t ras_depth = 16;               ///< Return addresses the stack holds.
+
+        /**
+         * @brief The kinds of functional unit.
+         * ********************************************************************/
+        enum unit_kind { unit_alu, unit_mul, unit_div, unit_mem, unit_kinds };
+
+        /**
+         * @brief The model's thread.
+         * ********************************************************************/
+        void run();
+
+        /**
+         * @brief Times one instruction.
+         * @param r The instruction.
+         * ********************************************************************/
+        void model(const retired_insn &r);
+
+        /**
+         * @brief Decides whether the front end would have mispredicted a
+         *        branch or jump, and trains its predictors.
+         * @param r The instruction.
+         * @param cls Its class.
+         * @return true if it was mispredicted.
+         * ********************************************************************/
+        bool mispredicted(const retired_insn &r, insn_class cls);
+
+        /**
+         * @brief The number of things counted against a cycle in a window
+         *        of cycles.
+         * 
+         * The windows start at dispatch_cycle, as nothing can issue before
+         * it, and are grown when cycle lies past their end, so that no two 
+         * cycles still in use share an entry.
+         * 
+         * @param slots The window, each entry the cycle it counts and the
+         *        count.
+         * @param cycle The cycle, no earlier than dispatch_cycle.
+         * @return A reference to its count, reset if the entry was last
+         *         used for some other cycle.
+         * ********************************************************************/
+        uint32_t &slot(std::vector<std::pair<uint64_t, uint32_t>> &slots, uint64_t cycle);
+
+        /**
+         * @brief Grows the windows of issue_slots and unit_slots, keeping 
+         *        the counts of the cycles still in use.
+         * @param span The number of cycles from dispatch_cycle on that they
+         *        must cover.
+         * ********************************************************************/
+        void grow_window(uint64_t span);
+
+        /**
+         * @brief Is a unit of a kind free for a span of cycles?
+         * @param kind The kind of unit.
+         * @param cycle The first cycle.
+         * @param span The number of cycles.
+         * @return true if fewer than all the units are busy in every one.
+         * ********************************************************************/
+        bool unit_free(unit_kind kind, uint64_t cycle, uint32_t span);
+
+        config cfg;                 ///< The shape of the core.
+        latencies lat;              ///< The latencies of each class of instruction.
+
+        // the state of the core, only touched by the model's thread
+        uint64_t seq = { 0 };                       ///< Instructions modelled.
+        uint64_t writers = { 0 };                   ///< Instructions modelled that write a register.
+        uint64_t fetch_ready = { 0 };               ///< The first cycle the front end can deliver the next instruction.
+        uint64_t dispatch_cycle = { 0 };            ///< The cycle the last instruction was dispatched.
+        uint32_t dispatched = { 0 };                ///< Instructions dispatched in dispatch_cycle.
+        uint64_t commit_cycle = { 0 };              ///< The cycle the last instruction was committed.
+        uint32_t committed = { 0 };                 ///< Instructions committed in commit_cycle.
+        uint64_t ready[32] = { };                   ///< The cycle each register's newest value is ready.
+        std::vector<uint64_t> rob_commits;          ///< Commit cycles of the last rob instructions, by seq.
+        std::vector<uint64_t> reg_commits;          ///< Commit cycles of the last regs - 32 register writers.
+        uint32_t units[unit_kinds];                 ///< The number of units of each kind.
+        std::vector<std::pair<uint64_t, uint32_t>> unit_slots[unit_kinds];  ///< Units of each kind busy in each cycle of the window.
+        std::vector<std::pair<uint64_t, uint32_t>> issue_slots;     ///< Instructions issued in each cycle of the window.
+        std::vector<std::pair<uint32_t, uint64_t>> stores;          ///< Recent stores' words and completion cycles, direct mapped.
+
+        gshare_predictor gshare = { 12 };           ///< Predicts conditional branches.
+        std::vector<uint32_t> targets;              ///< The target each jalr last went to, direct mapped.
+        std::vector<uint32_t> ras;                  ///< The return address stack, used as a ring.
+        uint32_t ras_top = { 0 };                   ///< The index of the newest return address.
+
+        // what is reported
+        uint64_t cycles = { 0 };                    ///< The cycle after the last commit.
+        uint64_t rob_stalls = { 0 };                ///< Dispatch cycles lost to a full reorder buffer.
+        uint64_t reg_stalls = { 0 };                ///< Dispatch cycles lost to running out of physical registers.
+        uint64_t frontend_stalls = { 0 };           ///< Dispatch cycles lost refilling after a mispredict.
+        uint64_t mispredicts = { 0 };               ///< Mispredicted branches and jumps.
+        uint64_t store_waits = { 0 };               ///< Loads that waited on an earlier store.
+        uint64_t unit_waits[unit_kinds] = { };      ///< Instructions that waited for a busy unit, by kind.
+        uint64_t unit_wait_cycles[unit_kinds] = { };    ///< Cycles instructions waited for a busy unit, by kind.
+        uint64_t width_waits = { 0 };               ///< Instructions that waited for an issue slot.
+        uint64_t width_wait_cycles = { 0 };         ///< Cycles instructions waited for an issue slot.
+
+        std::unique_ptr<retired_insn[]> ring { new retired_insn[ring_size] };      ///< The queued instructions.
+
+        // head and tail are kept on cache lines of their own, as each is
+        // written by one thread and read by the other all the time
+
+        char pad0[64];                                          ///< Padding.
+        std::atomic<uint64_t> head = { 0 };                     ///< Instructions pushed, only written by the hart.
+        char pad1[64];                                          ///< Padding.
+        std::atomic<uint64_t> tail = { 0 };                     ///< Instructions modelled, only written by the model.
+        char pad2[64];                                          ///< Padding.
+        std::atomic<bool> stopping = { false };                 ///< Set by the destructor.
+
+        std::thread thread;         ///< Runs run().
+};
+
+#endif
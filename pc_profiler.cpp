@@ -0,0 +1,204 @@
+//******************************************************************************
+//
+// pc_profiler.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+
+#include "pc_profiler.h"
+
+/**
+ * @brief Formats a fraction as a percentage.
+ * @param n The part.
+ * @param of The whole.
+ * @return n / of as a percentage with two decimals.
+ * ****************************************************************************/
+static std::string percent(uint64_t n, uint64_t of)
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(2) << (of ? 100.0 * n / of : 0.0) << "%";
+    return os.str();
+}
+
+// Follows calls and returns, and samples the pc when it is time to.
+void pc_profiler::retired(const retired_insn &r)
+{
+    if (stack.empty())
+    {
+        stack.push_back(r.pc);      // the function execution started in
+    }
+
+    // a call or return is sampled in the function it leaves
+    if (--countdown == 0)
+    {
+        countdown = period;
+        sample(r.pc);
+    }
+
+    uint32_t opcode = get_opcode(r.insn);
+    if (opcode != opcode_jal && opcode != opcode_jalr)
+        return;
+
+    if (is_call(r))
+    {
+        if (stack.size() < max_depth)
+            stack.push_back(r.next_pc);
+        else
+            ++lost_depth;
+    }
+    else if (is_return(r))
+    {
+        if (lost_depth)
+            --lost_depth;
+        else if (stack.size() > 1)
+            stack.pop_back();
+    }
+}
+
+// Takes a sample.
+void pc_profiler::sample(uint32_t pc)
+{
+    ++samples;
+    ++pcs[pc];
+
+    std::vector<uint32_t> key;
+    key.reserve(stack.size() + 1);
+    key.assign(stack.begin(), stack.end());
+    key.push_back(pc);
+    ++stacks[key];
+}
+
+// The name of the function a stack frame is in.
+std::string pc_profiler::function_name(uint32_t entry, uint32_t pc) const
+{
+    if (const symbol_table::symbol *s = syms.lookup(pc))
+    {
+        return s->name;
+    }
+    return to_hex0x32(entry);
+}
+
+// Prints the flat profile.
+void pc_profiler::report(std::ostream &os) const
+{
+    std::map<std::string, uint64_t> self;
+    std::map<std::string, uint64_t> total;
+
+    for (const auto &s : stacks)
+    {
+        const std::vector<uint32_t> &key = s.first;
+        size_t leaf = key.size() - 2;       // the frame the pc is in
+
+        self[function_name(key[leaf], key.back())] += s.second;
+
+        // a recursive function is only counted once per sample
+        std::set<std::string> seen;
+        for (size_t i = 0; i <= leaf; ++i)
+        {
+            std::string name = function_name(key[i], i == leaf ? key.back() : key[i]);
+            if (seen.insert(name).second)
+            {
+                total[name] += s.second;
+            }
+        }
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> flat;
+    for (const auto &t : total)
+    {
+        flat.emplace_back(self.count(t.first) ? self[t.first] : 0, t.first);
+    }
+    std::sort(flat.begin(), flat.end(), [&total](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b)
+    {
+        if (a.first != b.first)
+            return a.first > b.first;
+        return total.at(a.second) > total.at(b.second);
+    });
+
+    os << "Profile: " << samples << " samples, one every " << to_hex0x32(period) << " instructions" << std::endl;
+    os << std::right << std::setw(10) << "self" << std::setw(9) << "self %" << std::setw(10) << "total"
+       << std::setw(9) << "total %" << "  function" << std::endl;
+
+    for (const auto &f : flat)
+    {
+        uint64_t t = total.at(f.second);
+        os << std::setw(10) << f.first << std::setw(9) << percent(f.first, samples) << std::setw(10) << t
+           << std::setw(9) << percent(t, samples) << "  " << f.second << std::endl;
+    }
+
+    // the hottest instructions
+    std::vector<std::pair<uint64_t, uint32_t>> hot;
+    for (const auto &p : pcs)
+    {
+        hot.emplace_back(p.second, p.first);
+    }
+    std::sort(hot.begin(), hot.end(), [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    if (hot.size() > hot_pcs)
+    {
+        hot.resize(hot_pcs);
+    }
+
+    os << std::setw(10) << "samples" << std::setw(9) << "%" << "  pc" << std::endl;
+    for (const auto &h : hot)
+    {
+        os << std::setw(10) << h.first << std::setw(9) << percent(h.first, samples) << "  " << to_hex32(h.second);
+        if (const symbol_table::symbol *s = syms.lookup(h.second))
+        {
+            os << "  " << s->name << "+" << to_hex0x32(h.second - s->addr);
+        }
+        os << std::endl;
+    }
+}
+
+// Writes the samples as folded stacks.
+bool pc_profiler::write_folded(const std::string &fname) const
+{
+    std::ofstream out(fname, std::ios::out|std::ios::trunc);
+
+    if (!out)
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing." << std::endl;
+        return false;
+    }
+
+    // stacks that differ only in the pc sampled fold into one line
+    std::map<std::string, uint64_t> folded;
+    for (const auto &s : stacks)
+    {
+        const std::vector<uint32_t> &key = s.first;
+        size_t leaf = key.size() - 2;
+
+        std::string line;
+        for (size_t i = 0; i <= leaf; ++i)
+        {
+            line += (i ? ";" : "") + function_name(key[i], i == leaf ? key.back() : key[i]);
+        }
+        folded[line] += s.second;
+    }
+
+    for (const auto &f : folded)
+    {
+        out << f.first << " " << f.second << "\n";
+    }
+
+    if (!out.flush())
+    {
+        std::cerr << "Can't write file '" << fname << "'." << std::endl;
+        return false;
+    }
+
+    return true;
+}
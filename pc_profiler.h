@@ -0,0 +1,110 @@
+#ifndef PC_PROFILER_H
+#define PC_PROFILER_H
+
+//******************************************************************************
+//
+// pc_profiler.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hart_observer.h"
+#include "symbol_table.h"
+
+/**
+ * @brief Class to find where a guest spends its time by sampling its pc.
+ *
+ * Every period instructions the pc is counted in a hash map, along with the
+ * call stack that led to it. The stack is kept by following the calling
+ * convention: a jal or jalr that links to ra (or t0) enters a function at
+ * its target, and a jalr through ra (or t0) that doesn't link leaves it.
+ * Code that doesn't follow the convention, such as longjmp, can leave the
+ * stack out of step until it unwinds back past the mismatch.
+ *
+ * Samples are named after the symbols they fall in when the program has
+ * any, and after the address of the function otherwise.
+ * ****************************************************************************/
+class pc_profiler : public hart_observer
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param syms The program's symbols. May be empty.
+         * @param period The number of instructions between samples.
+         * ********************************************************************/
+        pc_profiler(const symbol_table &syms, uint64_t period) : syms(syms), period(period), countdown(period) { }
+
+        /**
+         * @brief Follows calls and returns, and samples the pc when it is
+         *        time to.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override;
+
+        /**
+         * @brief Prints the flat profile: the samples in each function,
+         *        both in it and in everything it called, followed by the
+         *        most sampled instructions.
+         * @param os Where to print it.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+        /**
+         * @brief Writes the samples as folded stacks, one line per distinct
+         *        stack with its frames separated by ';' and followed by
+         *        its count, as flamegraph.pl reads them.
+         * @param fname The file to write.
+         * @return false if it couldn't be written.
+         * ********************************************************************/
+        bool write_folded(const std::string &fname) const;
+
+    private:
+        /**
+         * @brief The deepest the call stack is followed. Calls beyond it
+         *        are counted rather than kept.
+         * ********************************************************************/
+        static constexpr size_t max_depth = 1024;
+
+        /**
+         * @brief The number of hottest instructions report() lists.
+         * ********************************************************************/
+        static constexpr size_t hot_pcs = 20;
+
+        /**
+         * @brief Takes a sample.
+         * @param pc The address of the instruction sampled.
+         * ********************************************************************/
+        void sample(uint32_t pc);
+
+        /**
+         * @brief The name of the function a stack frame is in.
+         * @param entry The address the function was entered at.
+         * @param pc An address in the function, or entry if there is none
+         *        better.
+         * @return The name of the symbol pc falls in, or entry in hex.
+         * ********************************************************************/
+        std::string function_name(uint32_t entry, uint32_t pc) const;
+
+        const symbol_table &syms;       ///< The program's symbols.
+        uint64_t period;                ///< Instructions between samples.
+        uint64_t countdown;             ///< Instructions left until the next sample.
+        uint64_t samples = { 0 };       ///< Samples taken.
+
+        std::vector<uint32_t> stack;    ///< The entry address of each function called and not yet returned from, outermost first.
+        uint64_t lost_depth = { 0 };    ///< Calls made beyond max_depth.
+
+        std::unordered_map<uint32_t, uint64_t> pcs;             ///< Samples by pc.
+        std::map<std::vector<uint32_t>, uint64_t> stacks;       ///< Samples by stack, with the sampled pc last.
+};
+
+#endif
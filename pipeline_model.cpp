@@ -0,0 +1,103 @@
+//******************************************************************************
+//
+// pipeline_model.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "pipeline_model.h"
+
+// Moves an instruction through the pipeline.
+void pipeline_model::retired(const retired_insn &r)
+{
+    insn_class cls = classify(r.insn);
+    ++instructions;
+
+    // the earliest it could execute, then what it waits for
+    uint64_t base = fetch + 2;
+    uint64_t data = base;
+    bool from_load = false;
+
+    uint32_t src[2];
+    sources(r, src);
+    for (uint32_t s : src)
+    {
+        if (s && ready[s] > data)
+        {
+            data = ready[s];
+            from_load = loaded[s];
+        }
+    }
+
+    uint64_t ex = std::max(data, ex_free);
+    (from_load ? load_use : data_stalls) += data - base;
+    structural += ex - data;
+
+    uint32_t ex_cycles = cls == insn_class::mul ? lat.mul : cls == insn_class::div ? lat.div : lat.alu;
+    bool memory = cls == insn_class::load || cls == insn_class::store;
+    uint64_t ex_end = ex + ex_cycles;
+    uint64_t mem = std::max(ex_end, mem_free);
+    uint64_t mem_end = mem + (memory ? lat.mem : 1);
+
+    ex_free = mem;                  // held in execute until memory is free
+    mem_free = mem_end;
+    cycles = mem_end + 1;           // after writeback
+
+    if (uint32_t rd = destination(r))
+    {
+        ready[rd] = cls == insn_class::load ? mem_end : ex_end;
+        loaded[rd] = cls == insn_class::load;
+    }
+
+    // the next instruction waits in decode while this one waits to execute
+    fetch = std::max(fetch + 1, ex - 1);
+
+    bool jump = cls == insn_class::branch || cls == insn_class::jal || cls == insn_class::jalr;
+    if (jump && r.next_pc != r.pc + r.len)
+    {
+        ++redirects;
+        uint32_t penalty = cls == insn_class::jal ? lat.jump : lat.branch;
+        (cls == insn_class::jal ? jump_penalty : branch_penalty) += penalty;
+        fetch += penalty;
+    }
+}
+
+// Prints the cycles, the CPI and where the stalls came from.
+void pipeline_model::report(std::ostream &os) const
+{
+    auto ratio = [](uint64_t n, uint64_t of)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3) << (of ? double(n) / of : 0.0);
+        return ss.str();
+    };
+
+    os << "Timing (in-order 5-stage): " << cycles << " cycles, " << instructions << " instructions, CPI "
+       << ratio(cycles, instructions) << std::endl;
+    os << std::left << std::setw(24) << "Stall cycles" << std::right << std::setw(14) << "cycles"
+       << std::setw(9) << "CPI" << std::endl;
+
+    const std::pair<const char *, uint64_t> rows[] =
+    {
+        { "load-use", load_use },
+        { "mul/div result", data_stalls },
+        { "structural", structural },
+        { "branch/jalr", branch_penalty },
+        { "jal", jump_penalty },
+    };
+    for (const auto &row : rows)
+    {
+        os << "  " << std::left << std::setw(22) << row.first << std::right << std::setw(14) << row.second
+           << std::setw(9) << ratio(row.second, instructions) << std::endl;
+    }
+    os << "  " << redirects << " taken branches and jumps" << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef PIPELINE_MODEL_H
+#define PIPELINE_MODEL_H
+
+//******************************************************************************
+//
+// pipeline_model.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include "timing_model.h"
+
+/**
+ * @brief Class to estimate the cycles a program takes on a classic 5-stage
+ *        in-order pipeline (fetch, decode, execute, memory, writeback).
+ *
+ * Results are forwarded to the execute stage as soon as they are computed,
+ * so the only data hazards are a use right after a load and a use of a
+ * multiply or divide before it is done. Fetch predicts every branch not
+ * taken; a taken branch or jalr loses latencies::branch cycles and a jal
+ * latencies::jump cycles. A multiply, a divide or a slow memory access
+ * holds its stage and stalls everything behind it.
+ *
+ * Only the time each stage next comes free and the time each register's
+ * value can be forwarded are kept, so an instruction is timed in a handful
+ * of comparisons rather than by stepping the pipeline cycle by cycle.
+ * ****************************************************************************/
+class pipeline_model : public timing_model
+{
+    public:
+        /**
+         * @brief Constructor.
+         * @param lat The latencies of each class of instruction.
+         * ********************************************************************/
+        pipeline_model(const latencies &lat) : lat(lat) { }
+
+        /**
+         * @brief Moves an instruction through the pipeline.
+         * @param r The instruction.
+         * ********************************************************************/
+        void retired(const retired_insn &r) override;
+
+        /**
+         * @brief Prints the cycles, the CPI and where the stalls came from.
+         * @param os Where to print them.
+         * ********************************************************************/
+        void report(std::ostream &os) const override;
+
+    private:
+        latencies lat;                  ///< The latencies of each class of instruction.
+
+        uint64_t fetch = { 0 };         ///< The cycle the next instruction is fetched.
+        uint64_t ex_free = { 0 };       ///< The cycle the execute stage is next free.
+        uint64_t mem_free = { 0 };      ///< The cycle the memory stage is next free.
+        uint64_t cycles = { 0 };        ///< The cycle after the last writeback.
+        uint64_t ready[32] = { };       ///< The cycle each register's value can be forwarded.
+        bool loaded[32] = { };          ///< Was each register's value last written by a load?
+
+        uint64_t instructions = { 0 };  ///< Instructions retired.
+        uint64_t load_use = { 0 };      ///< Cycles stalled for a load's result.
+        uint64_t data_stalls = { 0 };   ///< Cycles stalled for a multiply's or divide's result.
+        uint64_t structural = { 0 };    ///< Cycles stalled behind a busy execute or memory stage.
+        uint64_t branch_penalty = { 0 };    ///< Fetch cycles lost to taken branches and jalr.
+        uint64_t jump_penalty = { 0 };  ///< Fetch cycles lost to jal.
+        uint64_t redirects = { 0 };     ///< Taken branches and jumps.
+};
+
+#endif
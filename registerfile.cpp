@@ -48,23 +48,33 @@ int32_t registerfile::get(uint32_t r) const
     else return 0;
 }
 
-// Dump the contents of the registers to stdout.
-void registerfile::dump(const std::string &hdr) const
+// Dump the contents of the registers.
+void registerfile::dump(const std::string &hdr, std::ostream &os) const
 {
-    for (size_t i = 0; i < regs.size(); ++i)
+    // each line is formatted into a buffer and written at once
+    char line[3 + 8 * 9 + 1 + 1];
+
+    for (size_t i = 0; i < regs.size(); i += 8)
     {
-        if (i % 8 == 0) // new line: print header & reg num
-        {
-            if (i) { std::cout << std::endl; }
-            std::cout << hdr << std::right << std::setw(3) << "x" + std::to_string(i);
-        }
+        char *p = line;
+
+        *p++ = i < 10 ? ' ' : 'x';      // register number, right justified
+        *p++ = i < 10 ? 'x' : '0' + i / 10;
+        *p++ = '0' + i % 10;
 
-        if (i && i % 4 == 0 && i % 8 != 0) // space gap
+        for (size_t j = i; j < i + 8; ++j)
         {
-            std::cout << " ";
+            if (j % 4 == 0 && j % 8 != 0) // space gap
+            {
+                *p++ = ' ';
+            }
+            *p++ = ' ';
+            p = put_hex(p, regs.at(j), 8);
         }
+        *p++ = '\n';
 
-        std::cout << " " << to_hex32(regs.at(i)); // print reg contents
+        os << hdr;
+        os.write(line, p - line);
     }
-    std::cout << std::endl;
+    os.flush();
 }
@@ -56,10 +56,18 @@ class registerfile : hex
         int32_t get(uint32_t r) const;
 
         /**
-         * @brief Dump the contents of the registers to stdout.
+         * @brief Direct access to the register storage for translated code.
+         *        Element 0 is x0 and must never be written.
+         * @return A pointer to the 32 registers.
+         * ********************************************************************/
+        int32_t *data() { return regs.data(); }
+
+        /**
+         * @brief Dump the contents of the registers.
          * @param hdr A string to print at the beginning of each line.
+         * @param os Where to print them.
          * ********************************************************************/
-        void dump(const std::string &hdr) const;
+        void dump(const std::string &hdr, std::ostream &os = std::cout) const;
 };
 
 #endif
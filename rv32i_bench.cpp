@@ -0,0 +1,405 @@
+//******************************************************************************
+//
+// rv32i_bench.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "rv32i_hart.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+/**
+ * @brief How the benchmarks are run and reported.
+ * ****************************************************************************/
+struct settings
+{
+	int reps = { 15 };				///< Timed repetitions of each benchmark.
+	double target_ns = { 20e6 };	///< How long each repetition should take.
+	std::string filter;				///< Only run benchmarks whose names contain this.
+	std::string format = { "table" };	///< table, csv or json.
+};
+
+/**
+ * @brief The timings of one benchmark.
+ * ****************************************************************************/
+struct result
+{
+	std::string name;			///< The benchmark.
+	uint64_t ops;				///< Operations in each repetition.
+	std::vector<double> ns;		///< Nanoseconds per operation of each repetition, sorted.
+
+	double min() const { return ns.front(); }
+	double median() const { return ns.size() % 2 ? ns[ns.size() / 2] : (ns[ns.size() / 2 - 1] + ns[ns.size() / 2]) / 2; }
+
+	double mean() const
+	{
+		double sum = 0;
+		for (double t : ns)
+			sum += t;
+		return sum / ns.size();
+	}
+
+	double stddev() const
+	{
+		double m = mean(), sum = 0;
+		for (double t : ns)
+			sum += (t - m) * (t - m);
+		return ns.size() > 1 ? std::sqrt(sum / (ns.size() - 1)) : 0;
+	}
+};
+
+/**
+ * @brief Keeps the results of benchmarked calls alive without the compiler
+ *        being able to see that nothing reads them.
+ * ****************************************************************************/
+static volatile uint32_t sink;
+
+/**
+ * @brief Prints error message if program is launched incorrectly.
+ * ****************************************************************************/
+static void usage()
+{
+	cerr << "Usage: rv32i_bench [-f format] [-n reps] [-t ms] [filter]" << endl;
+	cerr << "    -f output format: table, csv or json (default = table)" << endl;
+	cerr << "    -n timed repetitions of each benchmark (default = 15)" << endl;
+	cerr << "    -t milliseconds each repetition should take (default = 20)" << endl;
+	cerr << "    filter only run the benchmarks whose names contain it" << endl;
+	exit(1);
+}
+
+/**
+ * @brief The time on a monotonic clock.
+ * @return Nanoseconds since some fixed point.
+ * ****************************************************************************/
+static double now_ns()
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Times a benchmark. It is first run with more and more operations
+ *        until a run takes long enough to time, then once more to warm up,
+ *        then reps times.
+ * @param s How to run it.
+ * @param results Where to add its timings.
+ * @param name Its name.
+ * @param f Runs it, given the number of operations to do.
+ * ****************************************************************************/
+template<typename F>
+static void bench(const settings &s, std::vector<result> &results, const std::string &name, F f)
+{
+	if (name.find(s.filter) == std::string::npos)
+		return;
+
+	uint64_t n = 1;
+	double t;
+	for (;;)
+	{
+		double start = now_ns();
+		f(n);
+		t = now_ns() - start;
+
+		if (t >= s.target_ns / 10 || n >= (uint64_t(1) << 40))
+			break;
+		n *= 2;
+	}
+	n = std::max<uint64_t>(1, n * (s.target_ns / std::max(t, 1.0)));
+
+	f(n);
+
+	result r;
+	r.name = name;
+	r.ops = n;
+	for (int i = 0; i < s.reps; ++i)
+	{
+		double start = now_ns();
+		f(n);
+		r.ns.push_back((now_ns() - start) / n);
+	}
+	std::sort(r.ns.begin(), r.ns.end());
+
+	if (s.format == "table")
+	{
+		cout << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(2)
+			 << std::setw(11) << r.median() << std::setw(11) << r.min() << std::setw(11) << r.mean()
+			 << std::setw(9) << (r.median() ? 100 * r.stddev() / r.median() : 0) << "%" << std::setw(14) << r.ops << endl;
+	}
+	results.push_back(r);
+}
+
+/**
+ * @brief Class to encode the instructions the exec benchmarks run, using
+ *        the field values rv32i_decode knows them by.
+ * ****************************************************************************/
+class encoder : public rv32i_decode
+{
+	public:
+		static uint32_t lui() { return (0x12345 << 12) | (5 << 7) | opcode_lui; }
+		static uint32_t addi() { return itype(opcode_alu_imm, 5, funct3_add, 5, 1); }
+		static uint32_t add() { return rtype(funct7_add, 7, funct3_add, 5, 6); }
+		static uint32_t mul() { return rtype(funct7_muldiv, 7, funct3_mul, 5, 6); }
+		static uint32_t div() { return rtype(funct7_muldiv, 7, funct3_div, 5, 6); }
+		static uint32_t lw() { return itype(opcode_load_imm, 7, funct3_lw, 10, 0); }
+		static uint32_t sw() { return stype(funct3_sw, 10, 5, 4); }
+		static uint32_t bne() { return btype(funct3_bne, 0, 0, 8); }		// never taken
+
+		/**
+		 * @brief Encodes a jal that doesn't link.
+		 * @param imm The offset to jump by.
+		 * ********************************************************************/
+		static uint32_t jal(int32_t imm)
+		{
+			uint32_t i = imm;
+			return (((i >> 20) & 1) << 31) | (((i >> 1) & 0x3ff) << 21) | (((i >> 11) & 1) << 20) | (((i >> 12) & 0xff) << 12) | opcode_jal;
+		}
+
+	private:
+		static uint32_t itype(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, int32_t imm)
+		{
+			return (uint32_t(imm) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+		}
+
+		static uint32_t rtype(uint32_t funct7, uint32_t rd, uint32_t funct3, uint32_t rs1, uint32_t rs2)
+		{
+			return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode_rtype;
+		}
+
+		static uint32_t stype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+		{
+			return ((uint32_t(imm) >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((imm & 0x1f) << 7) | opcode_stype;
+		}
+
+		static uint32_t btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+		{
+			uint32_t i = imm;
+			return (((i >> 12) & 1) << 31) | (((i >> 5) & 0x3f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12)
+				| (((i >> 1) & 0xf) << 8) | (((i >> 11) & 1) << 7) | opcode_btype;
+		}
+};
+
+/**
+ * @brief Times executing one kind of instruction, with both the tick and
+ *        the block engine. The code is a run of copies of the instruction
+ *        with a jal back to the start.
+ * @param s How to run it.
+ * @param results Where to add its timings.
+ * @param name The kind of instruction.
+ * @param insn The instruction.
+ * ****************************************************************************/
+static void bench_exec(const settings &s, std::vector<result> &results, const std::string &name, uint32_t insn)
+{
+	static constexpr uint32_t copies = 1024;
+	static constexpr uint32_t data = 0x8000;	// loads and stores go here
+
+	memory mem(0x10000);
+	for (uint32_t i = 0; i < copies; ++i)
+	{
+		mem.set32(i * 4, insn);
+	}
+	mem.set32(copies * 4, encoder::jal(-int32_t(copies * 4)));
+
+	rv32i_hart h(mem);
+	h.set_reg(5, 1000);
+	h.set_reg(6, 3);
+	h.set_reg(10, data);
+
+	bench(s, results, "exec " + name + " (tick)", [&h](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			h.tick();
+	});
+
+	bench(s, results, "exec " + name + " (block)", [&h](uint64_t n)
+	{
+		uint64_t end = h.get_insn_counter() + n;
+		while (h.get_insn_counter() < end)
+			h.tick_block(end - h.get_insn_counter());
+	});
+}
+
+/**
+ * @brief Times the simulator's hot paths and prints how long each
+ *        operation takes.
+ * ****************************************************************************/
+int main(int argc, char **argv)
+{
+	settings s;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "f:n:t:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+				s.format = optarg;
+				if (s.format != "table" && s.format != "csv" && s.format != "json")
+					usage();
+				break;
+
+			case 'n':
+				s.reps = atoi(optarg);
+				if (s.reps < 1)
+					usage();
+				break;
+
+			case 't':
+				s.target_ns = atof(optarg) * 1e6;
+				if (!(s.target_ns > 0))
+					usage();
+				break;
+
+			default:
+				usage();
+		}
+	}
+
+	if (optind < argc - 1)
+		usage();
+	if (optind == argc - 1)
+		s.filter = argv[optind];
+
+	if (s.format == "table")
+	{
+		cout << std::left << std::setw(28) << "benchmark (ns/op)" << std::right << std::setw(11) << "median"
+			 << std::setw(11) << "min" << std::setw(11) << "mean" << std::setw(10) << "stddev" << std::setw(14) << "ops/rep" << endl;
+	}
+
+	std::vector<result> results;
+
+	// a mix of every format, for the decoders
+	static const uint32_t insns[] =
+	{
+		0x123452b7, 0x00001517, 0x0100006f, 0x000280e7, 0x00b50463, 0xffc52383, 0x00552223, 0x00128293,
+		0x4012d293, 0x00628333, 0x40628333, 0x02628333, 0x0262c333, 0x00000073, 0x00100073, 0x300022f3,
+	};
+
+	bench(s, results, "decode", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + rv32i_decode::decode(i * 4, insns[i % 16]).size();
+	});
+
+	bench(s, results, "decode_cached", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + rv32i_decode::decode_cached((i % 256) * 4, insns[i % 16]).size();
+	});
+
+	bench_exec(s, results, "lui", encoder::lui());
+	bench_exec(s, results, "addi", encoder::addi());
+	bench_exec(s, results, "add", encoder::add());
+	bench_exec(s, results, "mul", encoder::mul());
+	bench_exec(s, results, "div", encoder::div());
+	bench_exec(s, results, "lw", encoder::lw());
+	bench_exec(s, results, "sw", encoder::sw());
+	bench_exec(s, results, "bne (not taken)", encoder::bne());
+	bench_exec(s, results, "jal", encoder::jal(4));
+
+	for (bool paged : { false, true })
+	{
+		std::string kind = paged ? " (paged)" : "";
+		memory mem(0x10000, paged);
+
+		bench(s, results, "memory get8" + kind, [&mem](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; ++i)
+				sink = sink + mem.get8(i & 0xffff);
+		});
+
+		bench(s, results, "memory get32" + kind, [&mem](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; ++i)
+				sink = sink + mem.get32((i * 4) & 0xffff);
+		});
+
+		bench(s, results, "memory set32" + kind, [&mem](uint64_t n)
+		{
+			for (uint64_t i = 0; i < n; ++i)
+				mem.set32((i * 4) & 0xffff, i);
+		});
+	}
+
+	registerfile regs;
+
+	bench(s, results, "registerfile get", [&regs](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + regs.get(i & 31);
+	});
+
+	bench(s, results, "registerfile set", [&regs](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			regs.set(i & 31, i);
+	});
+
+	bench(s, results, "hex to_hex8", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + hex::to_hex8(i).size();
+	});
+
+	bench(s, results, "hex to_hex32", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + hex::to_hex32(i * 2654435761u).size();
+	});
+
+	bench(s, results, "hex to_hex0x12", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + hex::to_hex0x12(i).size();
+	});
+
+	bench(s, results, "hex to_hex0x20", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + hex::to_hex0x20(i).size();
+	});
+
+	bench(s, results, "hex to_hex0x32", [](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; ++i)
+			sink = sink + hex::to_hex0x32(i * 2654435761u).size();
+	});
+
+	if (s.format == "csv")
+	{
+		cout << "benchmark,unit,median,min,mean,stddev,reps,ops_per_rep" << endl;
+		for (const result &r : results)
+		{
+			cout << "\"" << r.name << "\",ns/op," << r.median() << "," << r.min() << "," << r.mean() << ","
+				 << r.stddev() << "," << r.ns.size() << "," << r.ops << endl;
+		}
+	}
+	else if (s.format == "json")
+	{
+		cout << "{\"unit\":\"ns/op\",\"reps\":" << s.reps << ",\"results\":[";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const result &r = results[i];
+			cout << (i ? "," : "") << "{\"name\":\"" << r.name << "\",\"median\":" << r.median() << ",\"min\":" << r.min()
+				 << ",\"mean\":" << r.mean() << ",\"stddev\":" << r.stddev() << ",\"ops_per_rep\":" << r.ops << "}";
+		}
+		cout << "]}" << endl;
+	}
+
+	return 0;
+}
@@ -81,6 +81,21 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
             assert(0 && "unrecognized funct3");
 
         case opcode_rtype:
+            if (get_funct7(insn) == funct7_muldiv)
+            {
+                switch (get_funct3(insn))
+                {
+                    case funct3_mul:        return render_rtype(insn, "mul");
+                    case funct3_mulh:       return render_rtype(insn, "mulh");
+                    case funct3_mulhsu:     return render_rtype(insn, "mulhsu");
+                    case funct3_mulhu:      return render_rtype(insn, "mulhu");
+                    case funct3_div:        return render_rtype(insn, "div");
+                    case funct3_divu:       return render_rtype(insn, "divu");
+                    case funct3_rem:        return render_rtype(insn, "rem");
+                    case funct3_remu:       return render_rtype(insn, "remu");
+                }
+                assert(0 && "unrecognized funct3");
+            }
             switch (get_funct3(insn))
             {
                 default:                    return render_illegal_insn(insn);
@@ -132,6 +147,35 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
     assert(0 && "unrecognized opcode");
 }
 
+// Decodes an instruction, remembering the result.
+const std::string &rv32i_decode::decode_cached(uint32_t addr, uint32_t insn)
+{
+    // one table per thread, as the trace printer decodes on a thread of its own
+    static thread_local std::unique_ptr<decoded_text[]> memo;
+
+    if (!memo)
+    {
+        memo.reset(new decoded_text[memo_size]);
+    }
+
+    // only jal and the branches render their address
+    uint32_t opcode = get_opcode(insn);
+    if (opcode != opcode_jal && opcode != opcode_btype)
+    {
+        addr = 0;
+    }
+
+    decoded_text &e = memo[((insn ^ (addr * 0x9e3779b1)) * 0x9e3779b1) >> (32 - memo_bits)];
+    if (!e.used || e.insn != insn || e.addr != addr)
+    {
+        e.used = true;
+        e.insn = insn;
+        e.addr = addr;
+        e.text = decode(addr, insn);
+    }
+    return e.text;
+}
+
 // Extracts the opcode from an instruction.
 uint32_t rv32i_decode::get_opcode(uint32_t insn)
 {
@@ -219,9 +263,7 @@ std::string rv32i_decode::render_lui(uint32_t insn)
     uint32_t rd = get_rd(insn);
     int32_t imm_u = get_imm_u(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic("lui") << render_reg(rd) << "," << to_hex0x20((imm_u >> (12-0)) & 0x0fffff);
-    return os.str();
+    return render_mnemonic("lui") + render_reg(rd) + "," + to_hex0x20((imm_u >> (12-0)) & 0x0fffff);
 }
 
 // Handles auipc instructions.
@@ -230,9 +272,7 @@ std::string rv32i_decode::render_auipc(uint32_t insn)
     uint32_t rd = get_rd(insn);
     int32_t imm_u = get_imm_u(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic("auipc") << render_reg(rd) << "," << to_hex0x20((imm_u >> (12 - 0)) & 0x0fffff);
-    return os.str();
+    return render_mnemonic("auipc") + render_reg(rd) + "," + to_hex0x20((imm_u >> (12 - 0)) & 0x0fffff);
 }
 
 // Handles jal instructions.
@@ -241,9 +281,7 @@ std::string rv32i_decode::render_jal(uint32_t addr, uint32_t insn)
     uint32_t rd = get_rd(insn);
     int32_t imm_j = get_imm_j(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic("jal") << render_reg(rd) << "," << to_hex0x32(imm_j + addr);
-    return os.str();
+    return render_mnemonic("jal") + render_reg(rd) + "," + to_hex0x32(imm_j + addr);
 }
 
 // Handles jalr instructions.
@@ -253,9 +291,7 @@ std::string rv32i_decode::render_jalr(uint32_t insn)
     uint32_t rs1 = get_rs1(insn);
     int32_t imm_i = get_imm_i(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic("jalr") << render_reg(rd) << "," << imm_i << "(" << render_reg(rs1) << ")";
-    return os.str();
+    return render_mnemonic("jalr") + render_reg(rd) + "," + std::to_string(imm_i) + "(" + render_reg(rs1) + ")";
 }
 
 // Handles btype instructions.
@@ -265,9 +301,7 @@ std::string rv32i_decode::render_btype(uint32_t addr, uint32_t insn, const char
     uint32_t rs2 = get_rs2(insn);
     int32_t imm_b = get_imm_b(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rs1) << "," << render_reg(rs2) << "," << to_hex0x32(imm_b + addr);
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rs1) + "," + render_reg(rs2) + "," + to_hex0x32(imm_b + addr);
 }
 
 // Handles itype load instructions.
@@ -277,9 +311,7 @@ std::string rv32i_decode::render_itype_load(uint32_t insn, const char *mnemonic)
     uint32_t rs1 = get_rs1(insn);
     int32_t imm_i = get_imm_i(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << imm_i << "(" << render_reg(rs1) << ")";
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rd) + "," + std::to_string(imm_i) + "(" + render_reg(rs1) + ")";
 }
 
 // Handles stype instructions.
@@ -289,9 +321,7 @@ std::string rv32i_decode::render_stype(uint32_t insn, const char *mnemonic)
     uint32_t rs2 = get_rs2(insn);
     int32_t imm_s = get_imm_s(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rs2) << "," << imm_s << "(" << render_reg(rs1) << ")";
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rs2) + "," + std::to_string(imm_s) + "(" + render_reg(rs1) + ")";
 }
 
 // Handles itype alu instructions.
@@ -300,9 +330,7 @@ std::string rv32i_decode::render_itype_alu(uint32_t insn, const char *mnemonic,
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << render_reg(rs1) << "," << imm_i;
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rd) + "," + render_reg(rs1) + "," + std::to_string(imm_i);
 }
 
 // Handles rtype instructions.
@@ -312,9 +340,7 @@ std::string rv32i_decode::render_rtype(uint32_t insn, const char *mnemonic)
     uint32_t rs1 = get_rs1(insn);
     uint32_t rs2 = get_rs2(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << render_reg(rs1) << "," << render_reg(rs2);
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rd) + "," + render_reg(rs1) + "," + render_reg(rs2);
 }
 
 // Handles ecall instructions.
@@ -336,9 +362,7 @@ std::string rv32i_decode::render_csrrx(uint32_t insn, const char *mnemonic)
     uint32_t csr = get_imm_i(insn);
     uint32_t rs1 = get_rs1(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr & 0xfff) << "," << render_reg(rs1);
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rd) + "," + to_hex0x12(csr & 0xfff) + "," + render_reg(rs1);
 }
 
 // Handles csrrxi instructions.
@@ -348,31 +372,199 @@ std::string rv32i_decode::render_csrrxi(uint32_t insn, const char *mnemonic)
     uint32_t csr = get_imm_i(insn);
     uint32_t zimm = get_rs1(insn);
 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," << to_hex0x12(csr & 0xfff) << "," << zimm;
-    return os.str();
+    return render_mnemonic(mnemonic) + render_reg(rd) + "," + to_hex0x12(csr & 0xfff) + "," + std::to_string(zimm);
 }
 
 // Formats a register number for output
 std::string rv32i_decode::render_reg(int r)
 {
-    std::ostringstream os;
-    os << "x" << r;
-    return os.str();
+    return "x" + std::to_string(r);
 }
 
 // Formats base displacement for output.
 std::string rv32i_decode::render_base_disp(uint32_t base, int32_t disp)
 {
-    std::ostringstream os;
-    os << disp << "(" << render_reg(base) << ")";
-    return os.str();
+    return std::to_string(disp) + "(" + render_reg(base) + ")";
 }
 
 // Formats the mnemonic for output.
 std::string rv32i_decode::render_mnemonic(const std::string &m)
 {
-    std::ostringstream os;
-    os << std::left << std::setfill(' ') << std::setw(mnemonic_width) << m;
-    return os.str();
+    std::string s = m;
+    if (s.size() < size_t(mnemonic_width))
+    {
+        s.resize(mnemonic_width, ' ');
+    }
+    return s;
+}
+
+/**
+ * @brief Extracts a bit field from a compressed instruction.
+ * @param insn A compressed instruction.
+ * @param hi The most significant bit of the field.
+ * @param lo The least significant bit of the field.
+ * @returns The field, shifted down to bit 0.
+ * ****************************************************************************/
+static uint32_t cbits(uint32_t insn, int hi, int lo)
+{
+    return (insn >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+/**
+ * @brief Sign-extends the low bits of a value.
+ * @param val The value.
+ * @param bits The number of significant bits in val.
+ * @returns val sign-extended from bit bits-1.
+ * ****************************************************************************/
+static int32_t sext(uint32_t val, int bits)
+{
+    uint32_t sign = 1u << (bits - 1);
+    return static_cast<int32_t>((val ^ sign) - sign);
+}
+
+// Encoders for the 32-bit instruction formats.
+static uint32_t enc_r(uint32_t f7, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op)
+{
+    return f7 << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+
+static uint32_t enc_i(int32_t imm, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op)
+{
+    return (imm & 0xfff) << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+
+static uint32_t enc_s(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t op)
+{
+    return (imm >> 5 & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | (imm & 0x1f) << 7 | op;
+}
+
+static uint32_t enc_b(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t op)
+{
+    return (imm >> 12 & 1) << 31 | (imm >> 5 & 0x3f) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12
+         | (imm >> 1 & 0xf) << 8 | (imm >> 11 & 1) << 7 | op;
+}
+
+static uint32_t enc_j(int32_t imm, uint32_t rd, uint32_t op)
+{
+    return (imm >> 20 & 1) << 31 | (imm >> 1 & 0x3ff) << 21 | (imm >> 11 & 1) << 20 | (imm >> 12 & 0xff) << 12 | rd << 7 | op;
+}
+
+static uint32_t enc_u(int32_t imm, uint32_t rd, uint32_t op)
+{
+    return (imm & 0xfffff000) | rd << 7 | op;
+}
+
+// Expands a 16-bit (RV32C) instruction into its 32-bit equivalent.
+uint32_t rv32i_decode::expand_compressed(uint16_t insn)
+{
+    uint32_t rd = cbits(insn, 11, 7);           // also rs1 in the CR/CI formats
+    uint32_t rs2 = cbits(insn, 6, 2);
+    uint32_t rdp = cbits(insn, 4, 2) + 8;       // rd'/rs2' in the CIW/CL/CS/CA formats
+    uint32_t rs1p = cbits(insn, 9, 7) + 8;      // rs1'/rd' in the CL/CS/CA/CB formats
+    int32_t imm6 = sext(cbits(insn, 12, 12) << 5 | cbits(insn, 6, 2), 6);
+
+    // the CL/CS word offset, CJ jump offset and CB branch offset
+    uint32_t uimm_w = cbits(insn, 12, 10) << 3 | cbits(insn, 6, 6) << 2 | cbits(insn, 5, 5) << 6;
+    int32_t imm_j = sext(cbits(insn, 12, 12) << 11 | cbits(insn, 11, 11) << 4 | cbits(insn, 10, 9) << 8
+                       | cbits(insn, 8, 8) << 10 | cbits(insn, 7, 7) << 6 | cbits(insn, 6, 6) << 7
+                       | cbits(insn, 5, 3) << 1 | cbits(insn, 2, 2) << 5, 12);
+    int32_t imm_b = sext(cbits(insn, 12, 12) << 8 | cbits(insn, 11, 10) << 3 | cbits(insn, 6, 5) << 6
+                       | cbits(insn, 4, 3) << 1 | cbits(insn, 2, 2) << 5, 9);
+
+    switch (cbits(insn, 1, 0) << 3 | cbits(insn, 15, 13))
+    {
+        default:                                        // floating point and reserved
+            return 0;
+
+        case 0b00000:                                   // c.addi4spn
+            {
+                uint32_t nzuimm = cbits(insn, 12, 11) << 4 | cbits(insn, 10, 7) << 6 | cbits(insn, 6, 6) << 2 | cbits(insn, 5, 5) << 3;
+                return nzuimm ? enc_i(nzuimm, 2, funct3_add, rdp, opcode_alu_imm) : 0;
+            }
+
+        case 0b00010:                                   // c.lw
+            return enc_i(uimm_w, rs1p, funct3_lw, rdp, opcode_load_imm);
+
+        case 0b00110:                                   // c.sw
+            return enc_s(uimm_w, rdp, rs1p, funct3_sw, opcode_stype);
+
+        case 0b01000:                                   // c.addi, c.nop
+            return enc_i(imm6, rd, funct3_add, rd, opcode_alu_imm);
+
+        case 0b01001:                                   // c.jal
+            return enc_j(imm_j, 1, opcode_jal);
+
+        case 0b01010:                                   // c.li
+            return enc_i(imm6, 0, funct3_add, rd, opcode_alu_imm);
+
+        case 0b01011:
+            if (rd == 2)                                // c.addi16sp
+            {
+                int32_t nzimm = sext(cbits(insn, 12, 12) << 9 | cbits(insn, 6, 6) << 4 | cbits(insn, 5, 5) << 6
+                                   | cbits(insn, 4, 3) << 7 | cbits(insn, 2, 2) << 5, 10);
+                return nzimm ? enc_i(nzimm, 2, funct3_add, 2, opcode_alu_imm) : 0;
+            }
+            return imm6 ? enc_u(imm6 << 12, rd, opcode_lui) : 0;   // c.lui
+
+        case 0b01100:
+            switch (cbits(insn, 11, 10))
+            {
+                case 0b00:                              // c.srli
+                case 0b01:                              // c.srai
+                    if (cbits(insn, 12, 12))
+                        return 0;
+                    return enc_i(cbits(insn, 11, 10) << 10 | rs2, rs1p, funct3_srx, rs1p, opcode_alu_imm);
+
+                case 0b10:                              // c.andi
+                    return enc_i(imm6, rs1p, funct3_and, rs1p, opcode_alu_imm);
+
+                default:
+                    if (cbits(insn, 12, 12))
+                        return 0;
+                    switch (cbits(insn, 6, 5))
+                    {
+                        case 0b00:  return enc_r(funct7_sub, rdp, rs1p, funct3_add, rs1p, opcode_rtype);  // c.sub
+                        case 0b01:  return enc_r(0, rdp, rs1p, funct3_xor, rs1p, opcode_rtype);           // c.xor
+                        case 0b10:  return enc_r(0, rdp, rs1p, funct3_or, rs1p, opcode_rtype);            // c.or
+                        default:    return enc_r(0, rdp, rs1p, funct3_and, rs1p, opcode_rtype);           // c.and
+                    }
+            }
+
+        case 0b01101:                                   // c.j
+            return enc_j(imm_j, 0, opcode_jal);
+
+        case 0b01110:                                   // c.beqz
+            return enc_b(imm_b, 0, rs1p, funct3_beq, opcode_btype);
+
+        case 0b01111:                                   // c.bnez
+            return enc_b(imm_b, 0, rs1p, funct3_bne, opcode_btype);
+
+        case 0b10000:                                   // c.slli
+            return cbits(insn, 12, 12) ? 0 : enc_i(rs2, rd, funct3_sll, rd, opcode_alu_imm);
+
+        case 0b10010:                                   // c.lwsp
+            {
+                uint32_t uimm = cbits(insn, 12, 12) << 5 | cbits(insn, 6, 4) << 2 | cbits(insn, 3, 2) << 6;
+                return rd ? enc_i(uimm, 2, funct3_lw, rd, opcode_load_imm) : 0;
+            }
+
+        case 0b10100:
+            if (!cbits(insn, 12, 12))
+            {
+                if (rs2)                                // c.mv
+                    return enc_r(0, rs2, 0, funct3_add, rd, opcode_rtype);
+                return rd ? enc_i(0, rd, 0, 0, opcode_jalr) : 0;    // c.jr
+            }
+            if (rs2)                                    // c.add
+                return enc_r(0, rs2, rd, funct3_add, rd, opcode_rtype);
+            if (!rd)                                    // c.ebreak
+                return insn_ebreak;
+            return enc_i(0, rd, 0, 1, opcode_jalr);     // c.jalr
+
+        case 0b10110:                                   // c.swsp
+            {
+                uint32_t uimm = cbits(insn, 12, 9) << 2 | cbits(insn, 8, 7) << 6;
+                return enc_s(uimm, rs2, 2, funct3_sw, opcode_stype);
+            }
+    }
 }
@@ -13,6 +13,7 @@
 //
 //******************************************************************************
 
+#include <memory>
 #include <string>
 #include <sstream>
 #include <cctype>
@@ -34,7 +35,49 @@ class rv32i_decode : public hex
 		 * ****************************************************************************/
 		static std::string decode(uint32_t addr, uint32_t insn);
 
+		/**
+		 * @brief Decodes an instruction, as decode() does, remembering the
+		 *        result in a small table so that an instruction that is
+		 *        executed over and over is only rendered once.
+		 * @param addr The memory address where the insn is stored.
+		 * @param insn An instruction.
+		 * @returns The decoded instruction. It stays valid until the next
+		 *          call on the same thread.
+		 * ****************************************************************************/
+		static const std::string &decode_cached(uint32_t addr, uint32_t insn);
+
+		/**
+		 * @brief Is this the first halfword of a 16-bit (RV32C) instruction?
+		 * @param insn The instruction, or at least its low halfword.
+		 * @returns True if it is compressed.
+		 * ****************************************************************************/
+		static bool is_compressed(uint32_t insn) { return (insn & 0b11) != 0b11; }
+
+		/**
+		 * @brief Expands a 16-bit (RV32C) instruction into the 32-bit 
+		 *        instruction that does the same thing.
+		 * @param insn A compressed instruction.
+		 * @returns The equivalent RV32I instruction, or 0 (an illegal 
+		 *          instruction) if insn is reserved or needs an extension
+		 *          that isn't supported, such as floating point.
+		 * ****************************************************************************/
+		static uint32_t expand_compressed(uint16_t insn);
+
 	protected:
+		static constexpr uint32_t memo_bits				= 12; ///< log2 of the number of entries in the decode_cached() table.
+		static constexpr uint32_t memo_size				= 1 << memo_bits; ///< Number of entries in the decode_cached() table.
+
+		/**
+		 * @brief An entry in the decode_cached() table.
+		 * ****************************************************************************/
+		struct decoded_text
+		{
+			bool used = { false };	///< Set once the entry has been filled in.
+			uint32_t insn;			///< The instruction.
+			uint32_t addr;			///< Its address, or 0 if its text doesn't depend on it.
+			std::string text;		///< The decoded instruction.
+		};
+
 		static constexpr int mnemonic_width             = 8; ///< Width of the mnemonic output field.
 
 		static constexpr uint32_t opcode_lui			= 0b0110111; ///< Opcode for lui.
@@ -80,6 +123,17 @@ class rv32i_decode : public hex
 		static constexpr uint32_t funct7_add			= 0b0000000; ///< Funct7 value for add.
 		static constexpr uint32_t funct7_sub			= 0b0100000; ///< Funct7 value for sub.
 
+		static constexpr uint32_t funct7_muldiv			= 0b0000001; ///< Funct7 value for the RV32M instructions.
+
+		static constexpr uint32_t funct3_mul			= 0b000; ///< Funct3 value for mul.
+		static constexpr uint32_t funct3_mulh			= 0b001; ///< Funct3 value for mulh.
+		static constexpr uint32_t funct3_mulhsu			= 0b010; ///< Funct3 value for mulhsu.
+		static constexpr uint32_t funct3_mulhu			= 0b011; ///< Funct3 value for mulhu.
+		static constexpr uint32_t funct3_div			= 0b100; ///< Funct3 value for div.
+		static constexpr uint32_t funct3_divu			= 0b101; ///< Funct3 value for divu.
+		static constexpr uint32_t funct3_rem			= 0b110; ///< Funct3 value for rem.
+		static constexpr uint32_t funct3_remu			= 0b111; ///< Funct3 value for remu.
+
 		static constexpr uint32_t insn_ecall			= 0x00000073; ///< Instruction value for ecall.
 		static constexpr uint32_t insn_ebreak			= 0x00100073; ///< Instruction value for ebreak.
 
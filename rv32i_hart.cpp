@@ -11,26 +11,77 @@
 //******************************************************************************
 
 #include "rv32i_hart.h"
+#include "rv32i_jit.h"
+#include "host_syscalls.h"
+#include "binary_trace.h"
+#include "trace_printer.h"
 
 // Reset the rv32i object and the registerfile.
 void rv32i_hart::reset()
 {
-    pc = 0;
+    pc = reset_pc;
     regs.reset();
     insn_counter = 0;
     halt = false;
     halt_reason = "none";
+
+    decode_cache.clear();
+
+    if (attached_jit)
+    {
+        attached_jit->flush();
+    }
 }
 
 // Dump the entire state of the hart.
-void rv32i_hart::dump(const std::string &hdr) const
+void rv32i_hart::dump(const std::string &hdr, std::ostream &os) const
 {
-    regs.dump(hdr);
-    std::cout << hdr << " pc " << to_hex32(pc) << std::endl;
+    regs.dump(hdr, os);
+    os << hdr << " pc " << to_hex32(pc) << std::endl;
 }
 
 // Tells the simulator to execute an instruction.
 void rv32i_hart::tick(const std::string &hdr)
+{
+    (this->*get_tick())(hdr);
+}
+
+// Pick the tick() implementation for the current tracing settings.
+rv32i_hart::tick_fn rv32i_hart::get_tick() const
+{
+    if (observers.empty())
+        return get_step();
+
+    if (recorder)
+        return &rv32i_hart::step_observed_traced<&rv32i_hart::step_recorded>;
+
+    if (printer)
+        return &rv32i_hart::step_observed_traced<&rv32i_hart::step_printed>;
+
+    if (show_instructions)
+        return &rv32i_hart::step_observed_traced<&rv32i_hart::step<true>>;
+
+    if (show_registers)
+        return &rv32i_hart::step_observed_traced<&rv32i_hart::step<false>>;
+
+    return &rv32i_hart::step_observed;
+}
+
+// Pick the tick() implementation, leaving out the observers.
+rv32i_hart::tick_fn rv32i_hart::get_step() const
+{
+    if (recorder)
+        return &rv32i_hart::step_recorded;
+
+    if (printer)
+        return &rv32i_hart::step_printed;
+
+    return show_instructions ? &rv32i_hart::step<true> : &rv32i_hart::step<false>;
+}
+
+// Execute an instruction, with or without tracing it.
+template<bool traced>
+void rv32i_hart::step(const std::string &hdr)
 {
     if (!is_halted())
     {
@@ -41,80 +92,461 @@ void rv32i_hart::tick(const std::string &hdr)
             dump(hdr);
         }
 
-        uint32_t insn = mem.get32(pc);
+        const decoded_insn &d = fetch();
 
-        if (show_instructions)
+        if (traced)
         {
-            std::cout << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-            exec(insn, &std::cout);
+            std::cout << hdr << hex::to_hex32(pc) << ": "
+                      << (d.len == 2 ? "    " + hex::to_hex16(mem.get16(pc)) : hex::to_hex32(d.insn)) << "  ";
+            (this->*get_handler<true>(d.insn))(d, &std::cout);
             std::cout << std::endl;
         }
-        else exec(insn, nullptr);
+        else (this->*d.handler)(d, nullptr);
+    }
+}
+
+// Execute an instruction and record it.
+void rv32i_hart::step_recorded(const std::string &)
+{
+    if (!is_halted())
+    {
+        insn_counter++;
+
+        uint32_t at = pc;
+        const decoded_insn &d = fetch();
+        uint32_t addr = regs.get(d.rs1) + d.imm;   // the address, if it loads or stores
+        int32_t old = regs.get(d.rd);
+
+        (this->*d.handler)(d, nullptr);
+        recorder->record(*this, at, d, addr, old);
+    }
+}
+
+// Execute an instruction and hand it to the printer.
+void rv32i_hart::step_printed(const std::string &hdr)
+{
+    if (!is_halted())
+    {
+        uint32_t at = pc;
+        const decoded_insn &d = fetch();
+        uint32_t addr = regs.get(d.rs1) + d.imm;
+        int32_t old = regs.get(d.rd);
+
+        if (d.insn == insn_ecall && syscalls)
+        {
+            // a system call can write to the same stream as the trace, so
+            // print everything before it, then print it here
+            printer->drain();
+            (this->*(show_instructions ? &rv32i_hart::step<true> : &rv32i_hart::step<false>))(hdr);
+            printer->record(*this, at, d, addr, old, true);
+            return;
+        }
+
+        insn_counter++;
+        (this->*d.handler)(d, nullptr);
+        printer->record(*this, at, d, addr, old);
+    }
+}
+
+// Execute an instruction and record it for the observers.
+void rv32i_hart::step_observed(const std::string &)
+{
+    if (!is_halted())
+    {
+        insn_counter++;
+
+        const decoded_insn &d = fetch();
+        retired_insn &r = record_retired(d);
+
+        (this->*d.handler)(d, nullptr);
+        r.next_pc = pc;
+    }
+}
+
+// Execute an instruction with a tracing implementation and record it.
+template<rv32i_hart::tick_fn step>
+void rv32i_hart::step_observed_traced(const std::string &hdr)
+{
+    if (!is_halted())
+    {
+        retired_insn &r = record_retired(fetch());
+
+        (this->*step)(hdr);
+        r.next_pc = pc;
+    }
+}
+
+// Record an instruction for the observers before it executes.
+retired_insn &rv32i_hart::record_retired(const decoded_insn &d)
+{
+    if (retired_count == retired_buf.size())
+    {
+        flush_retired();
     }
+
+    retired_insn &r = retired_buf[retired_count++];
+    r.pc = pc;
+    r.insn = d.insn;
+    r.addr = regs.get(d.rs1) + d.imm;  // the address, if it loads or stores
+    r.len = d.len;
+    r.rd = d.rd;
+    r.rs1 = d.rs1;
+    r.rs2 = d.rs2;
+    return r;
+}
+
+// Attach an observer.
+void rv32i_hart::add_observer(hart_observer *o)
+{
+    observers.push_back(o);
+    retired_buf.resize(retired_batch_size);
+}
+
+// Hand the buffered instructions to the observers.
+void rv32i_hart::flush_retired()
+{
+    for (hart_observer *o : observers)
+    {
+        o->retired_batch(retired_buf.data(), retired_count);
+    }
+
+    retired_count = 0;
 }
 
 // Execute the given RV32I instruction.
 void rv32i_hart::exec(uint32_t insn, std::ostream* pos)
 {
+    decoded_insn d;
+    predecode(insn, d);
+    (this->*(pos ? get_handler<true>(insn) : d.handler))(d, pos);
+}
+
+// Execute one basic block, or at most max instructions of it.
+void rv32i_hart::tick_block(uint64_t max, const std::string &hdr)
+{
+    if (((show_instructions || show_registers) && !recorder) || !is_cacheable(pc))
+    {
+        tick(hdr);
+        return;
+    }
+
+    if (is_halted()) { return; }
+
+    decoded_page &page = get_decoded_page(pc / decode_page_size);
+    const decoded_insn *d = &page[(pc % decode_page_size) / decode_slot];
+
+    if (!d->block_len)
+    {
+        discover_block(page, (pc % decode_page_size) / decode_slot);
+    }
+
+    uint64_t n = std::min<uint64_t>(d->block_len, max);
+
+    if (recorder)
+    {
+        insn_counter += observers.empty() ? run_block<false, true>(d, n) : run_block<true, true>(d, n);
+    }
+    else insn_counter += observers.empty() ? run_block<false, false>(d, n) : run_block<true, false>(d, n);
+}
+
+// Execute the first n instructions of a decoded block.
+template<bool observed, bool recorded>
+uint64_t rv32i_hart::run_block(const decoded_insn *d, uint64_t n)
+{
+    uint64_t i = 0;
+
+    decode_flushed = false;
+    while (i != n)
+    {
+        retired_insn *r = observed ? &record_retired(*d) : nullptr;
+        uint32_t at = pc;
+        uint32_t addr = recorded ? regs.get(d->rs1) + d->imm : 0;  // the address, if it loads or stores
+        int32_t old = recorded ? regs.get(d->rd) : 0;
+
+        (this->*d->handler)(*d, nullptr);
+        ++i;
+
+        if (observed) { r->next_pc = pc; }
+        if (recorded) { recorder->record(*this, at, *d, addr, old); }
+
+        if (decode_flushed) { break; }  // a store hit decoded code, rediscover
+        if (halt) { break; }            // an illegal load or store stops the block where it is
+
+        d += d->len / decode_slot;
+    }
+
+    return i;
+}
+
+// Is the instruction at addr eligible for the decode cache?
+bool rv32i_hart::is_cacheable(uint32_t addr) const
+{
+    return addr % decode_slot == 0 && addr < mem.get_size();
+}
+
+// Get the decoded form of the instruction at pc.
+const rv32i_hart::decoded_insn &rv32i_hart::fetch()
+{
+    if (!is_cacheable(pc))
+    {
+        // not cacheable, decode it every time
+        decode_at(pc, fetch_scratch);
+        return fetch_scratch;
+    }
+
+    decoded_insn &d = get_decoded_page(pc / decode_page_size)[(pc % decode_page_size) / decode_slot];
+
+    if (!d.handler)
+    {
+        decode_at(pc, d);
+    }
+
+    return d;
+}
+
+// Get a page of the decode cache, allocating it if needed.
+rv32i_hart::decoded_page &rv32i_hart::get_decoded_page(uint32_t page)
+{
+    if (page >= decode_cache.size())
+    {
+        decode_cache.resize(page + 1);      // grows with the highest page executed
+    }
+
+    std::unique_ptr<decoded_page> &p = decode_cache[page];
+
+    if (!p)
+    {
+        p.reset(new decoded_page());
+    }
+
+    return *p;
+}
+
+// Decode the basic block that starts at pc and record its length.
+void rv32i_hart::discover_block(decoded_page &page, uint32_t first)
+{
+    uint32_t i = first;
+    uint32_t addr = pc;
+    uint16_t n = 0;
+
+    while (i < page.size() && addr < mem.get_size())
+    {
+        decoded_insn &d = page[i];
+
+        if (!d.handler)
+        {
+            decode_at(addr, d);
+        }
+
+        ++n;
+        i += d.len / decode_slot;
+        addr += d.len;
+
+        if (ends_block(d)) { break; }
+    }
+
+    page[first].block_len = n;
+}
+
+// Does this instruction end a basic block?
+bool rv32i_hart::ends_block(const decoded_insn &d)
+{
+    switch (get_opcode(d.insn))
+    {
+        case opcode_jal:
+        case opcode_jalr:
+        case opcode_btype:
+        case opcode_system:
+            return true;
+    }
+
+    return d.handler == &rv32i_hart::exec_illegal_insn<false>;
+}
+
+// Discard the decoded instructions a store overwrote.
+void rv32i_hart::invalidate_decoded(uint32_t addr, uint32_t len)
+{
+    // an instruction that starts up to 3 bytes before addr may cover it, and
+    // a store that straddles the top of the address space wraps to page 0
+    uint64_t end = uint64_t(addr) + len;
+    uint64_t s = (addr >= 3 ? addr - 3 : 0) / decode_slot * decode_slot;
+    bool hit = false;
+
+    while (s < end)
+    {
+        uint32_t page = uint32_t(s) / decode_page_size;
+        uint64_t page_end = std::min(end, (s / decode_page_size + 1) * decode_page_size);
+
+        if (page < decode_cache.size() && decode_cache[page])
+        {
+            decoded_page &p = *decode_cache[page];
+            uint32_t last_hit = 0;
+            bool page_hit = false;
+
+            for (; s < page_end; s += decode_slot)
+            {
+                uint32_t i = (s % decode_page_size) / decode_slot;
+
+                if (p[i].handler && s + p[i].len > addr)
+                {
+                    p[i].handler = nullptr;     // the entry stays in place, it may still be executing
+                    last_hit = i;
+                    page_hit = true;
+                }
+            }
+
+            if (page_hit)
+            {
+                // forget the lengths of the blocks that may hold it
+                for (uint32_t i = 0; i <= last_hit; ++i)
+                {
+                    p[i].block_len = 0;
+                }
+                hit = true;
+            }
+        }
+
+        s = page_end;
+    }
+
+    if (hit)
+    {
+        decode_flushed = true;
+
+        if (attached_jit)
+        {
+            attached_jit->invalidate(addr, len);
+        }
+    }
+}
+
+// Decode the instruction at addr, expanding it if it is compressed.
+void rv32i_hart::decode_at(uint32_t addr, decoded_insn &d) const
+{
+    if (compressed)
+    {
+        uint16_t half = mem.get16(addr);
+
+        if (is_compressed(half))
+        {
+            predecode(expand_compressed(half), d);
+            d.len = 2;
+            return;
+        }
+    }
+
+    predecode(mem.get32(addr), d);
+}
+
+// Decode an instruction into its handler, register indices and immediate.
+void rv32i_hart::predecode(uint32_t insn, decoded_insn &d)
+{
+    d.insn = insn;
+    d.len = 4;
+    d.rd = get_rd(insn);
+    d.rs1 = get_rs1(insn);
+    d.rs2 = get_rs2(insn);
+
     switch (get_opcode(insn))
     {
-        default:                            return exec_illegal_insn(insn, pos);
-        case opcode_lui:                    return exec_lui(insn, pos);
-        case opcode_auipc:                  return exec_auipc(insn, pos);
-        case opcode_jal:                    return exec_jal(insn, pos);
-        case opcode_jalr:                   return exec_jalr(insn, pos);
-        case opcode_btype:                  return exec_btype(insn, pos);
-        case opcode_load_imm:               return exec_load_imm(insn, pos);
-        case opcode_stype:                  return exec_stype(insn, pos);
+        default:                            d.imm = get_imm_i(insn); break;
+        case opcode_lui:
+        case opcode_auipc:                  d.imm = get_imm_u(insn); break;
+        case opcode_jal:                    d.imm = get_imm_j(insn); break;
+        case opcode_btype:                  d.imm = get_imm_b(insn); break;
+        case opcode_stype:                  d.imm = get_imm_s(insn); break;
 
         case opcode_alu_imm:
             switch (get_funct3(insn))
             {
-                default:                    return exec_illegal_insn(insn, pos);
-                case funct3_add:            return exec_addi(insn, pos);
-                case funct3_sll:            return exec_slli(insn, pos);
-                case funct3_slt:            return exec_slti(insn, pos);
-                case funct3_sltu:           return exec_sltiu(insn, pos);
-                case funct3_xor:            return exec_xori(insn, pos);
+                default:                    d.imm = get_imm_i(insn); break;
+                case funct3_sll:
+                case funct3_srx:            d.imm = get_imm_i(insn) % XLEN; break;
+            }
+            break;
+    }
+
+    d.handler = get_handler<false>(insn);
+}
+
+// Find the handler that executes the given instruction.
+template<bool traced>
+rv32i_hart::exec_handler rv32i_hart::get_handler(uint32_t insn)
+{
+    switch (get_opcode(insn))
+    {
+        default:                            return &rv32i_hart::exec_illegal_insn<traced>;
+        case opcode_lui:                    return &rv32i_hart::exec_lui<traced>;
+        case opcode_auipc:                  return &rv32i_hart::exec_auipc<traced>;
+        case opcode_jal:                    return &rv32i_hart::exec_jal<traced>;
+        case opcode_jalr:                   return &rv32i_hart::exec_jalr<traced>;
+        case opcode_btype:                  return &rv32i_hart::exec_btype<traced>;
+        case opcode_load_imm:               return &rv32i_hart::exec_load_imm<traced>;
+        case opcode_stype:                  return &rv32i_hart::exec_stype<traced>;
+
+        case opcode_alu_imm:
+            switch (get_funct3(insn))
+            {
+                default:                    return &rv32i_hart::exec_illegal_insn<traced>;
+                case funct3_add:            return &rv32i_hart::exec_addi<traced>;
+                case funct3_sll:            return &rv32i_hart::exec_slli<traced>;
+                case funct3_slt:            return &rv32i_hart::exec_slti<traced>;
+                case funct3_sltu:           return &rv32i_hart::exec_sltiu<traced>;
+                case funct3_xor:            return &rv32i_hart::exec_xori<traced>;
                 case funct3_srx:
                     switch(get_funct7(insn))
                     {
-                        default:            return exec_illegal_insn(insn, pos);
-                        case funct7_srl:    return exec_srli(insn, pos);
-                        case funct7_sra:    return exec_srai(insn, pos);
+                        default:            return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct7_srl:    return &rv32i_hart::exec_srli<traced>;
+                        case funct7_sra:    return &rv32i_hart::exec_srai<traced>;
                     }
                     assert(0 && "unrecognized funct7");
-                case funct3_or:             return exec_ori(insn, pos);
-                case funct3_and:            return exec_andi(insn, pos);
+                case funct3_or:             return &rv32i_hart::exec_ori<traced>;
+                case funct3_and:            return &rv32i_hart::exec_andi<traced>;
             }
             assert(0 && "unrecognized funct3");
 
         case opcode_rtype:
+            if (get_funct7(insn) == funct7_muldiv)
+            {
+                switch (get_funct3(insn))
+                {
+                    case funct3_mul:        return &rv32i_hart::exec_mul<traced>;
+                    case funct3_mulh:       return &rv32i_hart::exec_mulh<traced>;
+                    case funct3_mulhsu:     return &rv32i_hart::exec_mulhsu<traced>;
+                    case funct3_mulhu:      return &rv32i_hart::exec_mulhu<traced>;
+                    case funct3_div:        return &rv32i_hart::exec_div<traced>;
+                    case funct3_divu:       return &rv32i_hart::exec_divu<traced>;
+                    case funct3_rem:        return &rv32i_hart::exec_rem<traced>;
+                    case funct3_remu:       return &rv32i_hart::exec_remu<traced>;
+                }
+                assert(0 && "unrecognized funct3");
+            }
             switch (get_funct3(insn))
             {
-                default:                    return exec_illegal_insn(insn, pos);
+                default:                    return &rv32i_hart::exec_illegal_insn<traced>;
                 case funct3_add:
                     switch (get_funct7(insn))
                     {
-                        default:            return exec_illegal_insn(insn, pos);
-                        case funct7_add:    return exec_add(insn, pos);
-                        case funct7_sub:    return exec_sub(insn, pos);
+                        default:            return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct7_add:    return &rv32i_hart::exec_add<traced>;
+                        case funct7_sub:    return &rv32i_hart::exec_sub<traced>;
                     }
                     assert(0 && "unrecognized funct7");
-                case funct3_sll:            return exec_sll(insn, pos);
-                case funct3_slt:            return exec_slt(insn, pos);
-                case funct3_sltu:           return exec_sltu(insn, pos);
-                case funct3_xor:            return exec_xor(insn, pos);
+                case funct3_sll:            return &rv32i_hart::exec_sll<traced>;
+                case funct3_slt:            return &rv32i_hart::exec_slt<traced>;
+                case funct3_sltu:           return &rv32i_hart::exec_sltu<traced>;
+                case funct3_xor:            return &rv32i_hart::exec_xor<traced>;
                 case funct3_srx:
                     switch (get_funct7(insn))
                     {
-                        default:            return exec_illegal_insn(insn, pos);
-                        case funct7_srl:    return exec_srl(insn, pos);
-                        case funct7_sra:    return exec_sra(insn, pos);
+                        default:            return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct7_srl:    return &rv32i_hart::exec_srl<traced>;
+                        case funct7_sra:    return &rv32i_hart::exec_sra<traced>;
                     }
                     assert(0 && "unrecognized funct7");
-                case funct3_or:             return exec_or(insn, pos);
-                case funct3_and:            return exec_and(insn, pos);
+                case funct3_or:             return &rv32i_hart::exec_or<traced>;
+                case funct3_and:            return &rv32i_hart::exec_and<traced>;
             }
             assert(0 && "unrecognized funct3");
 
@@ -124,43 +556,55 @@ void rv32i_hart::exec(uint32_t insn, std::ostream* pos)
                 default:
                     switch (get_funct3(insn))
                     {
-                        default:            return exec_illegal_insn(insn, pos);
-                        case funct3_csrrw:  return exec_illegal_insn(insn, pos);
-                        case funct3_csrrs:  return exec_csrrs(insn, pos);
-                        case funct3_csrrc:  return exec_illegal_insn(insn, pos);
-                        case funct3_csrrwi: return exec_illegal_insn(insn, pos);
-                        case funct3_csrrsi: return exec_illegal_insn(insn, pos);
-                        case funct3_csrrci: return exec_illegal_insn(insn, pos);
+                        default:            return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct3_csrrw:  return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct3_csrrs:  return &rv32i_hart::exec_csrrs<traced>;
+                        case funct3_csrrc:  return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct3_csrrwi: return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct3_csrrsi: return &rv32i_hart::exec_illegal_insn<traced>;
+                        case funct3_csrrci: return &rv32i_hart::exec_illegal_insn<traced>;
                     }
                     assert(0 && "unrecognized funct3");
-                case insn_ecall:            return exec_ecall(insn, pos);
-                case insn_ebreak:           return exec_ebreak(insn, pos);
+                case insn_ecall:            return &rv32i_hart::exec_ecall<traced>;
+                case insn_ebreak:           return &rv32i_hart::exec_ebreak<traced>;
             }
             assert(0 && "unrecognized instruction");
     }
     assert(0 && "unrecognized opcode");
 }
 
+// Print the decoded instruction at pc.
+void rv32i_hart::print_decoded(std::ostream &os, const decoded_insn &d) const
+{
+    static const std::string spaces(instruction_width, ' ');
+    const std::string &s = decode_cached(pc, d.insn);
+
+    os.write(s.data(), s.size());
+    if (s.size() < size_t(instruction_width))
+    {
+        os.write(spaces.data(), instruction_width - s.size());
+    }
+}
+
 // Execute illegal instruction.
-void rv32i_hart::exec_illegal_insn(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_illegal_insn(const decoded_insn &d, std::ostream* pos)
 {
-    (void)insn;
-    if (pos)
+    if (traced)
     {
-        *pos << render_illegal_insn(insn);
+        *pos << render_illegal_insn(d.insn);
     }
     halt = true;
     halt_reason = "Illegal instruction";
 }
 
 // Execute ebreak instruction
-void rv32i_hart::exec_ebreak(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_ebreak(const decoded_insn &d, std::ostream* pos)
 {
-    (void)insn;
-    if (pos)
+    if (traced)
     {
-        std::string s = render_ebreak(insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// HALT";
     }
 
@@ -169,167 +613,217 @@ void rv32i_hart::exec_ebreak(uint32_t insn, std::ostream* pos)
 }
 
 // Execute ecall instruction
-void rv32i_hart::exec_ecall(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_ecall(const decoded_insn &d, std::ostream* pos)
 {
-    (void)insn;
-    if (pos)
+    host_syscalls::request r;
+    r.num = regs.get(17);
+
+    if (!syscalls || !host_syscalls::is_supported(r.num))
     {
-        std::string s = render_ecall(insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// HALT";
+        if (traced)
+        {
+            print_decoded(*pos, d);
+            *pos << "// HALT";
+        }
+
+        halt = true;
+        halt_reason = "ECALL instruction";
+        return;
     }
 
-    halt = true;
-    halt_reason = "ECALL instruction";
+    r.arg[0] = regs.get(10);
+    r.arg[1] = regs.get(11);
+    r.arg[2] = regs.get(12);
+    syscalls->call(r);
+
+    if (r.store_len)
+    {
+        invalidate_decoded(r.store_addr, r.store_len);
+    }
+
+    finish_ecall<traced>(d, pos, r);
+}
+
+// Finish an ecall that the syscall layer has carried out.
+template<bool traced>
+void rv32i_hart::finish_ecall(const decoded_insn &d, std::ostream* pos, const host_syscalls::request &r)
+{
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// ";
+        if (!r.exited)
+        {
+            *pos << render_reg(10) << " = ";
+        }
+        *pos << host_syscalls::name(r.num) << "(" << hex::to_hex0x32(r.arg[0]) << ", "
+             << hex::to_hex0x32(r.arg[1]) << ", " << hex::to_hex0x32(r.arg[2]) << ")";
+        if (r.exited)
+        {
+            *pos << ", HALT";
+        }
+        else
+        {
+            *pos << " = " << hex::to_hex0x32(r.ret);
+        }
+    }
+
+    if (r.exited)
+    {
+        halt = true;
+        halt_reason = "exit(" + std::to_string(r.arg[0]) + ")";
+        return;
+    }
+
+    regs.set(10, r.ret);
+    pc += d.len;
 }
 
 // Execute lui instruction.
-void rv32i_hart::exec_lui(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_lui(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t imm_u = get_imm_u(insn);
+    uint32_t rd = d.rd;
+    int32_t imm_u = d.imm;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_lui(insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(imm_u);
     }
     
     regs.set(rd, imm_u);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute auipc instruction.
-void rv32i_hart::exec_auipc(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_auipc(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t imm_u = get_imm_u(insn);
+    uint32_t rd = d.rd;
+    int32_t imm_u = d.imm;
     int32_t val = pc + imm_u;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_auipc(insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc) << " + "
              << hex::to_hex0x32(imm_u) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute jal instruction.
-void rv32i_hart::exec_jal(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_jal(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t imm_j = get_imm_j(insn);
+    uint32_t rd = d.rd;
+    int32_t imm_j = d.imm;
     int32_t val = pc + imm_j;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_jal(pc, insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc+4) << ",  "
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc+d.len) << ",  "
              << "pc = " << hex::to_hex0x32(pc) << " + " << hex::to_hex0x32(imm_j)
              << " = " << hex::to_hex0x32(val);
     }
 
-    regs.set(rd, pc+4);
+    regs.set(rd, pc+d.len);
     pc = val;
 }
 
 // Execute jalr instruction.
-void rv32i_hart::exec_jalr(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_jalr(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = (imm_i + rs1) & 0xfffffffe;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_jalr(insn);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc+4) << ",  "
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(pc+d.len) << ",  "
              << "pc = (" << hex::to_hex0x32(imm_i) << " + " << hex::to_hex0x32(rs1)
              << ") & 0xfffffffe" << " = " << hex::to_hex0x32(val);
     }
 
-    regs.set(rd, pc+4);
+    regs.set(rd, pc+d.len);
     pc = val;
 }
 
 // Execute btype instruction.
-void rv32i_hart::exec_btype(uint32_t insn, std::ostream *pos)
+template<bool traced>
+void rv32i_hart::exec_btype(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t funct3 = get_funct3(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
-    int32_t imm_b = get_imm_b(insn);
+    uint32_t funct3 = get_funct3(d.insn);
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t imm_b = d.imm;
     int32_t val;
-    const char* mnemonic[] = { "beq", "bne", "", "", "blt", "bge", "bltu", "bgeu" };
-    std::string op[] = {" == ", " != ", "", "", " < ", " >= ", " <U ", " >=U "};
 
     switch (funct3)
     {
-        default: 
-            exec_illegal_insn(insn, pos);
-            break;
+        default:
+            exec_illegal_insn<traced>(d, pos);
+            return;                     // leave rd and pc as they were
 
         case funct3_beq:
-            val = rs1 == rs2 ? imm_b : 4;
+            val = rs1 == rs2 ? imm_b : d.len;
             break;
 
         case funct3_bne:
-            val = rs1 != rs2 ? imm_b : 4;
+            val = rs1 != rs2 ? imm_b : d.len;
             break;
 
         case funct3_blt:
-            val = rs1 < rs2 ? imm_b : 4;
+            val = rs1 < rs2 ? imm_b : d.len;
             break;
 
         case funct3_bge:
-            val = rs1 >= rs2 ? imm_b : 4;
+            val = rs1 >= rs2 ? imm_b : d.len;
             break;
 
         case funct3_bltu:
-            val = (uint32_t)rs1 < (uint32_t)rs2 ? imm_b : 4;
+            val = (uint32_t)rs1 < (uint32_t)rs2 ? imm_b : d.len;
             break;
 
         case funct3_bgeu:
-            val = (uint32_t)rs1 >= (uint32_t)rs2 ? imm_b : 4;
+            val = (uint32_t)rs1 >= (uint32_t)rs2 ? imm_b : d.len;
             break;
     }
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_btype(pc, insn, mnemonic[funct3]);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        static const char *const op[] = {" == ", " != ", "", "", " < ", " >= ", " <U ", " >=U "};
+        print_decoded(*pos, d);
         *pos << "// pc += (" << hex::to_hex0x32(rs1) << op[funct3] << hex::to_hex0x32(rs2)
-             << " ? " << hex::to_hex0x32(imm_b) << " : 4) = " << hex::to_hex0x32(pc+val);
+             << " ? " << hex::to_hex0x32(imm_b) << " : " << int(d.len) << ") = " << hex::to_hex0x32(pc+val);
     }
 
     pc += val;
 }
 
 // Execute load instruction.
-void rv32i_hart::exec_load_imm(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_load_imm(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t funct3 = get_funct3(insn);
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t funct3 = get_funct3(d.insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val;
-    const char* mnemonic[] = { "lb", "lh", "lw", "", "lbu", "lhu" };
-    std::string prefix[] = { "sx(m8(", "sx(m16(", "sx(m32(", "", "zx(m8(", "zx(m16(" };
-
 
     switch (funct3)
     {
         default:
-            exec_illegal_insn(insn, pos);
-            break;
+            exec_illegal_insn<traced>(d, pos);
+            return;                     // leave rd and pc as they were
 
         case funct3_lb:
             val = mem.get8_sx(rs1 + imm_i);
@@ -352,453 +846,639 @@ void rv32i_hart::exec_load_imm(uint32_t insn, std::ostream* pos)
             break;
     }
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_load(insn, mnemonic[funct3]);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        static const char *const prefix[] = { "sx(m8(", "sx(m16(", "sx(m32(", "", "zx(m8(", "zx(m16(" };
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << prefix[funct3] << hex::to_hex0x32(rs1)
              << " + " << hex::to_hex0x32(imm_i) << ")) = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute stype instruction.
-void rv32i_hart::exec_stype(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_stype(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t funct3 = get_funct3(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
-    int32_t imm_s = get_imm_s(insn);
-    const char* mnemonic[] = { "sb", "sh", "sw" };
-    std::string prefix[] = { "m8(", "m16(", "m32(" };
+    uint32_t funct3 = get_funct3(d.insn);
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t imm_s = d.imm;
+    uint32_t len = 0;
 
     switch (funct3)
     {
         default:
-            exec_illegal_insn(insn, pos);
-            break;
+            exec_illegal_insn<traced>(d, pos);
+            return;                     // leave rd and pc as they were
 
         case funct3_sb:
             rs2 &= 0xff;
             mem.set8(rs1 + imm_s, rs2);
+            len = 1;
             break;
         case funct3_sh:
             rs2 &= 0xffff;
             mem.set16(rs1 + imm_s, rs2);
+            len = 2;
             break;
         case funct3_sw:
             mem.set32(rs1 + imm_s, rs2);
+            len = 4;
             break;
     }
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_stype(insn, mnemonic[funct3]);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        static const char *const prefix[] = { "m8(", "m16(", "m32(" };
+        print_decoded(*pos, d);
         *pos << "// " << prefix[funct3] << hex::to_hex0x32(rs1) << " + " << hex::to_hex0x32(imm_s)
              << ") = " << hex::to_hex0x32(rs2);
     }
 
-    pc += 4;
+    if (len)
+    {
+        invalidate_decoded(rs1 + imm_s, len);
+    }
+
+    pc += d.len;
 }
 
 // Execute addi instruction.
-void rv32i_hart::exec_addi(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_addi(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = rs1 + imm_i;
     
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "addi", imm_i);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " + "
              << hex::to_hex0x32(imm_i) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute slti instruction.
-void rv32i_hart::exec_slti(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_slti(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = rs1 < imm_i ? 1 : 0;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "slti", get_imm_i(insn));
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " < "
              << imm_i << ") ? 1 : 0 = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute sltiu instruction.
-void rv32i_hart::exec_sltiu(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_sltiu(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t imm_i = d.imm;
     uint32_t val = rs1 < imm_i ? 1 : 0;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "sltiu", get_imm_i(insn));
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " <U "
              << imm_i << ") ? 1 : 0 = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute xori instruction.
-void rv32i_hart::exec_xori(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_xori(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = rs1 ^ imm_i;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "xori", get_imm_i(insn));
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " ^ "
              << hex::to_hex0x32(imm_i) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute ori instruction.
-void rv32i_hart::exec_ori(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_ori(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = rs1 | imm_i;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "ori", get_imm_i(insn));
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " | "
              << hex::to_hex0x32(imm_i) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute andi instruction.
-void rv32i_hart::exec_andi(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_andi(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t imm_i = get_imm_i(insn);
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t imm_i = d.imm;
     int32_t val = rs1 & imm_i;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "andi", get_imm_i(insn));
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " & "
              << hex::to_hex0x32(imm_i) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute slli instruction.
-void rv32i_hart::exec_slli(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_slli(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = get_imm_i(insn) % XLEN;
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = d.imm;
     int32_t val = rs1 << shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "slli", shamt);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " << "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute srli instruction.
-void rv32i_hart::exec_srli(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_srli(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = get_imm_i(insn) % XLEN;
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = d.imm;
     uint32_t val = rs1 >> shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "srli", shamt);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " >> "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute srai instruction.
-void rv32i_hart::exec_srai(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_srai(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = get_imm_i(insn) % XLEN;
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = d.imm;
     int32_t val = rs1 >> shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_itype_alu(insn, "srai", shamt);
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " >> "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute add instruction.
-void rv32i_hart::exec_add(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_add(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     int32_t val = rs1 + rs2;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "add");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;   
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " + "
              << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute sub instruction.
-void rv32i_hart::exec_sub(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_sub(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     int32_t val = rs1 - rs2;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "sub");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;   
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " - "
              << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute sll instruction.
-void rv32i_hart::exec_sll(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_sll(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = regs.get(get_rs2(insn)) & 0x1f;
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = regs.get(d.rs2) & 0x1f;
     int32_t val = rs1 << shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "sll");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;   
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " << "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute slt instruction
-void rv32i_hart::exec_slt(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_slt(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     uint32_t val = rs1 < rs2 ? 1 : 0;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "slt");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " < " 
              << hex::to_hex0x32(rs2) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute sltu instruction
-void rv32i_hart::exec_sltu(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_sltu(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t rs2 = regs.get(d.rs2);
     uint32_t val = rs1 < rs2 ? 1 : 0;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "sltu");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " <U " 
              << hex::to_hex0x32(rs2) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute xor instruction.
-void rv32i_hart::exec_xor(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_xor(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     int32_t val = rs1 ^ rs2;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "xor");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " ^ "
              << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute srl instruction.
-void rv32i_hart::exec_srl(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_srl(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = regs.get(get_rs2(insn)) & 0x1f;
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = regs.get(d.rs2) & 0x1f;
     uint32_t val = rs1 >> shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "srl");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " >> "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute sra instruction.
-void rv32i_hart::exec_sra(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_sra(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t shamt = regs.get(get_rs2(insn)) & 0x1f;
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    uint32_t shamt = regs.get(d.rs2) & 0x1f;
     int32_t val = rs1 >> shamt;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "sra");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " >> "
              << shamt << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute or instruction.
-void rv32i_hart::exec_or(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_or(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     int32_t val = rs1 | rs2;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "or");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " | "
              << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
 }
 
 // Execute and instruction.
-void rv32i_hart::exec_and(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_and(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    int32_t rs1 = regs.get(get_rs1(insn));
-    int32_t rs2 = regs.get(get_rs2(insn));
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
     int32_t val = rs1 & rs2;
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_rtype(insn, "and");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " & "
              << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += d.len;
+}
+
+// Execute mul instruction.
+template<bool traced>
+void rv32i_hart::exec_mul(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t val = uint32_t(rs1) * uint32_t(rs2);     // low 32 bits are the same signed or not
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " * "
+             << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute mulh instruction.
+template<bool traced>
+void rv32i_hart::exec_mulh(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t val = (int64_t(rs1) * int64_t(rs2)) >> 32;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " * "
+             << hex::to_hex0x32(rs2) << ") >> 32 = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute mulhsu instruction.
+template<bool traced>
+void rv32i_hart::exec_mulhsu(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    uint32_t rs2 = regs.get(d.rs2);
+    int32_t val = (int64_t(rs1) * int64_t(rs2)) >> 32;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " *SU "
+             << hex::to_hex0x32(rs2) << ") >> 32 = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute mulhu instruction.
+template<bool traced>
+void rv32i_hart::exec_mulhu(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t rs2 = regs.get(d.rs2);
+    uint32_t val = (uint64_t(rs1) * uint64_t(rs2)) >> 32;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1) << " *U "
+             << hex::to_hex0x32(rs2) << ") >> 32 = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute div instruction.
+template<bool traced>
+void rv32i_hart::exec_div(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t val;
+
+    if (rs2 == 0)
+        val = -1;                           // division by zero
+    else if (rs1 == INT32_MIN && rs2 == -1)
+        val = rs1;                          // overflow
+    else
+        val = rs1 / rs2;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " / "
+             << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute divu instruction.
+template<bool traced>
+void rv32i_hart::exec_divu(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t rs2 = regs.get(d.rs2);
+    uint32_t val = rs2 ? rs1 / rs2 : 0xffffffff;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " /U "
+             << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute rem instruction.
+template<bool traced>
+void rv32i_hart::exec_rem(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    int32_t rs1 = regs.get(d.rs1);
+    int32_t rs2 = regs.get(d.rs2);
+    int32_t val;
+
+    if (rs2 == 0)
+        val = rs1;                          // division by zero
+    else if (rs1 == INT32_MIN && rs2 == -1)
+        val = 0;                            // overflow
+    else
+        val = rs1 % rs2;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " % "
+             << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
+}
+
+// Execute remu instruction.
+template<bool traced>
+void rv32i_hart::exec_remu(const decoded_insn &d, std::ostream* pos)
+{
+    uint32_t rd = d.rd;
+    uint32_t rs1 = regs.get(d.rs1);
+    uint32_t rs2 = regs.get(d.rs2);
+    uint32_t val = rs2 ? rs1 % rs2 : rs1;
+
+    if (traced)
+    {
+        print_decoded(*pos, d);
+        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1) << " %U "
+             << hex::to_hex0x32(rs2) << " = " << hex::to_hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += d.len;
 }
 
 // Execute csrrs instruction.
-void rv32i_hart::exec_csrrs(uint32_t insn, std::ostream* pos)
+template<bool traced>
+void rv32i_hart::exec_csrrs(const decoded_insn &d, std::ostream* pos)
 {
-    uint32_t rd = get_rd(insn);
-    uint32_t csr = get_imm_i(insn);
-    uint32_t rs1 = regs.get(get_rs1(insn));
-    uint32_t val = csr & rs1;
+    uint32_t rd = d.rd;
+    uint32_t csr = d.imm & 0xfff;
+    uint32_t val = csr == 0xf14 ? mhartid : 0;  // mhartid is the only CSR, and it's read-only
 
-    if (pos)
+    if (traced)
     {
-        std::string s = render_csrrx(insn, "csrrs");
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        print_decoded(*pos, d);
         *pos << "// " << render_reg(rd) << " = " << val;
     }
 
     regs.set(rd, val);
-    pc += 4;  
+    pc += d.len;
 }
+
+// trace_reader replays recorded instructions through these
+template rv32i_hart::exec_handler rv32i_hart::get_handler<true>(uint32_t insn);
+template void rv32i_hart::finish_ecall<true>(const decoded_insn &d, std::ostream* pos, const host_syscalls::request &r);
+template void rv32i_hart::finish_ecall<false>(const decoded_insn &d, std::ostream* pos, const host_syscalls::request &r);
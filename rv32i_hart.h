@@ -13,15 +13,34 @@
 //
 //******************************************************************************
 
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
 #include "rv32i_decode.h"
 #include "registerfile.h"
 #include "memory.h"
+#include "host_syscalls.h"
+#include "hart_observer.h"
+
+class rv32i_jit;
+class binary_trace;
+class trace_writer;
+class trace_replayer;
+class trace_printer;
 
 /**
  * @brief Class to represent the execution unit of a RV32I hart.
  * ********************************************************************/
 class rv32i_hart : public rv32i_decode
 {
+    friend class rv32i_jit;
+    friend class binary_trace;
+    friend class trace_writer;
+    friend class trace_replayer;
+    friend class trace_printer;
+
     public:
         /**
          * @brief Constructor.
@@ -38,6 +57,12 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         void set_show_instructions(bool b) { show_instructions = b; }
 
+        /**
+         * @brief Accessor for show_instructions.
+         * @return true if each instruction executed is shown.
+         * ********************************************************************/
+        bool get_show_instructions() const { return show_instructions; }
+
         /**
          * @brief Mutator for show_registers.
          * 
@@ -47,6 +72,12 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         void set_show_registers(bool b) { show_registers = b; }
 
+        /**
+         * @brief Accessor for show_registers.
+         * @return true if the registers are dumped before each instruction.
+         * ********************************************************************/
+        bool get_show_registers() const { return show_registers; }
+
         /**
          * @brief Accessor for halt. 
          * @return true if the hart has been halted for any reason.
@@ -67,8 +98,9 @@ class rv32i_hart : public rv32i_decode
         /**
          * @brief Dump the entire state of the hart.
          * @param hdr A string to print at the beginning of each line.
+         * @param os Where to print it.
          * ********************************************************************/
-        void dump(const std::string &hdr="") const;
+        void dump(const std::string &hdr="", std::ostream &os = std::cout) const;
 
         /**
          * @brief Accessor for insn_counter.
@@ -77,6 +109,30 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         uint64_t get_insn_counter() const { return insn_counter; }
 
+        /**
+         * @brief Mutator for insn_counter, used to resume from a checkpoint.
+         * @param n The number of instructions already executed.
+         * ********************************************************************/
+        void set_insn_counter(uint64_t n) { insn_counter = n; }
+
+        /**
+         * @brief Halts the hart, as an instruction would.
+         * @param reason The reason for the halt.
+         * ********************************************************************/
+        void set_halt(const std::string &reason) { halt = true; halt_reason = reason; }
+
+        /**
+         * @brief Accessor for pc.
+         * @return The address of the next instruction to execute.
+         * ********************************************************************/
+        uint32_t get_pc() const { return pc; }
+
+        /**
+         * @brief Mutator for pc.
+         * @param addr The address of the next instruction to execute.
+         * ********************************************************************/
+        void set_pc(uint32_t addr) { pc = addr; }
+
         /**
          * @brief Mutator for mhartid. 
          * 
@@ -88,6 +144,117 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         void set_mhardid(int i) { mhartid = i; }
 
+        /**
+         * @brief Accessor for mhartid.
+         * @return The value csrrs reads from CSR register 0xf14.
+         * ********************************************************************/
+        uint32_t get_mhartid() const { return mhartid; }
+
+        /**
+         * @brief Accessor for a register.
+         * @param r The register number.
+         * @return The value of register r.
+         * ********************************************************************/
+        int32_t get_reg(uint32_t r) const { return regs.get(r); }
+
+        /**
+         * @brief Mutator for a register. Writes to x0 are ignored.
+         * @param r The register number.
+         * @param val The value to store in register r.
+         * ********************************************************************/
+        void set_reg(uint32_t r, int32_t val) { regs.set(r, val); }
+
+        /**
+         * @brief Mutator for reset_pc.
+         * @param addr The address reset() starts execution at, such as the 
+         *        entry point of an ELF executable.
+         * ********************************************************************/
+        void set_reset_pc(uint32_t addr) { reset_pc = addr; }
+
+        /**
+         * @brief Mutator for compressed.
+         * 
+         * When true, the hart also executes 16-bit RV32C instructions. 
+         * Otherwise every instruction is 32 bits wide, as in plain RV32I.
+         * 
+         * @param b Value to set compressed.
+         * ********************************************************************/
+        void set_compressed(bool b) { compressed = b; }
+
+        /**
+         * @brief Accessor for compressed.
+         * @return true if RV32C instructions are executed.
+         * ********************************************************************/
+        bool get_compressed() const { return compressed; }
+
+        /**
+         * @brief Mutator for syscalls.
+         * 
+         * With a syscall layer attached, an ecall whose a7 names a call it
+         * supports is carried out by it. Any other ecall halts the hart.
+         * 
+         * @param s The syscall layer, or nullptr for none.
+         * ********************************************************************/
+        void set_syscalls(host_syscalls *s) { syscalls = s; }
+
+        /**
+         * @brief Accessor for syscalls.
+         * @return The attached syscall layer, or nullptr.
+         * ********************************************************************/
+        host_syscalls *get_syscalls() const { return syscalls; }
+
+        /**
+         * @brief Mutator for recorder.
+         * 
+         * With a recorder attached, every instruction executed is written to
+         * its binary trace, whatever the engine. show_instructions and 
+         * show_registers are ignored, as the trace can be turned back into
+         * their output later.
+         * 
+         * @param w The trace writer, or nullptr for none.
+         * ********************************************************************/
+        void set_recorder(trace_writer *w) { recorder = w; retired_buf.resize(retired_batch_size); }
+
+        /**
+         * @brief Accessor for recorder.
+         * @return The attached trace writer, or nullptr.
+         * ********************************************************************/
+        trace_writer *get_recorder() const { return recorder; }
+
+        /**
+         * @brief Mutator for printer.
+         * 
+         * With a printer attached, the output of show_instructions and 
+         * show_registers is handed to it to be formatted and written on 
+         * its own thread, rather than printed as each instruction executes.
+         * 
+         * @param p The trace printer, or nullptr for none.
+         * ********************************************************************/
+        void set_printer(trace_printer *p) { printer = p; }
+
+        /**
+         * @brief Attaches an observer.
+         * 
+         * Each observer is told about every instruction executed, after it
+         * has executed. The instructions are held in a buffer and handed 
+         * over in batches, when it fills and by flush_retired().
+         * 
+         * @param o The observer. It must outlive its attachment.
+         * ********************************************************************/
+        void add_observer(hart_observer *o);
+
+        /**
+         * @brief Accessor for observers.
+         * @return The attached observers, in the order they were added.
+         * ********************************************************************/
+        const std::vector<hart_observer*> &get_observers() const { return observers; }
+
+        /**
+         * @brief Hands the instructions executed since the last batch to the
+         *        observers. A run loop calls this before it returns.
+         * ********************************************************************/
+        void flush_retired();
+
         /**
          * @brief Tells the simulator to execute an instruction.
          * @param hdr Printed on the left of any and all output that is 
@@ -95,12 +262,224 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         void tick(const std::string &hdr="");
 
+        /**
+         * @brief Pointer to a tick() implementation.
+         * ********************************************************************/
+        using tick_fn = void (rv32i_hart::*)(const std::string &);
+
+        /**
+         * @brief Pick the tick() implementation for the current tracing 
+         *        settings, so that a run loop can decide once up front.
+         * @return The untraced implementation unless show_instructions is set
+         *         or a recorder, printer or observer is attached.
+         * ********************************************************************/
+        tick_fn get_tick() const;
+
+        /**
+         * @brief Tells the simulator to execute the basic block at pc.
+         * 
+         * The block's instructions are decoded once and then run back to 
+         * back without the per-instruction bookkeeping done by tick(), 
+         * other than recording them for any observers or recorder. Falls
+         * back to tick() when tracing or when pc can't be cached.
+         * 
+         * @param max The maximum number of instructions to execute.
+         * @param hdr Printed on the left of any and all output that is 
+         *        displayed as a result of calling this method.
+         * ********************************************************************/
+        void tick_block(uint64_t max, const std::string &hdr="");
+
     private:
         /**
          * @brief 
          * ********************************************************************/
         static constexpr int instruction_width = 35;
 
+        /**
+         * @brief Tells the simulator to execute an instruction.
+         * @tparam traced Whether to print the instruction. The untraced 
+         *         version does no formatting or stream output at all.
+         * @param hdr Printed on the left of any and all output that is 
+         *        displayed as a result of calling this method.
+         * ********************************************************************/
+        template<bool traced>
+        void step(const std::string &hdr);
+
+        /**
+         * @brief Tells the simulator to execute an instruction and write it 
+         *        to the recorder's trace.
+         * @param hdr Unused, as nothing is printed.
+         * ********************************************************************/
+        void step_recorded(const std::string &hdr);
+
+        /**
+         * @brief Tells the simulator to execute an instruction and hand it 
+         *        to the printer.
+         * @param hdr Printed on the left of any output for an instruction 
+         *        the hart prints itself.
+         * ********************************************************************/
+        void step_printed(const std::string &hdr);
+
+        /**
+         * @brief Tells the simulator to execute an instruction, untraced, 
+         *        and record it for the observers.
+         * @param hdr Unused, as nothing is printed.
+         * ********************************************************************/
+        void step_observed(const std::string &hdr);
+
+        /**
+         * @brief Tells the simulator to execute an instruction with a 
+         *        tracing implementation and record it for the observers.
+         * 
+         * The instruction is fetched here for its record and again by step,
+         * which costs little next to printing or recording it.
+         * 
+         * @tparam step The implementation get_step() picks.
+         * @param hdr Printed on the left of any and all output that is 
+         *        displayed as a result of calling this method.
+         * ********************************************************************/
+        template<tick_fn step>
+        void step_observed_traced(const std::string &hdr);
+
+        /**
+         * @brief Pick the tick() implementation for the current tracing 
+         *        settings, leaving out the observers.
+         * @return The implementation.
+         * ********************************************************************/
+        tick_fn get_step() const;
+
+        /**
+         * @brief Number of bytes of memory covered by one decode cache page.
+         * ********************************************************************/
+        static constexpr uint32_t decode_page_size = 4096;
+
+        /**
+         * @brief Number of bytes of memory covered by one decode cache 
+         *        entry, the size of the smallest (compressed) instruction.
+         * ********************************************************************/
+        static constexpr uint32_t decode_slot = 2;
+
+        struct decoded_insn;
+
+        /**
+         * @brief Pointer to the exec_* method that executes an instruction.
+         * ********************************************************************/
+        using exec_handler = void (rv32i_hart::*)(const decoded_insn &, std::ostream*);
+
+        /**
+         * @brief An instruction decoded once so that it can be executed 
+         *        without walking the opcode/funct3/funct7 switch again.
+         * ********************************************************************/
+        struct decoded_insn
+        {
+            exec_handler handler;   ///< Method to execute it, nullptr if not yet decoded.
+            uint32_t insn;          ///< The instruction word, expanded if it was compressed.
+            int32_t imm;            ///< The sign-extended immediate (or shamt).
+            uint8_t rd;             ///< The rd field.
+            uint8_t rs1;            ///< The rs1 field.
+            uint8_t rs2;            ///< The rs2 field.
+            uint8_t len;            ///< Length of the instruction in bytes (2 or 4).
+            uint16_t block_len;     ///< Length of the basic block starting here, 0 if unknown.
+        };
+
+        /**
+         * @brief The decoded instructions of one page of memory.
+         * ********************************************************************/
+        using decoded_page = std::array<decoded_insn, decode_page_size / decode_slot>;
+
+        /**
+         * @brief Decode an instruction into its handler, register indices 
+         *        and immediate.
+         * @param insn The instruction to decode.
+         * @param d Where to store the decoded instruction.
+         * ********************************************************************/
+        static void predecode(uint32_t insn, decoded_insn &d);
+
+        /**
+         * @brief Decode the instruction in memory at addr, expanding it 
+         *        first if it is a compressed instruction.
+         * @param addr The address of the instruction.
+         * @param d Where to store the decoded instruction.
+         * ********************************************************************/
+        void decode_at(uint32_t addr, decoded_insn &d) const;
+
+        /**
+         * @brief Find the handler that executes the given instruction.
+         * @tparam traced Whether the handler prints the instruction.
+         * @param insn The instruction.
+         * @return A pointer to the exec_* method for insn.
+         * ********************************************************************/
+        template<bool traced>
+        static exec_handler get_handler(uint32_t insn);
+
+        /**
+         * @brief Get the decoded form of the instruction at pc, decoding and
+         *        caching it first if needed.
+         * @return The decoded instruction.
+         * ********************************************************************/
+        const decoded_insn &fetch();
+
+        /**
+         * @brief Is the instruction at addr eligible for the decode cache?
+         * @param addr The address of the instruction.
+         * @return true if it is halfword-aligned and inside of memory.
+         * ********************************************************************/
+        bool is_cacheable(uint32_t addr) const;
+
+        /**
+         * @brief Get a page of the decode cache, allocating it if needed.
+         * @param page The page number (address / decode_page_size).
+         * @return The page.
+         * ********************************************************************/
+        decoded_page &get_decoded_page(uint32_t page);
+
+        /**
+         * @brief Decode the basic block that starts at pc and record its 
+         *        length in its first instruction.
+         * 
+         * A block ends at a jal, jalr, btype, system or illegal instruction,
+         * or at the end of the page.
+         * 
+         * @param page The decode cache page that holds pc.
+         * @param first The index of pc's slot within the page.
+         * ********************************************************************/
+        void discover_block(decoded_page &page, uint32_t first);
+
+        /**
+         * @brief Execute the first n instructions of a decoded block.
+         * @tparam observed Whether to record them for the observers.
+         * @tparam recorded Whether to write them to the recorder's trace.
+         * @param d The first instruction of the block.
+         * @param n The number of instructions to execute.
+         * @return The number executed, fewer than n if a store hit decoded 
+         *         code or the hart halted.
+         * ********************************************************************/
+        template<bool observed, bool recorded>
+        uint64_t run_block(const decoded_insn *d, uint64_t n);
+
+        /**
+         * @brief Record an instruction for the observers before it executes,
+         *        handing the buffer over first if it is full.
+         * @param d The decoded instruction at pc.
+         * @return Its record, complete but for next_pc.
+         * ********************************************************************/
+        retired_insn &record_retired(const decoded_insn &d);
+
+        /**
+         * @brief Does this instruction end a basic block?
+         * @param d The decoded instruction.
+         * @return true if it can change the control flow or halt the hart.
+         * ********************************************************************/
+        static bool ends_block(const decoded_insn &d);
+
+        /**
+         * @brief Discard the decoded instructions that a store overwrote any
+         *        byte of, and the lengths of the blocks that hold them.
+         * @param addr The address of the store.
+         * @param len The number of bytes stored.
+         * ********************************************************************/
+        void invalidate_decoded(uint32_t addr, uint32_t len);
+
         /**
          * @brief Execute the given RV32I instruction.
          * @param insn The instruction to execute.
@@ -108,215 +487,366 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         void exec(uint32_t insn, std::ostream* pos);
 
+        /**
+         * @brief Print the decoded instruction at pc, padded out to 
+         *        instruction_width.
+         * @param os The output stream.
+         * @param d The decoded instruction.
+         * ********************************************************************/
+        void print_decoded(std::ostream &os, const decoded_insn &d) const;
+
         /**
          * @brief Execute illegal instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_illegal_insn(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_illegal_insn(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute lui instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_lui(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_lui(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute auipc instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_auipc(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_auipc(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute jal instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_jal(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_jal(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute jalr instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_jalr(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_jalr(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute btype instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_btype(uint32_t insn, std::ostream *pos);
+        template<bool traced>
+        void exec_btype(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute load instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_load_imm(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_load_imm(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute stype instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_stype(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_stype(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute addi instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_addi(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_addi(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute slti instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_slti(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_slti(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute sltiu instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_sltiu(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_sltiu(const decoded_insn &d, std::ostream* pos);
         
         /**
          * @brief Execute xori instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_xori(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_xori(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute ori instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_ori(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_ori(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute andi instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_andi(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_andi(const decoded_insn &d, std::ostream* pos);
         
         /**
          * @brief Execute slli instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_slli(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_slli(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute srli instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_srli(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_srli(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute srai instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_srai(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_srai(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute add instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_add(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_add(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute sub instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_sub(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_sub(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute sll instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_sll(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_sll(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute slt instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_slt(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_slt(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute sltu instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_sltu(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_sltu(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute xor instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_xor(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_xor(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute srl instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_srl(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_srl(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute sra instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_sra(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_sra(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute or instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_or(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_or(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute and instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_and(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_and(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute mul instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_mul(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute mulh instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_mulh(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute mulhsu instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_mulhsu(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute mulhu instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_mulhu(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute div instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_div(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute divu instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_divu(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute rem instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_rem(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Execute remu instruction.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
+         * @param pos The output stream.
+         * ********************************************************************/
+        template<bool traced>
+        void exec_remu(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute csrrs instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_csrrs(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_csrrs(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute ebreak instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_ebreak(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_ebreak(const decoded_insn &d, std::ostream* pos);
 
         /**
          * @brief Execute ecall instruction.
-         * @param insn The instruction to execute.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded instruction to execute.
          * @param pos The output stream.
          * ********************************************************************/
-        void exec_ecall(uint32_t insn, std::ostream* pos);
+        template<bool traced>
+        void exec_ecall(const decoded_insn &d, std::ostream* pos);
+
+        /**
+         * @brief Finish an ecall that the syscall layer has carried out: 
+         *        print it, then set a0 or halt.
+         * @tparam traced Whether to print the instruction to pos.
+         * @param d The decoded ecall instruction.
+         * @param pos The output stream.
+         * @param r The system call and its outcome.
+         * ********************************************************************/
+        template<bool traced>
+        void finish_ecall(const decoded_insn &d, std::ostream* pos, const host_syscalls::request &r);
 
         /**
          * @brief Flag to stop the hart from executing instructions.
@@ -354,6 +884,77 @@ class rv32i_hart : public rv32i_decode
          * ********************************************************************/
         uint32_t mhartid = { 0 };
 
+        /**
+         * @brief The value reset() sets pc to.
+         * ********************************************************************/
+        uint32_t reset_pc = { 0 };
+
+        /**
+         * @brief Flag to indicate whether RV32C instructions are executed.
+         * ********************************************************************/
+        bool compressed = { false };
+
+        /**
+         * @brief Decoded instructions, one (lazily allocated) page per 
+         *        decode_page_size bytes of memory.
+         * ********************************************************************/
+        std::vector<std::unique_ptr<decoded_page>> decode_cache;
+
+        /**
+         * @brief Holds the decoded form of an instruction that can't be 
+         *        cached (misaligned or outside of memory).
+         * ********************************************************************/
+        decoded_insn fetch_scratch;
+
+        /**
+         * @brief Set when a store invalidates decoded instructions.
+         * ********************************************************************/
+        bool decode_flushed = { false };
+
+        /**
+         * @brief The JIT translating this hart's code, if any. It is told
+         *        about every decode cache page that gets invalidated.
+         * ********************************************************************/
+        rv32i_jit *attached_jit = { nullptr };
+
+        /**
+         * @brief The layer that carries out ecalls, if any.
+         * ********************************************************************/
+        host_syscalls *syscalls = { nullptr };
+
+        /**
+         * @brief Where executed instructions are recorded, if anywhere.
+         * ********************************************************************/
+        trace_writer *recorder = { nullptr };
+
+        /**
+         * @brief Where executed instructions are sent to be printed, if 
+         *        anywhere.
+         * ********************************************************************/
+        trace_printer *printer = { nullptr };
+
+        /**
+         * @brief The models told about each instruction executed.
+         * ********************************************************************/
+        std::vector<hart_observer*> observers;
+
+        /**
+         * @brief Number of instructions buffered for the observers between
+         *        batches.
+         * ********************************************************************/
+        static constexpr size_t retired_batch_size = 4096;
+
+        /**
+         * @brief The instructions not yet handed to the observers, allocated
+         *        when the first one is attached.
+         * ********************************************************************/
+        std::vector<retired_insn> retired_buf;
+
+        /**
+         * @brief Number of instructions in retired_buf.
+         * ********************************************************************/
+        size_t retired_count = { 0 };
+
     protected:
         /**
          * @brief The GP-regs
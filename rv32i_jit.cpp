@@ -0,0 +1,832 @@
+//******************************************************************************
+//
+// rv32i_jit.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstddef>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "rv32i_jit.h"
+#include "binary_trace.h"
+
+// x86 register numbers used by the code generator.
+static constexpr int x86_eax = 0;
+static constexpr int x86_ecx = 1;
+static constexpr int x86_edx = 2;
+
+// jit_state offsets as seen from rbp.
+static constexpr uint8_t off_insn_counter = 8;
+static constexpr uint8_t off_limit = 16;
+static constexpr uint8_t off_pc = 24;
+static constexpr uint8_t off_rec = 40;
+static constexpr uint8_t off_rec_end = 48;
+
+// Constructor. Attaches the JIT to the hart.
+rv32i_jit::rv32i_jit(rv32i_hart &h) : hart(h), recording(!h.observers.empty() || h.recorder), tracing(h.recorder != nullptr)
+{
+    static_assert(offsetof(jit_state, regs) == 0, "jit_state layout");
+    static_assert(offsetof(jit_state, insn_counter) == off_insn_counter, "jit_state layout");
+    static_assert(offsetof(jit_state, limit) == off_limit, "jit_state layout");
+    static_assert(offsetof(jit_state, pc) == off_pc, "jit_state layout");
+    static_assert(offsetof(jit_state, rec) == off_rec, "jit_state layout");
+    static_assert(offsetof(jit_state, rec_end) == off_rec_end, "jit_state layout");
+    static_assert(offsetof(retired_insn, len) == 16 && offsetof(retired_insn, rs2) == 19, "retired_insn layout");
+    static_assert(rv32i_hart::retired_batch_size >= max_block_insns, "a block's records must fit in the buffer");
+
+    state.regs = hart.regs.data();
+    state.jit = this;
+
+#if defined(__x86_64__)
+    void *p = mmap(nullptr, code_buf_size, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED)
+    {
+        code_buf = static_cast<uint8_t*>(p);
+        code_ptr = code_buf;
+        emit_trampoline();
+        code_start = code_ptr;
+    }
+#endif
+
+    flush();
+    hart.attached_jit = this;
+}
+
+// Destructor. Detaches the JIT from the hart.
+rv32i_jit::~rv32i_jit()
+{
+    hart.attached_jit = nullptr;
+
+    if (code_buf)
+    {
+        munmap(code_buf, code_buf_size);
+    }
+}
+
+// Run translated code starting at the hart's pc.
+bool rv32i_jit::run(uint64_t limit)
+{
+    uint32_t pc = hart.pc;
+
+    if (!is_enabled() || ((hart.show_instructions || hart.show_registers) && !hart.recorder) || recording != (!hart.observers.empty() || hart.recorder) || tracing != (hart.recorder != nullptr) || !hart.is_cacheable(pc))
+    {
+        return false;
+    }
+
+    jit_entry &e = get_entry(pc);
+    uint8_t *code = e.code;
+
+    if (!code)
+    {
+        if (e.count == untranslatable || pages[pc / rv32i_hart::decode_page_size]->blacklisted)
+        {
+            return false;
+        }
+
+        if (++e.count < hot_threshold)
+        {
+            return false;
+        }
+
+        code = translate(pc);
+
+        if (!code)
+        {
+            get_entry(pc).count = untranslatable;   // translate() may have flushed e
+            return false;
+        }
+    }
+
+    state.insn_counter = hart.insn_counter;
+    state.limit = limit;
+    state.pc = pc;
+
+    if (recording)
+    {
+        if (hart.retired_buf.size() - hart.retired_count < max_block_insns)
+        {
+            hart.flush_retired();
+        }
+
+        state.rec = hart.retired_buf.data() + hart.retired_count;
+        state.rec_end = hart.retired_buf.data() + hart.retired_buf.size();
+    }
+
+    reinterpret_cast<entry_fn>(code_buf)(&state, code);
+
+    bool progress = state.insn_counter != hart.insn_counter;
+    hart.pc = state.pc;
+    hart.insn_counter = state.insn_counter;
+
+    if (recording)
+    {
+        retired_insn *rec = hart.retired_buf.data() + hart.retired_count;
+
+        if (tracing)
+        {
+            hart.recorder->record(rec, state.rec - rec);
+        }
+        hart.retired_count = state.rec - hart.retired_buf.data();
+    }
+
+    return progress;
+}
+
+// Discard the translations a store overwrote.
+void rv32i_jit::invalidate(uint32_t addr, uint32_t len)
+{
+    // a store that straddles the top of the address space wraps to page 0
+    uint64_t end = uint64_t(addr) + len;
+
+    for (uint64_t a = addr / rv32i_hart::decode_slot * rv32i_hart::decode_slot; a < end; a += rv32i_hart::decode_slot)
+    {
+        uint32_t page = uint32_t(a) / rv32i_hart::decode_page_size;
+
+        if (page >= pages.size() || !pages[page])
+        {
+            a = (a / rv32i_hart::decode_page_size + 1) * rv32i_hart::decode_page_size - rv32i_hart::decode_slot;
+            continue;
+        }
+
+        if (pages[page]->covered[(uint32_t(a) % rv32i_hart::decode_page_size) / rv32i_hart::decode_slot])
+        {
+            invalidate_page(page);
+        }
+    }
+}
+
+// Discard all translations of a page of memory.
+void rv32i_jit::invalidate_page(uint32_t page)
+{
+    if (page >= pages.size() || !pages[page] || !pages[page]->translated)
+    {
+        return;
+    }
+
+    jit_page &p = *pages[page];
+
+    for (uint8_t *rel : p.incoming)
+    {
+        patch_exit(rel, nullptr);
+    }
+
+    p.incoming.clear();
+    p.entry.fill(jit_entry());
+    p.covered.reset();
+    p.translated = false;
+    p.blacklisted = true;
+}
+
+// Discard all translations.
+void rv32i_jit::flush()
+{
+    pages.clear();
+    pending.clear();
+    code_ptr = code_start;
+}
+
+// Get the translation state of the instruction at addr.
+rv32i_jit::jit_entry &rv32i_jit::get_entry(uint32_t addr)
+{
+    uint32_t page = addr / rv32i_hart::decode_page_size;
+
+    if (page >= pages.size())
+    {
+        pages.resize(page + 1);
+    }
+
+    std::unique_ptr<jit_page> &p = pages[page];
+
+    if (!p)
+    {
+        p.reset(new jit_page());
+    }
+
+    return p->entry[(addr % rv32i_hart::decode_page_size) / rv32i_hart::decode_slot];
+}
+
+// Translate the basic block starting at addr.
+uint8_t *rv32i_jit::translate(uint32_t addr)
+{
+    if (static_cast<size_t>(code_buf + code_buf_size - code_ptr) < max_block_code)
+    {
+        flush();
+        get_entry(addr);
+    }
+
+    uint32_t page = addr / rv32i_hart::decode_page_size;
+    rv32i_hart::decoded_page &dp = hart.get_decoded_page(page);
+    uint32_t first = (addr % rv32i_hart::decode_page_size) / rv32i_hart::decode_slot;
+    uint32_t last = first;
+    uint32_t prev = first;
+    uint32_t n = 1;
+
+    // find the end of the block, giving up on anything we can't translate
+    for (uint32_t a = addr; ; ++n)
+    {
+        rv32i_hart::decoded_insn &d = dp[last];
+
+        if (!d.handler)
+        {
+            hart.decode_at(a, d);
+        }
+
+        if (!is_translatable(d))
+        {
+            return nullptr;
+        }
+
+        uint32_t slots = d.len / rv32i_hart::decode_slot;
+
+        // an instruction that runs into the next page is left to the
+        // interpreter, so that each page's translations only cover its own bytes
+        if (last + slots > dp.size())
+        {
+            if (n == 1)
+            {
+                return nullptr;
+            }
+
+            --n;
+            last = prev;
+            break;
+        }
+
+        if (rv32i_hart::ends_block(d) || last + slots == dp.size() || a + d.len >= hart.mem.get_size())
+        {
+            break;
+        }
+
+        prev = last;
+        last += slots;
+        a += d.len;
+    }
+
+    uint8_t *block = code_ptr;
+
+    // take the block's records up front, bail out if they don't fit
+    uint8_t *full = nullptr;
+    if (recording)
+    {
+        emit_get_rec(x86_ecx);
+        emit8(0x48); emit8(0x81); emit8(0xc1); emit32(n * sizeof(retired_insn)); // add rcx,n*sizeof(retired_insn)
+        emit8(0x48); emit8(0x3b); emit8(0x4d); emit8(off_rec_end);      // cmp rcx,[rbp+rec_end]
+        full = emit_jcc(0x87);                                          // ja bail
+    }
+
+    // charge the whole block up front, bail out if it would pass the limit
+    emit8(0x48); emit8(0x8b); emit8(0x45); emit8(off_insn_counter);     // mov rax,[rbp+insn_counter]
+    emit8(0x48); emit8(0x05); emit32(n);                                // add rax,n
+    emit8(0x48); emit8(0x3b); emit8(0x45); emit8(off_limit);            // cmp rax,[rbp+limit]
+    uint8_t *bail = emit_jcc(0x87);                                     // ja bail
+    emit8(0x48); emit8(0x89); emit8(0x45); emit8(off_insn_counter);     // mov [rbp+insn_counter],rax
+
+    uint32_t a = addr;
+    uint32_t remaining = n;
+
+    if (recording)
+    {
+        emit8(0x48); emit8(0x89); emit8(0x4d); emit8(off_rec);          // mov [rbp+rec],rcx
+
+        for (uint32_t i = first; ; i += dp[i].len / rv32i_hart::decode_slot)
+        {
+            emit_record(dp[i], a, --remaining);
+            a += dp[i].len;
+
+            if (i == last) { break; }
+        }
+
+        a = addr;
+        remaining = n;
+    }
+
+    for (uint32_t i = first; ; i += dp[i].len / rv32i_hart::decode_slot)
+    {
+        emit_insn(dp[i], a, --remaining);
+        a += dp[i].len;
+
+        if (i == last) { break; }
+    }
+
+    if (!rv32i_hart::ends_block(dp[last]))
+    {
+        emit_exit(a);               // fell off the end of the page
+    }
+
+    bind(bail, code_ptr);
+    if (full)
+    {
+        bind(full, code_ptr);
+    }
+    emit_set_pc(addr);
+    emit_jmp(exit_code);
+
+    jit_page &jp = *pages[page];
+    jp.entry[first].code = block;
+    jp.translated = true;
+
+    for (uint32_t i = first; i < last + dp[last].len / rv32i_hart::decode_slot; ++i)
+    {
+        jp.covered[i] = true;
+    }
+
+    // chain the exits that were waiting for this block
+    auto range = pending.equal_range(addr);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        patch_exit(it->second, block);
+        jp.incoming.push_back(it->second);
+    }
+    pending.erase(range.first, range.second);
+
+    return block;
+}
+
+// Can this instruction be translated?
+bool rv32i_jit::is_translatable(const rv32i_hart::decoded_insn &d)
+{
+    uint32_t funct3 = rv32i_hart::get_funct3(d.insn);
+
+    if (d.handler == &rv32i_hart::exec_illegal_insn<false>)
+    {
+        return false;
+    }
+
+    switch (rv32i_hart::get_opcode(d.insn))
+    {
+        default:                                return false;
+        case rv32i_hart::opcode_lui:
+        case rv32i_hart::opcode_auipc:
+        case rv32i_hart::opcode_jal:
+        case rv32i_hart::opcode_jalr:
+        case rv32i_hart::opcode_alu_imm:
+        case rv32i_hart::opcode_rtype:          return true;
+        case rv32i_hart::opcode_btype:          return funct3 != 0b010 && funct3 != 0b011;
+        case rv32i_hart::opcode_load_imm:       return funct3 != 0b011 && funct3 < 0b110;
+        case rv32i_hart::opcode_stype:          return funct3 <= rv32i_hart::funct3_sw;
+    }
+}
+
+// Generate the code for one instruction.
+void rv32i_jit::emit_insn(const rv32i_hart::decoded_insn &d, uint32_t addr, uint32_t remaining)
+{
+    uint32_t funct3 = rv32i_hart::get_funct3(d.insn);
+    bool alt = d.insn & 0x40000000;   // sub/sra
+
+    switch (rv32i_hart::get_opcode(d.insn))
+    {
+        case rv32i_hart::opcode_lui:
+        case rv32i_hart::opcode_auipc:
+            if (d.rd)
+            {
+                uint32_t val = d.imm;
+                if (rv32i_hart::get_opcode(d.insn) == rv32i_hart::opcode_auipc)
+                {
+                    val += addr;
+                }
+                emit8(0xb8); emit32(val);                               // mov eax,val
+                emit_put(x86_eax, d.rd);
+            }
+            break;
+
+        case rv32i_hart::opcode_jal:
+            if (d.rd)
+            {
+                emit8(0xb8); emit32(addr + d.len);                      // mov eax,addr+len
+                emit_put(x86_eax, d.rd);
+            }
+            emit_exit(addr + d.imm);
+            break;
+
+        case rv32i_hart::opcode_jalr:
+            emit_get(x86_eax, d.rs1);
+            emit8(0x05); emit32(d.imm);                                 // add eax,imm
+            emit8(0x25); emit32(0xfffffffe);                            // and eax,0xfffffffe
+            if (recording)
+            {
+                emit_get_rec(x86_edx);
+                emit_rec_put(x86_eax, x86_edx, remaining, offsetof(retired_insn, next_pc));
+            }
+            if (d.rd)
+            {
+                emit8(0xb9); emit32(addr + d.len);                      // mov ecx,addr+len
+                emit_put(x86_ecx, d.rd);
+            }
+            emit8(0x89); emit8(0x45); emit8(off_pc);                    // mov [rbp+pc],eax
+            emit_jmp(exit_code);
+            break;
+
+        case rv32i_hart::opcode_btype:
+            {
+                static const uint8_t cc[] = { 0x84, 0x85, 0, 0, 0x8c, 0x8d, 0x82, 0x83 };
+                emit_get(x86_eax, d.rs1);
+                emit_get(x86_ecx, d.rs2);
+                emit8(0x39); emit8(0xc8);                               // cmp eax,ecx
+                uint8_t *taken = emit_jcc(cc[funct3]);
+                emit_exit(addr + d.len);
+                bind(taken, code_ptr);
+                if (recording)
+                {
+                    emit_get_rec(x86_ecx);
+                    emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, next_pc), addr + d.imm);
+                }
+                emit_exit(addr + d.imm);
+            }
+            break;
+
+        case rv32i_hart::opcode_load_imm:
+            emit_get(x86_eax, d.rs1);
+            emit8(0x05); emit32(d.imm);                                 // add eax,imm
+            if (recording)
+            {
+                emit_get_rec(x86_ecx);
+                emit_rec_put(x86_eax, x86_ecx, remaining, offsetof(retired_insn, addr));
+            }
+            emit8(0x89); emit8(0xc6);                                   // mov esi,eax
+            emit8(0xba); emit32(funct3);                                // mov edx,funct3
+            emit8(0x48); emit8(0x89); emit8(0xef);                      // mov rdi,rbp
+            emit8(0x48); emit8(0xb8); emit64(reinterpret_cast<uint64_t>(&load)); // mov rax,load
+            emit8(0xff); emit8(0xd0);                                   // call rax
+            if (tracing)
+            {
+                emit_get(x86_edx, d.rd);
+                emit8(0x89); emit8(0xc1);                               // mov ecx,eax
+                emit8(0x29); emit8(0xd1);                               // sub ecx,edx
+                emit_get_rec(x86_edx);
+                emit_rec_put(x86_ecx, x86_edx, remaining, offsetof(retired_insn, value));
+            }
+            emit_put(x86_eax, d.rd);
+            break;
+
+        case rv32i_hart::opcode_stype:
+            {
+                emit_get(x86_eax, d.rs1);
+                emit8(0x05); emit32(d.imm);                             // add eax,imm
+                if (recording)
+                {
+                    emit_get_rec(x86_ecx);
+                    emit_rec_put(x86_eax, x86_ecx, remaining, offsetof(retired_insn, addr));
+                }
+                emit8(0x89); emit8(0xc6);                               // mov esi,eax
+                emit_get(x86_edx, d.rs2);
+                emit8(0xb9); emit32(funct3);                            // mov ecx,funct3
+                emit8(0x48); emit8(0x89); emit8(0xef);                  // mov rdi,rbp
+                emit8(0x48); emit8(0xb8); emit64(reinterpret_cast<uint64_t>(&store)); // mov rax,store
+                emit8(0xff); emit8(0xd0);                               // call rax
+                emit8(0x85); emit8(0xc0);                               // test eax,eax
+                uint8_t *cont = emit_jcc(0x84);                         // jz cont
+
+                // the store hit decoded code, leave before running any more of it
+                emit8(0x48); emit8(0x81); emit8(0x6d); emit8(off_insn_counter); emit32(remaining); // sub qword [rbp+insn_counter],remaining
+                emit_unrecord(remaining);
+                emit_set_pc(addr + d.len);
+                emit_jmp(exit_code);
+                bind(cont, code_ptr);
+            }
+            break;
+
+        case rv32i_hart::opcode_alu_imm:
+            if (!d.rd) { break; }
+            emit_get(x86_eax, d.rs1);
+            switch (funct3)
+            {
+                case rv32i_hart::funct3_add:    emit8(0x05); emit32(d.imm); break;                  // add eax,imm
+                case rv32i_hart::funct3_xor:    emit8(0x35); emit32(d.imm); break;                  // xor eax,imm
+                case rv32i_hart::funct3_or:     emit8(0x0d); emit32(d.imm); break;                  // or eax,imm
+                case rv32i_hart::funct3_and:    emit8(0x25); emit32(d.imm); break;                  // and eax,imm
+                case rv32i_hart::funct3_sll:    emit8(0xc1); emit8(0xe0); emit8(d.imm & 0x1f); break; // shl eax,shamt
+                case rv32i_hart::funct3_srx:    emit8(0xc1); emit8(alt ? 0xf8 : 0xe8); emit8(d.imm & 0x1f); break; // sar/shr eax,shamt
+                case rv32i_hart::funct3_slt:
+                case rv32i_hart::funct3_sltu:
+                    emit8(0x3d); emit32(d.imm);                                                     // cmp eax,imm
+                    emit8(0x0f); emit8(funct3 == rv32i_hart::funct3_slt ? 0x9c : 0x92); emit8(0xc0); // setl/setb al
+                    emit8(0x0f); emit8(0xb6); emit8(0xc0);                                          // movzx eax,al
+                    break;
+            }
+            emit_put(x86_eax, d.rd);
+            break;
+
+        case rv32i_hart::opcode_rtype:
+            if (!d.rd) { break; }
+            emit_get(x86_eax, d.rs1);
+            emit_get(x86_ecx, d.rs2);
+            if (rv32i_hart::get_funct7(d.insn) == rv32i_hart::funct7_muldiv)
+            {
+                emit_muldiv(funct3);
+                emit_put(x86_eax, d.rd);
+                break;
+            }
+            switch (funct3)
+            {
+                case rv32i_hart::funct3_add:    emit8(alt ? 0x29 : 0x01); emit8(0xc8); break;       // sub/add eax,ecx
+                case rv32i_hart::funct3_xor:    emit8(0x31); emit8(0xc8); break;                    // xor eax,ecx
+                case rv32i_hart::funct3_or:     emit8(0x09); emit8(0xc8); break;                    // or eax,ecx
+                case rv32i_hart::funct3_and:    emit8(0x21); emit8(0xc8); break;                    // and eax,ecx
+                case rv32i_hart::funct3_sll:    emit8(0xd3); emit8(0xe0); break;                    // shl eax,cl
+                case rv32i_hart::funct3_srx:    emit8(0xd3); emit8(alt ? 0xf8 : 0xe8); break;       // sar/shr eax,cl
+                case rv32i_hart::funct3_slt:
+                case rv32i_hart::funct3_sltu:
+                    emit8(0x39); emit8(0xc8);                                                       // cmp eax,ecx
+                    emit8(0x0f); emit8(funct3 == rv32i_hart::funct3_slt ? 0x9c : 0x92); emit8(0xc0); // setl/setb al
+                    emit8(0x0f); emit8(0xb6); emit8(0xc0);                                          // movzx eax,al
+                    break;
+            }
+            emit_put(x86_eax, d.rd);
+            break;
+    }
+}
+
+// Generate the stores of the fields of an instruction's record known now.
+void rv32i_jit::emit_record(const rv32i_hart::decoded_insn &d, uint32_t addr, uint32_t remaining)
+{
+    uint32_t next_pc = rv32i_hart::get_opcode(d.insn) == rv32i_hart::opcode_jal ? addr + d.imm : addr + d.len;
+
+    // rcx points just past the block's records
+    emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, pc), addr);
+    emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, insn), d.insn);
+    emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, len), d.len | d.rd << 8 | d.rs1 << 16 | d.rs2 << 24);
+
+    if (tracing && d.len == 2)
+    {
+        emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, raw), hart.mem.get16(addr));
+    }
+
+    if (rv32i_hart::get_opcode(d.insn) != rv32i_hart::opcode_jalr)
+    {
+        emit_rec_set(x86_ecx, remaining, offsetof(retired_insn, next_pc), next_pc);
+    }
+}
+
+// Generate the code for an RV32M instruction.
+void rv32i_jit::emit_muldiv(uint32_t funct3)
+{
+    bool is_signed = funct3 == rv32i_hart::funct3_div || funct3 == rv32i_hart::funct3_rem;
+    bool is_rem = funct3 == rv32i_hart::funct3_rem || funct3 == rv32i_hart::funct3_remu;
+
+    switch (funct3)
+    {
+        case rv32i_hart::funct3_mul:
+            emit8(0x0f); emit8(0xaf); emit8(0xc1);                          // imul eax,ecx
+            return;
+
+        case rv32i_hart::funct3_mulh:
+        case rv32i_hart::funct3_mulhsu:
+        case rv32i_hart::funct3_mulhu:
+            if (funct3 == rv32i_hart::funct3_mulhu)
+            {
+                emit8(0x89); emit8(0xc0);                                   // mov eax,eax
+            }
+            else
+            {
+                emit8(0x48); emit8(0x63); emit8(0xc0);                      // movsxd rax,eax
+            }
+            if (funct3 == rv32i_hart::funct3_mulh)
+            {
+                emit8(0x48); emit8(0x63); emit8(0xc9);                      // movsxd rcx,ecx
+            }
+            else
+            {
+                emit8(0x89); emit8(0xc9);                                   // mov ecx,ecx
+            }
+            emit8(0x48); emit8(0x0f); emit8(0xaf); emit8(0xc1);             // imul rax,rcx
+            emit8(0x48); emit8(0xc1); emit8(0xe8); emit8(32);               // shr rax,32
+            return;
+    }
+
+    // div, divu, rem, remu: x86 faults on division by zero and overflow,
+    // which RISC-V defines results for
+    emit8(0x85); emit8(0xc9);                                               // test ecx,ecx
+    uint8_t *zero = emit_jcc(0x84);                                         // jz zero
+    uint8_t *overflow = nullptr;
+    if (is_signed)
+    {
+        emit8(0x83); emit8(0xf9); emit8(0xff);                              // cmp ecx,-1
+        uint8_t *normal = emit_jcc(0x85);                                   // jne normal
+        emit8(0x3d); emit32(0x80000000);                                    // cmp eax,INT32_MIN
+        overflow = emit_jcc(0x84);                                          // je overflow
+        bind(normal, code_ptr);
+        emit8(0x99);                                                        // cdq
+        emit8(0xf7); emit8(0xf9);                                           // idiv ecx
+    }
+    else
+    {
+        emit8(0x31); emit8(0xd2);                                           // xor edx,edx
+        emit8(0xf7); emit8(0xf1);                                           // div ecx
+    }
+    if (is_rem)
+    {
+        emit8(0x89); emit8(0xd0);                                           // mov eax,edx
+    }
+    emit8(0xe9); uint8_t *done = code_ptr; emit32(0);                       // jmp done
+
+    // by zero: quotient is all ones, remainder is the dividend
+    bind(zero, code_ptr);
+    if (!is_rem)
+    {
+        emit8(0xb8); emit32(0xffffffff);                                    // mov eax,-1
+    }
+    if (overflow)
+    {
+        // overflow: quotient is the dividend, remainder is 0
+        emit8(0xe9); uint8_t *skip = code_ptr; emit32(0);                   // jmp done
+        bind(overflow, code_ptr);
+        if (is_rem)
+        {
+            emit8(0x31); emit8(0xc0);                                       // xor eax,eax
+        }
+        bind(skip, code_ptr);
+    }
+    bind(done, code_ptr);
+}
+
+// Generate a chainable exit to a known guest address.
+void rv32i_jit::emit_exit(uint32_t target)
+{
+    emit8(0xe9);                                                        // jmp rel32, initially to the next insn
+    uint8_t *rel = code_ptr;
+    emit32(0);
+    emit_set_pc(target);
+    emit_jmp(exit_code);
+
+    if (!hart.is_cacheable(target))
+    {
+        return;
+    }
+
+    uint32_t page = target / rv32i_hart::decode_page_size;
+    jit_page *p = page < pages.size() ? pages[page].get() : nullptr;
+    uint8_t *dest = p ? p->entry[(target % rv32i_hart::decode_page_size) / rv32i_hart::decode_slot].code : nullptr;
+
+    if (dest)
+    {
+        patch_exit(rel, dest);
+        p->incoming.push_back(rel);
+    }
+    else pending.emplace(target, rel);
+}
+
+// Point a chainable exit at native code.
+void rv32i_jit::patch_exit(uint8_t *rel, uint8_t *dest)
+{
+    bind(rel, dest ? dest : rel + 4);
+}
+
+// Generate the entry trampoline and the common exit code.
+void rv32i_jit::emit_trampoline()
+{
+    emit8(0x53);                                                        // push rbx
+    emit8(0x55);                                                        // push rbp
+    emit8(0x48); emit8(0x83); emit8(0xec); emit8(0x08);                 // sub rsp,8
+    emit8(0x48); emit8(0x89); emit8(0xfd);                              // mov rbp,rdi
+    emit8(0x48); emit8(0x8b); emit8(0x5d); emit8(0x00);                 // mov rbx,[rbp+regs]
+    emit8(0xff); emit8(0xe6);                                           // jmp rsi
+
+    exit_code = code_ptr;
+    emit8(0x48); emit8(0x83); emit8(0xc4); emit8(0x08);                 // add rsp,8
+    emit8(0x5d);                                                        // pop rbp
+    emit8(0x5b);                                                        // pop rbx
+    emit8(0xc3);                                                        // ret
+}
+
+// Emit a byte.
+void rv32i_jit::emit8(uint8_t b)
+{
+    *code_ptr++ = b;
+}
+
+// Emit a little-endian dword.
+void rv32i_jit::emit32(uint32_t w)
+{
+    std::memcpy(code_ptr, &w, sizeof(w));
+    code_ptr += sizeof(w);
+}
+
+// Emit a little-endian qword.
+void rv32i_jit::emit64(uint64_t w)
+{
+    std::memcpy(code_ptr, &w, sizeof(w));
+    code_ptr += sizeof(w);
+}
+
+// Load guest register r into x86 register x86.
+void rv32i_jit::emit_get(int x86, uint32_t r)
+{
+    if (r)
+    {
+        emit8(0x8b); emit8(0x43 | x86 << 3); emit8(r * 4);              // mov x86,[rbx+r*4]
+    }
+    else
+    {
+        emit8(0x31); emit8(0xc0 | x86 << 3 | x86);                      // xor x86,x86
+    }
+}
+
+// Store x86 register x86 into guest register r.
+void rv32i_jit::emit_put(int x86, uint32_t r)
+{
+    if (r)
+    {
+        emit8(0x89); emit8(0x43 | x86 << 3); emit8(r * 4);              // mov [rbx+r*4],x86
+    }
+}
+
+// Store a constant into jit_state::pc.
+void rv32i_jit::emit_set_pc(uint32_t pc)
+{
+    emit8(0xc7); emit8(0x45); emit8(off_pc); emit32(pc);                // mov dword [rbp+pc],pc
+}
+
+// Load jit_state::rec into x86 register x86.
+void rv32i_jit::emit_get_rec(int x86)
+{
+    emit8(0x48); emit8(0x8b); emit8(0x45 | x86 << 3); emit8(off_rec);  // mov x86,[rbp+rec]
+}
+
+// Store x86 register x86 into a field of a record.
+void rv32i_jit::emit_rec_put(int x86, int base, uint32_t remaining, size_t field)
+{
+    emit8(0x89); emit8(0x80 | x86 << 3 | base);                         // mov [base+disp32],x86
+    emit32(field - (remaining + 1) * sizeof(retired_insn));
+}
+
+// Store a constant into a field of a record.
+void rv32i_jit::emit_rec_set(int base, uint32_t remaining, size_t field, uint32_t val)
+{
+    emit8(0xc7); emit8(0x80 | base);                                    // mov dword [base+disp32],val
+    emit32(field - (remaining + 1) * sizeof(retired_insn));
+    emit32(val);
+}
+
+// Emit jmp rel32 to dest.
+void rv32i_jit::emit_jmp(uint8_t *dest)
+{
+    emit8(0xe9);
+    emit32(0);
+    bind(code_ptr - 4, dest);
+}
+
+// Give back the records of instructions a block will no longer run.
+void rv32i_jit::emit_unrecord(uint32_t remaining)
+{
+    if (recording)
+    {
+        emit8(0x48); emit8(0x81); emit8(0x6d); emit8(off_rec); emit32(remaining * sizeof(retired_insn)); // sub qword [rbp+rec],remaining*sizeof(retired_insn)
+    }
+}
+
+// Emit jcc rel32, returning its rel32 field.
+uint8_t *rv32i_jit::emit_jcc(uint8_t cc)
+{
+    emit8(0x0f); emit8(cc);
+    emit32(0);
+    return code_ptr - 4;
+}
+
+// Resolve a rel32 field to dest.
+void rv32i_jit::bind(uint8_t *rel, uint8_t *dest)
+{
+    int32_t disp = static_cast<int32_t>(dest - (rel + 4));
+    std::memcpy(rel, &disp, sizeof(disp));
+}
+
+// Load helper called by translated code.
+uint32_t rv32i_jit::load(jit_state *st, uint32_t addr, uint32_t funct3)
+{
+    memory &mem = st->jit->hart.mem;
+
+    switch (funct3)
+    {
+        default:
+        case rv32i_hart::funct3_lb:             return mem.get8_sx(addr);
+        case rv32i_hart::funct3_lh:             return mem.get16_sx(addr);
+        case rv32i_hart::funct3_lw:             return mem.get32_sx(addr);
+        case rv32i_hart::funct3_lbu:            return mem.get8(addr);
+        case rv32i_hart::funct3_lhu:            return mem.get16(addr);
+    }
+}
+
+// Store helper called by translated code.
+uint32_t rv32i_jit::store(jit_state *st, uint32_t addr, uint32_t val, uint32_t funct3)
+{
+    rv32i_hart &h = st->jit->hart;
+    uint32_t len;
+
+    switch (funct3)
+    {
+        default:
+        case rv32i_hart::funct3_sb:             h.mem.set8(addr, val & 0xff); len = 1; break;
+        case rv32i_hart::funct3_sh:             h.mem.set16(addr, val & 0xffff); len = 2; break;
+        case rv32i_hart::funct3_sw:             h.mem.set32(addr, val); len = 4; break;
+    }
+
+    h.decode_flushed = false;
+    h.invalidate_decoded(addr, len);
+    return h.decode_flushed;
+}
@@ -0,0 +1,330 @@
+#ifndef RV32I_JIT_H
+#define RV32I_JIT_H
+
+//******************************************************************************
+//
+// rv32i_jit.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <array>
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "rv32i_hart.h"
+
+/**
+ * @brief Class to translate hot RV32I basic blocks into x86-64 code.
+ *
+ * Each basic block's executions are counted, and once a block is hot it is
+ * translated into native code that works on the hart's registers in place.
+ * Translated blocks jump directly to each other where the target is known.
+ * Blocks holding system or illegal instructions, and pages whose translated
+ * instructions have been overwritten, are left to the interpreter.
+ *
+ * When the hart has observers or a recorder, each block also writes a
+ * record of every instruction it runs into the hart's retired_insn buffer.
+ * Those a recorder needs are written to its trace as run() returns.
+ * ****************************************************************************/
+class rv32i_jit
+{
+    public:
+        /**
+         * @brief Constructor. Attaches the JIT to the hart.
+         * @param h The hart whose instructions are translated.
+         * ********************************************************************/
+        rv32i_jit(rv32i_hart &h);
+
+        /**
+         * @brief Destructor. Detaches the JIT from the hart.
+         * ********************************************************************/
+        ~rv32i_jit();
+
+        /**
+         * @brief Is native code generation available on this host?
+         * @return true if running on x86-64 with an executable code buffer.
+         * ********************************************************************/
+        bool is_enabled() const { return code_buf != nullptr; }
+
+        /**
+         * @brief Run translated code starting at the hart's pc.
+         *
+         * Counts an execution of the block at pc and translates it when it
+         * becomes hot. Then runs native code until it reaches a block that
+         * isn't translated, or until running the next block would go past
+         * limit, or until the hart's record buffer can't take the next 
+         * block's records.
+         *
+         * @param limit The value insn_counter must not exceed.
+         * @return false if no instructions were executed, in which case the
+         *         caller should interpret the block at pc.
+         * ********************************************************************/
+        bool run(uint64_t limit);
+
+        /**
+         * @brief Told about a store that overwrote decoded instructions. If
+         *        it overwrote any translated ones, discards the translations
+         *        of their page(s) and leaves them to the interpreter from 
+         *        now on.
+         * @param addr The address of the store.
+         * @param len The number of bytes stored.
+         * ********************************************************************/
+        void invalidate(uint32_t addr, uint32_t len);
+
+        /**
+         * @brief Discard all translations.
+         * ********************************************************************/
+        void flush();
+
+    private:
+        /**
+         * @brief Discard all translations of a page of memory and leave the
+         *        page to the interpreter from now on.
+         * @param page The page number (address / rv32i_hart::decode_page_size).
+         * ********************************************************************/
+        void invalidate_page(uint32_t page);
+
+        /**
+         * @brief Number of executions after which a block is translated.
+         * ********************************************************************/
+        static constexpr uint32_t hot_threshold = 16;
+
+        /**
+         * @brief Size of the executable code buffer.
+         * ********************************************************************/
+        static constexpr size_t code_buf_size = 16 * 1024 * 1024;
+
+        /**
+         * @brief Most instructions a block can hold, one per decode slot of
+         *        a page.
+         * ********************************************************************/
+        static constexpr size_t max_block_insns = rv32i_hart::decode_page_size / rv32i_hart::decode_slot;
+
+        /**
+         * @brief Largest amount of code a single block may need.
+         * ********************************************************************/
+        static constexpr size_t max_block_code = 176 * max_block_insns + 256;
+
+        /**
+         * @brief Execution count of a block that can't be translated.
+         * ********************************************************************/
+        static constexpr uint32_t untranslatable = 0xffffffff;
+
+        /**
+         * @brief The hart state seen by translated code.
+         *
+         * Translated code addresses this through rbp. The guest registers
+         * are addressed directly through rbx.
+         * ********************************************************************/
+        struct jit_state
+        {
+            int32_t *regs;              ///< The hart's registerfile storage.
+            uint64_t insn_counter;      ///< The hart's insn_counter.
+            uint64_t limit;             ///< The value insn_counter must not exceed.
+            uint32_t pc;                ///< The guest pc when leaving native code.
+            rv32i_jit *jit;             ///< This, for the load/store helpers.
+            retired_insn *rec;          ///< The next free record, when recording.
+            retired_insn *rec_end;      ///< The end of the record buffer.
+        };
+
+        /**
+         * @brief Translation state of one guest instruction address.
+         * ********************************************************************/
+        struct jit_entry
+        {
+            uint8_t *code;              ///< The translated block starting here, or nullptr.
+            uint32_t count;             ///< Executions so far, or untranslatable.
+        };
+
+        /**
+         * @brief Translation state of one page of guest memory.
+         * ********************************************************************/
+        struct jit_page
+        {
+            std::array<jit_entry, rv32i_hart::decode_page_size / rv32i_hart::decode_slot> entry; ///< Per-instruction state.
+            std::bitset<rv32i_hart::decode_page_size / rv32i_hart::decode_slot> covered; ///< Slots holding bytes of translated instructions.
+            std::vector<uint8_t*> incoming; ///< Chained jumps into this page's blocks.
+            bool translated;            ///< Holds at least one translated block.
+            bool blacklisted;           ///< Had translated instructions overwritten.
+        };
+
+        /**
+         * @brief Signature of the generated entry trampoline.
+         * ********************************************************************/
+        using entry_fn = void (*)(jit_state *, uint8_t *);
+
+        /**
+         * @brief Get the translation state of the instruction at addr.
+         * @param addr A word-aligned address inside of memory.
+         * @return The entry.
+         * ********************************************************************/
+        jit_entry &get_entry(uint32_t addr);
+
+        /**
+         * @brief Translate the basic block starting at addr.
+         * @param addr The address of the block.
+         * @return The native code, or nullptr if it can't be translated.
+         * ********************************************************************/
+        uint8_t *translate(uint32_t addr);
+
+        /**
+         * @brief Can this instruction be translated?
+         * @param d The decoded instruction.
+         * @return true if translate() knows how to generate code for it.
+         * ********************************************************************/
+        static bool is_translatable(const rv32i_hart::decoded_insn &d);
+
+        /**
+         * @brief Generate the code for one instruction.
+         * @param d The decoded instruction.
+         * @param addr The address of the instruction.
+         * @param remaining The number of instructions after it in the block.
+         * ********************************************************************/
+        void emit_insn(const rv32i_hart::decoded_insn &d, uint32_t addr, uint32_t remaining);
+
+        /**
+         * @brief Generate the stores of the fields of an instruction's record
+         *        that are known when it is translated.
+         *
+         * next_pc is the fall-through, or the target of a jal. A taken 
+         * branch and a jalr store their own.
+         *
+         * @param d The decoded instruction.
+         * @param addr The address of the instruction.
+         * @param remaining The number of instructions after it in the block.
+         * ********************************************************************/
+        void emit_record(const rv32i_hart::decoded_insn &d, uint32_t addr, uint32_t remaining);
+
+        /**
+         * @brief Generate the code for an RV32M instruction, leaving the
+         *        result in eax.
+         * @param funct3 The funct3 field of the instruction, with its
+         *        operands already in eax and ecx.
+         * ********************************************************************/
+        void emit_muldiv(uint32_t funct3);
+
+        /**
+         * @brief Generate an exit to a known guest address that can later
+         *        be chained directly to the target's translation.
+         * @param target The guest address to continue at.
+         * ********************************************************************/
+        void emit_exit(uint32_t target);
+
+        /**
+         * @brief Generate code that gives back the records of instructions
+         *        a block will no longer run, when leaving it early.
+         * @param remaining The number of them.
+         * ********************************************************************/
+        void emit_unrecord(uint32_t remaining);
+
+        /**
+         * @brief Point a chainable exit at native code.
+         * @param rel The rel32 field of the exit's jmp.
+         * @param dest Where to jump to, or nullptr to unchain it.
+         * ********************************************************************/
+        static void patch_exit(uint8_t *rel, uint8_t *dest);
+
+        /**
+         * @brief Generate the entry trampoline and the common exit code.
+         * ********************************************************************/
+        void emit_trampoline();
+
+        void emit8(uint8_t b);                  ///< Emit a byte.
+        void emit32(uint32_t w);                ///< Emit a little-endian dword.
+        void emit64(uint64_t w);                ///< Emit a little-endian qword.
+        void emit_get(int x86, uint32_t r);     ///< Load guest register r into x86 register x86.
+        void emit_put(int x86, uint32_t r);     ///< Store x86 register x86 into guest register r.
+        void emit_set_pc(uint32_t pc);          ///< Store a constant into jit_state::pc.
+        void emit_get_rec(int x86);             ///< Load jit_state::rec into x86 register x86.
+        void emit_rec_put(int x86, int base, uint32_t remaining, size_t field); ///< Store x86 into a field of a record based at base.
+        void emit_rec_set(int base, uint32_t remaining, size_t field, uint32_t val); ///< Store a constant into a field of a record based at base.
+        void emit_jmp(uint8_t *dest);           ///< Emit jmp rel32 to dest.
+        uint8_t *emit_jcc(uint8_t cc);          ///< Emit jcc rel32, returning its rel32 field.
+        static void bind(uint8_t *rel, uint8_t *dest); ///< Resolve a rel32 field to dest.
+
+        /**
+         * @brief Load helper called by translated code.
+         * @param st The jit_state.
+         * @param addr The effective address.
+         * @param funct3 The funct3 field of the load.
+         * @return The loaded value, extended as the load requires.
+         * ********************************************************************/
+        static uint32_t load(jit_state *st, uint32_t addr, uint32_t funct3);
+
+        /**
+         * @brief Store helper called by translated code.
+         * @param st The jit_state.
+         * @param addr The effective address.
+         * @param val The value to store.
+         * @param funct3 The funct3 field of the store.
+         * @return Non-zero if the store invalidated any decoded code, in
+         *         which case the translated block must be left at once.
+         * ********************************************************************/
+        static uint32_t store(jit_state *st, uint32_t addr, uint32_t val, uint32_t funct3);
+
+        /**
+         * @brief The hart whose instructions are translated.
+         * ********************************************************************/
+        rv32i_hart &hart;
+
+        /**
+         * @brief Translation state, one (lazily allocated) page per
+         *        rv32i_hart::decode_page_size bytes of memory.
+         * ********************************************************************/
+        std::vector<std::unique_ptr<jit_page>> pages;
+
+        /**
+         * @brief Chainable exits whose target has not been translated yet,
+         *        keyed by target address.
+         * ********************************************************************/
+        std::unordered_multimap<uint32_t, uint8_t*> pending;
+
+        /**
+         * @brief Whether translated code records each instruction for the 
+         *        hart's observers or recorder. Set when the JIT is created.
+         * ********************************************************************/
+        const bool recording;
+
+        /**
+         * @brief Whether the records also carry what the recorder's trace
+         *        needs: the value of each load and the compressed 
+         *        instructions as they are in memory. Set when the JIT is 
+         *        created.
+         * ********************************************************************/
+        const bool tracing;
+
+        /**
+         * @brief The executable code buffer.
+         * ********************************************************************/
+        uint8_t *code_buf = { nullptr };
+
+        /**
+         * @brief The next free byte in code_buf.
+         * ********************************************************************/
+        uint8_t *code_ptr = { nullptr };
+
+        /**
+         * @brief Start of the first block in code_buf, after the trampoline.
+         * ********************************************************************/
+        uint8_t *code_start = { nullptr };
+
+        /**
+         * @brief The common exit code that returns to run().
+         * ********************************************************************/
+        uint8_t *exit_code = { nullptr };
+
+        /**
+         * @brief The state handed to translated code.
+         * ********************************************************************/
+        jit_state state;
+};
+
+#endif
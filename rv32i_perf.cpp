@@ -0,0 +1,461 @@
+//******************************************************************************
+//
+// rv32i_perf.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+/**
+ * @brief How the guest benchmarks are run and judged.
+ * ****************************************************************************/
+struct settings
+{
+	std::string simulator = { "./rv32i" };	///< The simulator to run.
+	std::string engine;				///< Passed to the simulator with -e, unless empty.
+	std::string baseline;			///< The baseline file, if any.
+	bool write = { false };			///< Write the baseline rather than compare against it.
+	int reps = { 3 };				///< Runs of each binary; the fastest is kept.
+	double threshold = { 25 };		///< The largest drop in MIPS, in percent, that passes.
+};
+
+/**
+ * @brief One guest benchmark from the manifest, and how it ran.
+ * ****************************************************************************/
+struct job
+{
+	std::string name;				///< The binary, as the manifest names it.
+	std::string binary;				///< The binary's path.
+	std::string mem_size;			///< Hex memory size, passed to -m.
+	std::string exec_limit;			///< Hex instruction limit, passed to -l.
+	std::string expected;			///< The file holding the expected output, if any.
+
+	std::string output;				///< What the simulator printed on its last run.
+	uint64_t instructions = { 0 };	///< Instructions executed.
+	double seconds = { 0 };			///< Wall time of the fastest run.
+	double cpu_seconds = { 0 };		///< User and system time of the fastest run.
+	long peak_rss_kb = { 0 };		///< The largest peak resident set size of any run.
+	std::string error;				///< Why the job failed, or empty.
+
+	double mips() const { return cpu_seconds > 0 ? instructions / cpu_seconds / 1e6 : 0; }
+};
+
+/**
+ * @brief A binary's entry in the baseline.
+ * ****************************************************************************/
+struct baseline_entry
+{
+	uint64_t instructions;			///< Instructions executed.
+	double mips;					///< Guest instructions per second, in millions.
+};
+
+/**
+ * @brief Prints error message if program is launched incorrectly.
+ * ****************************************************************************/
+static void usage()
+{
+	cerr << "Usage: rv32i_perf [-b baseline] [-e engine] [-n reps] [-s simulator] [-t percent] [-w] manifest" << endl;
+	cerr << "    -b baseline file to compare against, written instead if it doesn't exist or with -w" << endl;
+	cerr << "    -e execution engine passed to the simulator" << endl;
+	cerr << "    -n runs of each binary, the fastest is kept (default = 3)" << endl;
+	cerr << "    -s simulator to run (default = ./rv32i)" << endl;
+	cerr << "    -t fail if a binary's MIPS drops by more than this percent (default = 25)" << endl;
+	cerr << "    -w write the results to the baseline file instead of comparing" << endl;
+	cerr << "    manifest binaries to run, one per line: binary hex-mem-size hex-exec-limit [expected-output]" << endl;
+	exit(1);
+}
+
+/**
+ * @brief Reads the jobs from a manifest, in the format batch_runner uses.
+ * @param fname File name of the manifest.
+ * @param jobs Where to put the jobs.
+ * @return false if the manifest can't be read or has a bad line.
+ * ****************************************************************************/
+static bool load_manifest(const std::string &fname, std::vector<job> &jobs)
+{
+	std::ifstream infile(fname);
+
+	if (!infile)
+	{
+		cerr << "Can't open file '" << fname << "' for reading." << endl;
+		return false;
+	}
+
+	// file names in the manifest are relative to its directory
+	std::string dir = fname.substr(0, fname.find_last_of('/') + 1);
+	auto path = [&dir](const std::string &f) { return f.empty() || f[0] == '/' ? f : dir + f; };
+
+	std::string line;
+	for (int n = 1; std::getline(infile, line); ++n)
+	{
+		std::istringstream iss(line);
+		job j;
+
+		if (!(iss >> j.name) || j.name[0] == '#')
+			continue;
+
+		if (!(iss >> j.mem_size >> j.exec_limit))
+		{
+			cerr << fname << ":" << n << ": expected: binary hex-mem-size hex-exec-limit [expected-output]" << endl;
+			return false;
+		}
+
+		iss >> j.expected;
+		j.binary = path(j.name);
+		j.expected = path(j.expected);
+		jobs.push_back(j);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Reads a baseline file.
+ * @param fname File name of the baseline.
+ * @param baseline Where to put its entries, by binary.
+ * @return false if the file can't be read or has a bad line.
+ * ****************************************************************************/
+static bool load_baseline(const std::string &fname, std::map<std::string, baseline_entry> &baseline)
+{
+	std::ifstream infile(fname);
+
+	if (!infile)
+	{
+		cerr << "Can't open file '" << fname << "' for reading." << endl;
+		return false;
+	}
+
+	std::string line;
+	for (int n = 1; std::getline(infile, line); ++n)
+	{
+		std::istringstream iss(line);
+		std::string name;
+		baseline_entry e;
+
+		if (!(iss >> name) || name[0] == '#')
+			continue;
+
+		if (!(iss >> e.instructions >> e.mips))
+		{
+			cerr << fname << ":" << n << ": expected: binary instructions mips" << endl;
+			return false;
+		}
+		baseline[name] = e;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Runs the simulator on a job once, untraced, and times it.
+ * @param s How to run it.
+ * @param j The job. Its output, instruction count, fastest time and peak
+ *        RSS are updated, or its error set.
+ * ****************************************************************************/
+static void run_once(const settings &s, job &j)
+{
+	std::vector<std::string> args = { s.simulator, "-m", j.mem_size, "-l", j.exec_limit };
+	if (!s.engine.empty())
+	{
+		args.push_back("-e");
+		args.push_back(s.engine);
+	}
+	args.push_back(j.binary);
+
+	std::vector<char *> argv;
+	for (std::string &a : args)
+		argv.push_back(&a[0]);
+	argv.push_back(nullptr);
+
+	int fds[2];
+	if (pipe(fds) == -1)
+	{
+		j.error = "pipe failed";
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		j.error = "fork failed";
+		return;
+	}
+
+	if (pid == 0)
+	{
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+
+	close(fds[1]);
+
+	std::string output;
+	char buf[4096];
+	ssize_t len;
+	while ((len = read(fds[0], buf, sizeof(buf))) > 0)
+		output.append(buf, len);
+	close(fds[0]);
+
+	// wait4 is the only way to get the child's own peak RSS, not ours
+	int status;
+	struct rusage ru;
+	if (wait4(pid, &status, 0, &ru) == -1)
+	{
+		j.error = "wait4 failed";
+		return;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (WIFSIGNALED(status))
+	{
+		j.error = "killed by signal " + std::to_string(WTERMSIG(status));
+		return;
+	}
+	if (WEXITSTATUS(status) == 127)
+	{
+		j.error = "can't run " + s.simulator;
+		return;
+	}
+	if (WEXITSTATUS(status) != 0)
+	{
+		j.error = "exit status " + std::to_string(WEXITSTATUS(status));
+		return;
+	}
+
+	// the count is the last line the simulator prints
+	const std::string suffix = " instructions executed";
+	size_t end = output.rfind(suffix);
+	size_t begin = output.rfind('\n', end == std::string::npos ? 0 : end);
+	begin = begin == std::string::npos || end == std::string::npos ? 0 : begin + 1;
+
+	std::istringstream iss(end == std::string::npos ? "" : output.substr(begin, end - begin));
+	uint64_t instructions;
+	if (!(iss >> instructions))
+	{
+		j.error = "no instruction count";
+		return;
+	}
+
+	// MIPS comes from CPU time, which other load on the host disturbs far less than wall time
+	double cpu_seconds = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+	if (j.cpu_seconds == 0 || cpu_seconds < j.cpu_seconds)
+	{
+		j.seconds = seconds;
+		j.cpu_seconds = cpu_seconds;
+	}
+	if (ru.ru_maxrss > j.peak_rss_kb)
+		j.peak_rss_kb = ru.ru_maxrss;		// kilobytes on Linux
+	j.instructions = instructions;
+	j.output = output;
+}
+
+/**
+ * @brief Checks a job's output against its expected output, if it has one.
+ * @param j The job. Its error is set if they differ.
+ * ****************************************************************************/
+static void check_output(job &j)
+{
+	if (j.expected.empty() || !j.error.empty())
+		return;
+
+	std::ifstream infile(j.expected);
+	if (!infile)
+	{
+		j.error = "can't read " + j.expected;
+		return;
+	}
+
+	std::ostringstream expected;
+	expected << infile.rdbuf();
+	if (expected.str() != j.output)
+		j.error = "output differs from " + j.expected;
+}
+
+/**
+ * @brief Writes the results as a new baseline.
+ * @param fname File name of the baseline.
+ * @param jobs The jobs, all of which ran.
+ * @return false if the file can't be written.
+ * ****************************************************************************/
+static bool write_baseline(const std::string &fname, const std::vector<job> &jobs)
+{
+	std::ofstream outfile(fname);
+
+	if (!outfile)
+	{
+		cerr << "Can't open file '" << fname << "' for writing." << endl;
+		return false;
+	}
+
+	outfile << "# binary instructions mips" << endl;
+	for (const job &j : jobs)
+		outfile << j.name << " " << j.instructions << " " << std::fixed << std::setprecision(2) << j.mips() << endl;
+
+	return bool(outfile);
+}
+
+/**
+ * @brief Runs the guest benchmarks in a manifest through the simulator and
+ *        reports their speed, comparing it against a baseline.
+ * @param argc Number of command line arguments.
+ * @param argv The command line arguments.
+ * @return 0 if every binary ran and none got slower than the threshold
+ *         allows, 1 otherwise.
+ * ****************************************************************************/
+int main(int argc, char **argv)
+{
+	settings s;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "b:e:n:s:t:w")) != -1)
+	{
+		switch (opt)
+		{
+			case 'b':
+				s.baseline = optarg;
+				break;
+
+			case 'e':
+				s.engine = optarg;
+				break;
+
+			case 'n':
+				s.reps = atoi(optarg);
+				if (s.reps < 1)
+					usage();
+				break;
+
+			case 's':
+				s.simulator = optarg;
+				break;
+
+			case 't':
+				s.threshold = atof(optarg);
+				if (!(s.threshold >= 0))
+					usage();
+				break;
+
+			case 'w':
+				s.write = true;
+				break;
+
+			default:
+				usage();
+		}
+	}
+
+	if (optind != argc - 1 || (s.write && s.baseline.empty()))
+		usage();
+
+	std::vector<job> jobs;
+	if (!load_manifest(argv[optind], jobs))
+		return 1;
+
+	// MIPS only compare on the host that measured them, so a missing
+	// baseline is recorded here rather than shipped
+	if (!s.baseline.empty() && !s.write && !std::ifstream(s.baseline))
+	{
+		cout << "No baseline in '" << s.baseline << "' yet, recording one." << endl;
+		s.write = true;
+	}
+
+	std::map<std::string, baseline_entry> baseline;
+	if (!s.write && !s.baseline.empty() && !load_baseline(s.baseline, baseline))
+		return 1;
+
+	cout << std::left << std::setw(18) << "binary" << std::right << std::setw(14) << "instructions"
+		 << std::setw(10) << "wall (s)" << std::setw(9) << "cpu (s)" << std::setw(10) << "MIPS" << std::setw(16) << "peak RSS (KiB)"
+		 << std::setw(10) << "baseline" << std::setw(9) << "change" << "  result" << endl;
+
+	bool ok = true;
+	for (job &j : jobs)
+	{
+		for (int i = 0; i < s.reps && j.error.empty(); ++i)
+			run_once(s, j);
+		check_output(j);
+
+		cout << std::left << std::setw(18) << j.name << std::right;
+		if (!j.error.empty())
+		{
+			cout << "  FAIL: " << j.error << endl;
+			ok = false;
+			continue;
+		}
+
+		cout << std::setw(14) << j.instructions << std::fixed << std::setprecision(3) << std::setw(10) << j.seconds
+			 << std::setw(9) << j.cpu_seconds
+			 << std::setprecision(2) << std::setw(10) << j.mips() << std::setw(16) << j.peak_rss_kb;
+
+		auto b = baseline.find(j.name);
+		if (b == baseline.end())
+		{
+			cout << std::setw(10) << "-" << std::setw(9) << "-" << "  " << (s.baseline.empty() || s.write ? "ok" : "new") << endl;
+			continue;
+		}
+
+		double change = b->second.mips > 0 ? 100 * (j.mips() - b->second.mips) / b->second.mips : 0;
+		std::ostringstream pct;
+		pct << std::showpos << std::fixed << std::setprecision(1) << change << "%";
+		cout << std::setw(10) << b->second.mips << std::setw(9) << pct.str();
+
+		// a different count means the binary or the simulator's semantics changed, so the speeds don't compare
+		if (j.instructions != b->second.instructions)
+		{
+			cout << "  FAIL: " << b->second.instructions << " instructions in the baseline" << endl;
+			ok = false;
+		}
+		else if (change < -s.threshold)
+		{
+			cout << "  FAIL: slower than " << std::defaultfloat << s.threshold << "% allows" << endl;
+			ok = false;
+		}
+		else
+		{
+			cout << "  ok" << endl;
+		}
+	}
+
+	if (s.write)
+	{
+		if (!ok)
+		{
+			cerr << "Not writing '" << s.baseline << "', as some binaries failed." << endl;
+			return 1;
+		}
+		if (!write_baseline(s.baseline, jobs))
+			return 1;
+		cout << "Wrote " << s.baseline << endl;
+	}
+
+	return ok ? 0 : 1;
+}
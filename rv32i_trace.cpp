@@ -0,0 +1,66 @@
+//******************************************************************************
+//
+// rv32i_trace.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <unistd.h>
+
+#include "binary_trace.h"
+
+using std::cerr;
+using std::endl;
+
+/**
+ * @brief Prints error message if program is launched incorrectly.
+ * ****************************************************************************/
+static void usage()
+{
+	cerr << "Usage: rv32i_trace [-i] [-r] tracefile" << endl;
+	cerr << "    -i show instruction printing, as rv32i -i would have" << endl;
+	cerr << "    -r show register printing, as rv32i -r would have" << endl;
+	exit(1);
+}
+
+/**
+ * @brief Prints a trace recorded by rv32i -t.
+ * ****************************************************************************/
+int main(int argc, char **argv)
+{
+	bool show_instructions = false;
+	bool show_registers = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "ir")) != -1)
+	{
+		switch(opt)
+		{
+			case 'i':
+				show_instructions = true;
+				break;
+
+			case 'r':
+				show_registers = true;
+				break;
+
+			default:
+				usage();
+		}
+	}
+
+	if (optind != argc - 1)
+		usage();
+
+	trace_reader trace;
+
+	if (!trace.open(argv[optind]))
+		return 1;
+
+	return trace.replay(std::cout, show_instructions, show_registers) < 0 ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+//******************************************************************************
+//
+// symbol_table.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <algorithm>
+
+#include "symbol_table.h"
+
+// Adds a symbol.
+void symbol_table::add(uint32_t addr, uint32_t size, const std::string &name)
+{
+    symbols.push_back({ addr, size, name });
+}
+
+// Sorts the symbols by address, sized symbols before unsized ones at the
+// same address so that they're preferred by lookup().
+void symbol_table::sort()
+{
+    std::stable_sort(symbols.begin(), symbols.end(),
+        [](const symbol &a, const symbol &b) { return a.addr < b.addr || (a.addr == b.addr && a.size > b.size); });
+}
+
+// Finds the symbol that addr falls in.
+const symbol_table::symbol *symbol_table::lookup(uint32_t addr) const
+{
+    // the last symbol starting at or below addr
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+        [](uint32_t a, const symbol &s) { return a < s.addr; });
+
+    if (it == symbols.begin())
+    {
+        return nullptr;
+    }
+
+    uint32_t start = (--it)->addr;
+
+    // back up to the first (preferred) symbol at that address
+    while (it != symbols.begin() && (it - 1)->addr == start)
+    {
+        --it;
+    }
+
+    if (it->size && addr - it->addr >= it->size)
+    {
+        return nullptr;
+    }
+
+    return &*it;
+}
+
+// Finds the symbol that starts exactly at addr.
+const symbol_table::symbol *symbol_table::at(uint32_t addr) const
+{
+    auto it = std::lower_bound(symbols.begin(), symbols.end(), addr,
+        [](const symbol &s, uint32_t a) { return s.addr < a; });
+
+    return it != symbols.end() && it->addr == addr ? &*it : nullptr;
+}
@@ -0,0 +1,80 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+//******************************************************************************
+//
+// symbol_table.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Class to map addresses to the symbols of a loaded program.
+ * ****************************************************************************/
+class symbol_table
+{
+    public:
+        /**
+         * @brief A named address range.
+         * ********************************************************************/
+        struct symbol
+        {
+            uint32_t addr;          ///< The first address of the symbol.
+            uint32_t size;          ///< Its size in bytes, or 0 if unknown.
+            std::string name;       ///< The symbol's name.
+        };
+
+        /**
+         * @brief Adds a symbol. The table must be sorted again before the
+         *        next lookup.
+         * @param addr The first address of the symbol.
+         * @param size The symbol's size in bytes, or 0 if unknown.
+         * @param name The symbol's name.
+         * ********************************************************************/
+        void add(uint32_t addr, uint32_t size, const std::string &name);
+
+        /**
+         * @brief Sorts the symbols by address for lookup().
+         * ********************************************************************/
+        void sort();
+
+        /**
+         * @brief Finds the symbol that addr falls in.
+         *
+         * A symbol with a size covers [addr, addr + size). One without a size
+         * covers everything up to the next symbol.
+         *
+         * @param addr The address to look up.
+         * @return The symbol, or nullptr if addr isn't inside of any.
+         * ********************************************************************/
+        const symbol *lookup(uint32_t addr) const;
+
+        /**
+         * @brief Finds the symbol that starts exactly at addr.
+         * @param addr The address to look up.
+         * @return The symbol, or nullptr if none starts there.
+         * ********************************************************************/
+        const symbol *at(uint32_t addr) const;
+
+        /**
+         * @brief Are there any symbols?
+         * @return true if no symbols have been added.
+         * ********************************************************************/
+        bool empty() const { return symbols.empty(); }
+
+    private:
+        /**
+         * @brief The symbols, sorted by address after sort().
+         * ********************************************************************/
+        std::vector<symbol> symbols;
+};
+
+#endif
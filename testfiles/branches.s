@@ -0,0 +1,129 @@
+# branches.s - branch-heavy guest benchmark for rv32i_perf.
+#
+# Draws ITERS pseudo-random numbers from a linear congruential generator
+# and, for each, takes data-dependent branches, binary searches a sorted
+# table, dispatches through a jump table and calls a small function, so
+# that the branches are hard to predict. Halts with ebreak and a checksum
+# in a0.
+
+	.equ TABLE, 0x10000
+	.equ ENTRIES, 64
+	.equ ITERS, 60000
+
+	.text
+	.globl _start
+_start:
+	# table[i] = i * 16
+	li	s5, TABLE
+	li	t0, 0
+	li	t1, ENTRIES
+init:
+	slli	t2, t0, 4
+	slli	t3, t0, 2
+	add	t3, s5, t3
+	sw	t2, 0(t3)
+	addi	t0, t0, 1
+	blt	t0, t1, init
+
+	li	s0, ITERS
+	li	s1, 12345		# generator state
+	li	s8, 1103515245
+	li	s2, 0			# checksums
+	li	s3, 0
+	li	s4, 0
+	li	s6, 0
+	li	s7, 0
+loop:
+	mul	s1, s1, s8
+	addi	s1, s1, 1234
+	srli	t0, s1, 8
+
+	# odd or even
+	andi	t1, t0, 1
+	beqz	t1, even
+	addi	s2, s2, 3
+	j	1f
+even:
+	addi	s3, s3, 1
+1:
+	# three-way compare against thresholds
+	andi	t1, t0, 0xff
+	li	t2, 85
+	bltu	t1, t2, low
+	li	t2, 170
+	bltu	t1, t2, mid
+	xor	s4, s4, t0
+	j	2f
+low:
+	add	s4, s4, t1
+	j	2f
+mid:
+	sub	s4, s4, t1
+2:
+	# binary search for (t0 & 0x3ff) in the table
+	andi	a0, t0, 0x3ff
+	li	a1, 0
+	li	a2, ENTRIES
+search:
+	bgeu	a1, a2, found
+	add	a3, a1, a2
+	srli	a3, a3, 1
+	slli	a4, a3, 2
+	add	a4, a4, s5
+	lw	a5, 0(a4)
+	bltu	a5, a0, higher
+	mv	a2, a3
+	j	search
+higher:
+	addi	a1, a3, 1
+	j	search
+found:
+	add	s6, s6, a1
+
+	# switch on two more bits through a jump table
+	srli	t1, t0, 12
+	andi	t1, t1, 3
+	slli	t1, t1, 2
+	la	t3, cases
+	add	t3, t3, t1
+	lw	t3, 0(t3)
+	jr	t3
+case0:
+	addi	s7, s7, 1
+	j	done
+case1:
+	xor	s7, s7, t0
+	j	done
+case2:
+	add	s7, s7, t0
+	j	done
+case3:
+	mv	a0, t0
+	call	popcount
+	add	s7, s7, a0
+done:
+	addi	s0, s0, -1
+	bnez	s0, loop
+
+	add	a0, s2, s3
+	add	a0, a0, s4
+	add	a0, a0, s6
+	add	a0, a0, s7
+	ebreak
+
+# popcount(x) of the low byte, a bit at a time
+popcount:
+	andi	a1, a0, 0xff
+	li	a0, 0
+1:
+	beqz	a1, 2f
+	andi	a2, a1, 1
+	add	a0, a0, a2
+	srli	a1, a1, 1
+	j	1b
+2:
+	ret
+
+	.p2align 2
+cases:
+	.word	case0, case1, case2, case3
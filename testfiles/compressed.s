@@ -0,0 +1,65 @@
+# compressed.s - every RV32C instruction, for -c.
+#
+# Runs each compressed instruction at least once, then loops 20 times over
+# a 32-bit instruction that straddles the page boundary at 0x1000, often
+# enough for -e jit to translate the blocks on either side of it. Needs
+# -m1100 or more. Halts with c.ebreak.
+
+	.text
+	.globl _start
+_start:
+	lui	sp, 1
+	c.addi16sp sp, 128		# sp = 0x1080
+	c.addi4spn s0, sp, 16		# s0 = 0x1090
+	c.li	a0, -5
+	c.lui	a1, 0x12
+	c.addi	a1, 7
+	c.mv	a2, a0
+	c.add	a2, a1
+	c.mv	a3, a1
+	c.sub	a3, a0
+	c.mv	a4, a1
+	c.xor	a4, a0
+	c.mv	a5, a1
+	c.or	a5, a0
+	c.mv	s1, a1
+	c.and	s1, a0
+	c.andi	s1, -2
+	c.slli	a3, 4
+	c.srli	a4, 3
+	c.srai	a0, 1
+	c.nop
+	c.sw	a2, 0(s0)
+	c.sw	a0, 4(s0)
+	c.lw	a3, 4(s0)
+	c.swsp	a4, 8(sp)
+	c.lwsp	a5, 8(sp)
+	c.beqz	a5, bad			# not taken
+	c.bnez	a5, 1f			# taken
+	c.ebreak
+1:	c.li	a5, 0
+	c.bnez	a5, bad			# not taken
+	c.beqz	a5, 2f			# taken
+	c.ebreak
+2:	c.jal	func
+	auipc	a5, 0
+	addi	a5, a5, 10		# a5 = 3f
+	c.jalr	a5
+	c.ebreak
+3:	c.li	s1, 20
+	j	loop
+bad:	c.ebreak
+
+func:	c.addi	a1, 1
+	c.jr	ra
+
+	# nops from 0x5c up to the loop, so that its third instruction
+	# straddles 0x1000
+	.fill	999, 4, 0x00000013
+	c.nop
+	.org	0xffa
+loop:	c.addi	s1, -1
+	c.addi	a4, 1
+	addi	a5, a4, 100		# 0xffe to 0x1001
+	c.bnez	s1, loop
+	c.ebreak
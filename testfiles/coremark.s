@@ -0,0 +1,284 @@
+# coremark.s - CoreMark-like guest benchmark for rv32i_perf.
+#
+# Each iteration runs the four CoreMark kernels on small data sets: a
+# linked list walk and reversal, an 8x8 integer matrix multiply, a number
+# parsing state machine, and a bitwise CRC16 (crcu8) over the matrix
+# result. Runs ITERS times and halts with ebreak and a checksum in a0.
+
+	.equ LIST, 0x10000		# 64 nodes: next, value
+	.equ NODES, 64
+	.equ MAT_A, 0x11000		# int[8][8]
+	.equ MAT_B, 0x11100
+	.equ MAT_C, 0x11200
+	.equ ITERS, 400
+
+	.text
+	.globl _start
+_start:
+	# node[i] = { &node[i + 1], (i * 37 + 11) & 0xff }, the last next is 0
+	li	s0, LIST
+	mv	t0, s0
+	li	t1, 0
+	li	t2, NODES
+1:
+	addi	t3, t0, 8
+	addi	t4, t1, 1
+	bne	t4, t2, 2f
+	li	t3, 0
+2:
+	sw	t3, 0(t0)
+	li	t5, 37
+	mul	t5, t1, t5
+	addi	t5, t5, 11
+	andi	t5, t5, 0xff
+	sw	t5, 4(t0)
+	mv	t0, t3
+	mv	t1, t4
+	bnez	t0, 1b
+	mv	s1, s0			# head
+
+	# A[i][j] = i + j + 1, B[i][j] = i - j
+	li	s6, MAT_A
+	li	s7, MAT_B
+	li	s8, MAT_C
+	li	t0, 0
+3:
+	li	t1, 0
+4:
+	slli	t2, t0, 3
+	add	t2, t2, t1
+	slli	t2, t2, 2
+	add	t3, t0, t1
+	addi	t3, t3, 1
+	add	t4, s6, t2
+	sw	t3, 0(t4)
+	sub	t3, t0, t1
+	add	t4, s7, t2
+	sw	t3, 0(t4)
+	addi	t1, t1, 1
+	li	t5, 8
+	blt	t1, t5, 4b
+	addi	t0, t0, 1
+	blt	t0, t5, 3b
+
+	li	s2, ITERS
+	li	s3, 0			# crc
+	li	s4, 0			# list sum
+	li	s5, 0			# state machine results
+loop:
+	call	list_work
+	call	matrix_work
+	la	a0, numbers
+	call	state_work
+	add	s5, s5, a0
+
+	# crc the low bytes of C
+	li	s9, 0
+5:
+	slli	t0, s9, 2
+	add	t0, s8, t0
+	lbu	a0, 0(t0)
+	mv	a1, s3
+	call	crcu8
+	mv	s3, a0
+	addi	s9, s9, 1
+	li	t0, 64
+	blt	s9, t0, 5b
+
+	# perturb A so each iteration's product differs
+	andi	t0, s2, 7
+	slli	t1, t0, 3
+	add	t1, t1, t0
+	slli	t1, t1, 2
+	add	t1, s6, t1
+	lw	t2, 0(t1)
+	addi	t2, t2, 1
+	sw	t2, 0(t1)
+
+	addi	s2, s2, -1
+	bnez	s2, loop
+
+	slli	a0, s3, 16
+	xor	a0, a0, s4
+	add	a0, a0, s5
+	ebreak
+
+# Walks the list, folding the running sum into each value, then reverses it.
+list_work:
+	mv	t0, s1
+1:
+	lw	t1, 4(t0)
+	add	s4, s4, t1
+	andi	t2, t1, 1
+	beqz	t2, 2f
+	xori	t1, t1, 0x5a
+2:
+	add	t1, t1, s4
+	andi	t1, t1, 0xff
+	sw	t1, 4(t0)
+	lw	t0, 0(t0)
+	bnez	t0, 1b
+
+	li	t1, 0			# prev
+	mv	t0, s1
+3:
+	lw	t2, 0(t0)
+	sw	t1, 0(t0)
+	mv	t1, t0
+	mv	t0, t2
+	bnez	t0, 3b
+	mv	s1, t1
+	ret
+
+# C = A * B
+matrix_work:
+	li	t0, 0			# i
+1:
+	li	t1, 0			# j
+2:
+	li	t2, 0			# k
+	li	t3, 0			# sum
+	slli	t4, t0, 5
+	add	t4, s6, t4		# &A[i][0]
+	slli	t5, t1, 2
+	add	t5, s7, t5		# &B[0][j]
+3:
+	lw	a2, 0(t4)
+	lw	a3, 0(t5)
+	mul	a2, a2, a3
+	add	t3, t3, a2
+	addi	t4, t4, 4
+	addi	t5, t5, 32
+	addi	t2, t2, 1
+	li	a4, 8
+	blt	t2, a4, 3b
+
+	slli	a2, t0, 3
+	add	a2, a2, t1
+	slli	a2, a2, 2
+	add	a2, s8, a2
+	sw	t3, 0(a2)
+	addi	t1, t1, 1
+	blt	t1, a4, 2b
+	addi	t0, t0, 1
+	blt	t0, a4, 1b
+	ret
+
+# Classifies each comma separated field of the string at a0 as an integer
+# (1), a decimal (2), a number in scientific notation (3) or invalid (4),
+# and returns the sum of field number times class.
+state_work:
+	li	a1, 0			# result
+	li	a2, 1			# field number
+	li	t0, 0			# state: 0 start, 1 sign, 2 int, 3 frac, 4 exp, 5 exp sign, 6 sci, 7 invalid
+	li	t3, '0'
+	li	t4, '9'
+next:
+	lbu	t1, 0(a0)
+	addi	a0, a0, 1
+	li	t2, ','
+	beq	t1, t2, field
+	beqz	t1, field
+
+	# digits
+	bltu	t1, t3, notdigit
+	bgtu	t1, t4, notdigit
+	li	t2, 4
+	bgeu	t0, t2, 1f
+	li	t2, 3
+	beq	t0, t2, next
+	li	t0, 2			# start, sign or int
+	j	next
+1:
+	li	t2, 7
+	beq	t0, t2, next
+	li	t0, 6			# exp, exp sign or sci
+	j	next
+
+notdigit:
+	li	t2, '+'
+	beq	t1, t2, sign
+	li	t2, '-'
+	beq	t1, t2, sign
+	li	t2, '.'
+	beq	t1, t2, dot
+	ori	t1, t1, 0x20
+	li	t2, 'e'
+	beq	t1, t2, exp
+	li	t0, 7
+	j	next
+sign:
+	beqz	t0, 1f
+	li	t2, 4
+	beq	t0, t2, 2f
+	li	t0, 7
+	j	next
+1:
+	li	t0, 1
+	j	next
+2:
+	li	t0, 5
+	j	next
+dot:
+	li	t2, 2
+	beq	t0, t2, 1f
+	li	t0, 7
+	j	next
+1:
+	li	t0, 3
+	j	next
+exp:
+	addi	t2, t0, -2
+	li	t5, 1
+	bgtu	t2, t5, 1f		# only after int or frac
+	li	t0, 4
+	j	next
+1:
+	li	t0, 7
+	j	next
+
+field:
+	li	t2, 4			# invalid unless it ended in a final state
+	li	t5, 2
+	bne	t0, t5, 1f
+	li	t2, 1
+1:
+	li	t5, 3
+	bne	t0, t5, 2f
+	li	t2, 2
+2:
+	li	t5, 6
+	bne	t0, t5, 3f
+	li	t2, 3
+3:
+	mul	t2, t2, a2
+	add	a1, a1, t2
+	addi	a2, a2, 1
+	li	t0, 0
+	bnez	t1, next
+	mv	a0, a1
+	ret
+
+# crcu8(data, crc): CoreMark's bitwise CRC16 of one byte.
+crcu8:
+	li	t0, 8
+	li	t3, 0x4002
+	li	t4, 0x8000
+1:
+	xor	t1, a0, a1
+	andi	t1, t1, 1
+	srli	a0, a0, 1
+	beqz	t1, 2f
+	xor	a1, a1, t3
+	srli	a1, a1, 1
+	or	a1, a1, t4
+	j	3f
+2:
+	srli	a1, a1, 1
+3:
+	addi	t0, t0, -1
+	bnez	t0, 1b
+	ret
+
+numbers:
+	.asciz	"5012,1234,-874,+122,35.54,.1234,-110.7,0.5e-3,-.123,-1.2e+7,+6e-10,2.1e,12x4,99e9,T0.3e-1F,--5"
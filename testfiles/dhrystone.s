@@ -0,0 +1,260 @@
+# dhrystone.s - Dhrystone-like guest benchmark for rv32i_perf.
+#
+# Follows the shape of Dhrystone 2.1's main loop: record assignment and
+# pointer chasing (Proc_1, Proc_3), string copy and compare (strcpy,
+# Func_2), array updates (Proc_8), nested procedure calls with stack
+# frames, and integer multiply and divide. Runs ITERS times and halts with
+# ebreak and a checksum in a0.
+
+	.equ REC_A, 0x10000		# records: next, discr, enum, int, str[32]
+	.equ REC_B, 0x10040
+	.equ STR_1, 0x10100
+	.equ STR_2, 0x10140
+	.equ INT_GLOB, 0x10200
+	.equ BOOL_GLOB, 0x10204
+	.equ CHAR_GLOB, 0x10208
+	.equ ARR_1, 0x11000		# int[50]
+	.equ ARR_2, 0x12000		# int[50][50]
+	.equ ITERS, 10000
+
+	.text
+	.globl _start
+_start:
+	# Ptr_Glob->next = Next_Ptr_Glob, discr 0, enum 2, int 40, str
+	li	s0, REC_A
+	li	s1, REC_B
+	sw	s1, 0(s0)
+	sw	zero, 4(s0)
+	li	t0, 2
+	sw	t0, 8(s0)
+	li	t0, 40
+	sw	t0, 12(s0)
+	addi	a0, s0, 16
+	la	a1, some_string
+	call	strcpy
+
+	li	a0, STR_1
+	la	a1, first_string
+	call	strcpy
+
+	li	s2, ITERS
+	li	s11, 0			# checksum
+loop:
+	# Proc_5, Proc_4
+	li	t0, 'A'
+	li	t1, CHAR_GLOB
+	sb	t0, 0(t1)
+	li	t1, BOOL_GLOB
+	sw	zero, 0(t1)
+
+	li	s3, 2			# Int_1_Loc
+	li	s4, 3			# Int_2_Loc
+	li	a0, STR_2
+	la	a1, second_string
+	call	strcpy
+
+	# Bool_Glob = !Func_2(Str_1_Loc, Str_2_Loc)
+	li	a0, STR_1
+	li	a1, STR_2
+	call	strcmp
+	seqz	a0, a0
+	li	t1, BOOL_GLOB
+	sw	a0, 0(t1)
+
+	# while (Int_1_Loc < Int_2_Loc) { Int_3_Loc = 5 * Int_1_Loc - Int_2_Loc; Proc_7 }
+1:
+	bge	s3, s4, 2f
+	slli	t0, s3, 2
+	add	t0, t0, s3
+	sub	s5, t0, s4
+	mv	a0, s3
+	mv	a1, s4
+	call	proc_7
+	mv	s5, a0
+	addi	s3, s3, 1
+	j	1b
+2:
+	li	a0, ARR_1
+	li	a1, ARR_2
+	mv	a2, s3
+	mv	a3, s5
+	call	proc_8
+
+	mv	a0, s0
+	call	proc_1
+
+	# Int_2_Loc = Int_2_Loc * Int_1_Loc; Int_1_Loc = Int_2_Loc / Int_3_Loc;
+	# Int_2_Loc = 7 * (Int_2_Loc - Int_3_Loc) - Int_1_Loc
+	mul	s4, s4, s3
+	div	s3, s4, s5
+	sub	t0, s4, s5
+	slli	t1, t0, 3
+	sub	t0, t1, t0
+	sub	s4, t0, s3
+
+	add	s11, s11, s3
+	add	s11, s11, s4
+	add	s11, s11, s5
+
+	addi	s2, s2, -1
+	bnez	s2, loop
+
+	li	t0, INT_GLOB
+	lw	t0, 0(t0)
+	add	a0, s11, t0
+	ebreak
+
+# strcpy(dst, src)
+strcpy:
+1:
+	lbu	t0, 0(a1)
+	sb	t0, 0(a0)
+	addi	a0, a0, 1
+	addi	a1, a1, 1
+	bnez	t0, 1b
+	ret
+
+# strcmp(a, b): < 0, 0 or > 0
+strcmp:
+1:
+	lbu	t0, 0(a0)
+	lbu	t1, 0(a1)
+	bne	t0, t1, 2f
+	addi	a0, a0, 1
+	addi	a1, a1, 1
+	bnez	t0, 1b
+2:
+	sub	a0, t0, t1
+	ret
+
+# proc_7(a, b): a + b + 2
+proc_7:
+	add	a0, a0, a1
+	addi	a0, a0, 2
+	ret
+
+# proc_8(arr_1, arr_2, int_1, int_2)
+proc_8:
+	addi	t0, a2, 5		# Int_Loc
+	slli	t1, t0, 2
+	add	t1, a0, t1		# &Arr_1[Int_Loc]
+	sw	a3, 0(t1)
+	sw	a3, 4(t1)
+	sw	t0, 120(t1)		# Arr_1[Int_Loc + 30]
+
+	li	t2, 200
+	mul	t3, t0, t2
+	add	t3, a1, t3		# &Arr_2[Int_Loc][0]
+	slli	t4, t0, 2
+	add	t4, t3, t4		# &Arr_2[Int_Loc][Int_Loc]
+	sw	t0, 0(t4)
+	sw	t0, 4(t4)
+	lw	t5, -4(t4)
+	addi	t5, t5, 1
+	sw	t5, -4(t4)
+	lw	t5, 0(t1)
+	li	t2, 4000		# 20 rows on
+	add	t4, t4, t2
+	sw	t5, 0(t4)
+
+	li	t0, INT_GLOB
+	li	t1, 5
+	sw	t1, 0(t0)
+	ret
+
+# proc_1(ptr)
+proc_1:
+	addi	sp, sp, -16
+	sw	ra, 12(sp)
+	sw	s0, 8(sp)
+	sw	s1, 4(sp)
+	mv	s0, a0
+	lw	s1, 0(s0)		# Next_Record
+
+	# *Next_Record = *Ptr_Val_Par
+	li	t0, 0
+1:
+	add	t1, s0, t0
+	lw	t2, 0(t1)
+	add	t1, s1, t0
+	sw	t2, 0(t1)
+	addi	t0, t0, 4
+	li	t3, 48
+	blt	t0, t3, 1b
+
+	li	t0, 5
+	sw	t0, 12(s0)
+	sw	t0, 12(s1)
+	lw	t0, 0(s0)
+	sw	t0, 0(s1)
+	mv	a0, s1
+	call	proc_3
+
+	lw	t0, 4(s1)
+	bnez	t0, 2f
+	li	t0, 6
+	sw	t0, 12(s1)
+	lw	a0, 8(s0)
+	call	proc_6
+	sw	a0, 8(s1)
+	lw	t0, 0(s0)
+	sw	t0, 0(s1)
+	lw	a0, 12(s1)
+	li	a1, 10
+	call	proc_7
+	sw	a0, 12(s1)
+	j	3f
+2:
+	# *Ptr_Val_Par = *Ptr_Val_Par->Ptr_Comp
+	li	t0, 0
+4:
+	add	t1, s1, t0
+	lw	t2, 0(t1)
+	add	t1, s0, t0
+	sw	t2, 0(t1)
+	addi	t0, t0, 4
+	li	t3, 48
+	blt	t0, t3, 4b
+3:
+	lw	ra, 12(sp)
+	lw	s0, 8(sp)
+	lw	s1, 4(sp)
+	addi	sp, sp, 16
+	ret
+
+# proc_3(rec): rec->int = proc_7(10, Int_Glob)
+proc_3:
+	addi	sp, sp, -16
+	sw	ra, 12(sp)
+	sw	a0, 8(sp)
+	li	t0, INT_GLOB
+	lw	a1, 0(t0)
+	li	a0, 10
+	call	proc_7
+	lw	t0, 8(sp)
+	sw	a0, 12(t0)
+	lw	ra, 12(sp)
+	addi	sp, sp, 16
+	ret
+
+# proc_6(enum): the enumeration Proc_6 would pick
+proc_6:
+	li	t0, 2
+	beq	a0, t0, 1f
+	li	t0, 3
+	bltu	a0, t0, 2f
+	li	a0, 3
+	ret
+1:
+	li	a0, 1
+	ret
+2:
+	li	a0, 0
+	ret
+
+some_string:
+	.asciz	"DHRYSTONE PROGRAM, SOME STRING"
+first_string:
+	.asciz	"DHRYSTONE PROGRAM, 1'ST STRING"
+second_string:
+	.asciz	"DHRYSTONE PROGRAM, 2'ND STRING"
@@ -0,0 +1,25 @@
+# divs.s - 800 independent divides, for the timing models.
+#
+# The divides don't depend on each other, so the single divider, which is
+# busy for a divide's whole latency, is the only limit: --timing must
+# report at least 800 times the div latency in cycles, whatever the
+# reorder buffer size. Halts with ebreak.
+
+	.text
+	.globl _start
+_start:
+	li	s0, 100
+	li	t0, 1000
+	li	t1, 7
+loop:
+	div	a0, t0, t1
+	div	a1, t0, t1
+	div	a2, t0, t1
+	div	a3, t0, t1
+	div	a4, t0, t1
+	div	a5, t0, t1
+	div	a6, t0, t1
+	div	a7, t0, t1
+	addi	s0, s0, -1
+	bnez	s0, loop
+	ebreak
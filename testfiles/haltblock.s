@@ -0,0 +1,14 @@
+# haltblock.s - an illegal load in the middle of a basic block.
+#
+# Every engine must stop at the load with "Illegal instruction" after 2
+# instructions, leaving x2 and x3 unwritten; a block or translated block
+# must not run on to the ebreak.
+
+	.text
+	.globl _start
+_start:
+	addi	x1, x0, 1
+	.word	0x00003103		# lw x2,0(x0) with the unused funct3 011
+	addi	x2, x0, 2
+	addi	x3, x0, 3
+	ebreak
@@ -0,0 +1,97 @@
+# memcpy.s - memory-copy-heavy guest benchmark for rv32i_perf.
+#
+# Copies a 16 KiB buffer back and forth ITERS times with a word copy
+# unrolled four times, copies an unaligned 1 KiB tail a byte at a time,
+# and clears part of a buffer a word at a time. Halts with ebreak and the
+# sum of the destination buffer in a0.
+
+	.equ SRC, 0x10000
+	.equ DST, 0x14000
+	.equ LEN, 0x4000
+	.equ TAIL, 0x400
+	.equ ITERS, 256
+
+	.text
+	.globl _start
+_start:
+	li	s0, SRC
+	li	s1, DST
+
+	# fill the source with a pattern
+	li	t0, 0
+	li	t1, LEN
+	li	t2, 0x01020304
+fill:
+	add	t3, s0, t0
+	sw	t2, 0(t3)
+	addi	t2, t2, 0x135
+	addi	t0, t0, 4
+	blt	t0, t1, fill
+
+	li	s2, ITERS
+loop:
+	mv	a0, s1
+	mv	a1, s0
+	li	a2, LEN
+	call	copy_words
+
+	addi	a0, s0, 1		# unaligned both ways
+	addi	a1, s1, 7
+	li	a2, TAIL
+	call	copy_bytes
+
+	addi	a0, s1, 0x100
+	li	a1, TAIL
+	call	clear_words
+
+	addi	s2, s2, -1
+	bnez	s2, loop
+
+	# sum the destination
+	li	a0, 0
+	li	t0, 0
+	li	t1, LEN
+sum:
+	add	t3, s1, t0
+	lw	t2, 0(t3)
+	add	a0, a0, t2
+	addi	t0, t0, 4
+	blt	t0, t1, sum
+	ebreak
+
+# copy_words(dst, src, len): len a multiple of 16
+copy_words:
+	add	a3, a1, a2
+1:
+	lw	t0, 0(a1)
+	lw	t1, 4(a1)
+	lw	t2, 8(a1)
+	lw	t3, 12(a1)
+	sw	t0, 0(a0)
+	sw	t1, 4(a0)
+	sw	t2, 8(a0)
+	sw	t3, 12(a0)
+	addi	a1, a1, 16
+	addi	a0, a0, 16
+	bltu	a1, a3, 1b
+	ret
+
+# copy_bytes(dst, src, len)
+copy_bytes:
+	add	a3, a1, a2
+1:
+	lbu	t0, 0(a1)
+	sb	t0, 0(a0)
+	addi	a1, a1, 1
+	addi	a0, a0, 1
+	bltu	a1, a3, 1b
+	ret
+
+# clear_words(dst, len): len a multiple of 4
+clear_words:
+	add	a2, a0, a1
+1:
+	sw	zero, 0(a0)
+	addi	a0, a0, 4
+	bltu	a0, a2, 1b
+	ret
@@ -0,0 +1,42 @@
+# muldiv.s - every RV32M instruction, for -i and -z.
+#
+# Runs mul, mulh, mulhsu, mulhu, div, divu, rem and remu on mixed-sign
+# operands, divides and takes remainders by zero, and divides INT_MIN by
+# -1. The loop runs 20 times, often enough for -e jit to translate it, so
+# the registers left for -z come from the last time through. Halts with
+# ebreak.
+
+	.text
+	.globl _start
+_start:
+	li	s0, 20
+	li	t0, -7
+	li	t1, 3
+	li	t2, 0x80000000		# INT_MIN
+	li	t3, -1
+	li	t4, 0x12345678
+	li	t5, 0x9abcdef0
+loop:
+	mul	a0, t4, t5
+	mulh	a1, t4, t5
+	mulhsu	a2, t5, t4
+	mulhu	a3, t4, t5
+	mul	a4, t2, t3		# INT_MIN
+	mulh	a5, t2, t2		# 0x40000000
+	mulhsu	a6, t3, t3		# -1
+	mulhu	a7, t3, t3		# 0xfffffffe
+	div	s1, t0, t1		# -2
+	divu	s2, t0, t1
+	rem	s3, t0, t1		# -1
+	remu	s4, t0, t1
+	div	s5, t0, zero		# -1
+	divu	s6, t0, zero		# 0xffffffff
+	rem	s7, t0, zero		# -7
+	remu	s8, t0, zero		# -7
+	div	s9, t2, t3		# INT_MIN
+	rem	s10, t2, t3		# 0
+	divu	s11, t2, t3		# 0
+	remu	t6, t2, t3		# INT_MIN
+	addi	s0, s0, -1
+	bnez	s0, loop
+	ebreak
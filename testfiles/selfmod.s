@@ -0,0 +1,25 @@
+# selfmod.s - stores over code that has been decoded and translated, and
+# over data on the same page.
+#
+# Each pass through the loop adds its addi's immediate to s1, then bumps
+# that immediate in memory, so s1 ends as 1 + 2 + ... + 100 = 5050 (0x13ba)
+# on every engine only if the store discards the stale decoded and
+# translated addi. The store to data next to the code must not. Halts
+# with ebreak.
+
+	.text
+	.globl _start
+_start:
+	li	s0, 100
+	li	s1, 0
+	li	t1, 0x100000		# 1 in the I-type immediate field
+loop:
+	addi	s1, s1, 1		# patched
+	lw	t0, 12(x0)
+	add	t0, t0, t1
+	sw	t0, 12(x0)
+	sw	s1, 60(x0)		# data, not code
+	addi	s0, s0, -1
+	bnez	s0, loop
+	ebreak
+	.word	0
@@ -0,0 +1,117 @@
+//******************************************************************************
+//
+// timing_model.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <cstdlib>
+#include <sstream>
+
+#include "timing_model.h"
+
+// Parses a list of class=cycles pairs.
+bool latencies::parse(const std::string &spec, latencies &l)
+{
+    std::istringstream iss(spec);
+    std::string item;
+    latencies n = l;
+
+    while (std::getline(iss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || eq + 1 == item.size())
+            return false;
+
+        char *end;
+        std::string value = item.substr(eq + 1);
+        unsigned long cycles = std::strtoul(value.c_str(), &end, 0);
+        if (*end || cycles > 1000)
+            return false;
+
+        std::string name = item.substr(0, eq);
+        if (name == "alu")
+            n.alu = cycles;
+        else if (name == "mul")
+            n.mul = cycles;
+        else if (name == "div")
+            n.div = cycles;
+        else if (name == "mem")
+            n.mem = cycles;
+        else if (name == "branch")
+            n.branch = cycles;
+        else if (name == "jump")
+            n.jump = cycles;
+        else
+            return false;
+    }
+
+    // every stage takes at least a cycle
+    if (!n.alu || !n.mul || !n.div || !n.mem)
+        return false;
+
+    l = n;
+    return true;
+}
+
+// Classifies an instruction.
+timing_model::insn_class timing_model::classify(uint32_t insn)
+{
+    switch (get_opcode(insn))
+    {
+        default:                    return insn_class::alu;
+        case opcode_load_imm:       return insn_class::load;
+        case opcode_stype:          return insn_class::store;
+        case opcode_btype:          return insn_class::branch;
+        case opcode_jal:            return insn_class::jal;
+        case opcode_jalr:           return insn_class::jalr;
+        case opcode_system:         return insn_class::system;
+
+        case opcode_rtype:
+            if (get_funct7(insn) != funct7_muldiv)
+                return insn_class::alu;
+            return get_funct3(insn) < funct3_div ? insn_class::mul : insn_class::div;
+    }
+}
+
+// Finds the registers an instruction reads.
+void timing_model::sources(const retired_insn &r, uint32_t src[2])
+{
+    src[0] = src[1] = 0;
+
+    switch (get_opcode(r.insn))
+    {
+        case opcode_btype:
+        case opcode_stype:
+        case opcode_rtype:
+            src[1] = r.rs2;
+            // fall through
+        case opcode_jalr:
+        case opcode_load_imm:
+        case opcode_alu_imm:
+            src[0] = r.rs1;
+            break;
+
+        case opcode_system:
+            if (get_funct3(r.insn) >= funct3_csrrw && get_funct3(r.insn) <= funct3_csrrc)
+            {
+                src[0] = r.rs1;
+            }
+            break;
+    }
+}
+
+// Finds the register an instruction writes.
+uint32_t timing_model::destination(const retired_insn &r)
+{
+    uint32_t opcode = get_opcode(r.insn);
+
+    if (opcode == opcode_btype || opcode == opcode_stype || (opcode == opcode_system && get_funct3(r.insn) == 0))
+        return 0;
+    return r.rd;
+}
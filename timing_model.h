@@ -0,0 +1,93 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+//******************************************************************************
+//
+// timing_model.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <string>
+
+#include "hart_observer.h"
+
+/**
+ * @brief The cycles each class of instruction takes in a timing model.
+ * ****************************************************************************/
+struct latencies
+{
+    uint32_t alu = { 1 };       ///< Execute cycles of integer, branch, jump and system instructions.
+    uint32_t mul = { 3 };       ///< Execute cycles of mul, mulh, mulhsu and mulhu.
+    uint32_t div = { 20 };      ///< Execute cycles of div, divu, rem and remu.
+    uint32_t mem = { 1 };       ///< Memory cycles of a load or store.
+    uint32_t branch = { 2 };    ///< Fetch cycles lost to a taken branch, a jalr or a mispredict.
+    uint32_t jump = { 1 };      ///< Fetch cycles lost to a jal.
+
+    /**
+     * @brief Parses a list of class=cycles pairs separated by commas, such
+     *        as mul=4,div=34. The classes are alu, mul, div, mem, branch
+     *        and jump.
+     * @param spec The list.
+     * @param l Where to put it. Classes that spec leaves out are left as
+     *        they are.
+     * @return false if spec is malformed or names an unknown class.
+     * ************************************************************************/
+    static bool parse(const std::string &spec, latencies &l);
+};
+
+/**
+ * @brief Base class for models that estimate the cycles a hart's
+ *        instructions would take on some microarchitecture.
+ *
+ * The functional hart executes the program as usual; a timing model only
+ * sees each instruction once it has retired, so it never changes what the
+ * program does.
+ * ****************************************************************************/
+class timing_model : public hart_observer
+{
+    protected:
+        /**
+         * @brief The kinds of instruction that are timed differently.
+         * ********************************************************************/
+        enum class insn_class
+        {
+            alu,        ///< Integer arithmetic, lui and auipc.
+            mul,        ///< A multiply.
+            div,        ///< A divide or remainder.
+            load,       ///< A load.
+            store,      ///< A store.
+            branch,     ///< A conditional branch.
+            jal,        ///< A jal.
+            jalr,       ///< A jalr.
+            system      ///< ecall, ebreak or a CSR instruction.
+        };
+
+        /**
+         * @brief Classifies an instruction.
+         * @param insn The instruction, expanded if it was compressed.
+         * @return Its class.
+         * ********************************************************************/
+        static insn_class classify(uint32_t insn);
+
+        /**
+         * @brief Finds the registers an instruction reads.
+         * @param r The instruction.
+         * @param src Where to put them. Unused slots are set to x0.
+         * ********************************************************************/
+        static void sources(const retired_insn &r, uint32_t src[2]);
+
+        /**
+         * @brief Finds the register an instruction writes.
+         * @param r The instruction.
+         * @return The register, or 0 if it writes none (or x0).
+         * ********************************************************************/
+        static uint32_t destination(const retired_insn &r);
+};
+
+#endif
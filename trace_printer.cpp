@@ -0,0 +1,109 @@
+//******************************************************************************
+//
+// trace_printer.cpp
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include "trace_printer.h"
+
+/**
+ * @brief Copies out the registers of a hart.
+ * @param h The hart.
+ * @return Its registers.
+ * ****************************************************************************/
+static std::array<int32_t, 32> get_regs(const rv32i_hart &h)
+{
+    std::array<int32_t, 32> regs;
+    for (uint32_t r = 0; r < 32; ++r)
+    {
+        regs[r] = h.get_reg(r);
+    }
+    return regs;
+}
+
+// Constructor. Starts the writer thread.
+trace_printer::trace_printer(const rv32i_hart &h, bool show_instructions, bool show_registers)
+    : replayer(h.mem.get_size(),
+               (h.get_compressed() ? binary_trace::flag_compressed : 0) | (h.get_syscalls() ? binary_trace::flag_syscalls : 0),
+               h.get_mhartid(), h.get_pc(), get_regs(h).data(), false),     // the hart prints the warnings
+      show_instructions(show_instructions), show_registers(show_registers)
+{
+    thread = std::thread(&trace_printer::writer, this);
+}
+
+// Destructor.
+trace_printer::~trace_printer()
+{
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+}
+
+// Waits until everything queued so far has been written.
+void trace_printer::drain()
+{
+    drain_requested.store(true, std::memory_order_release);
+
+    while (drain_requested.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+// The writer thread.
+void trace_printer::writer()
+{
+    uint64_t n = tail.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        uint64_t end = head.load(std::memory_order_acquire);
+
+        if (n != end)
+        {
+            for (uint64_t stop = std::min(end, n + release_quantum); n != stop; ++n)
+            {
+                replayer.replay(ring[n % ring_size], batch, show_instructions, show_registers);
+            }
+            tail.store(n, std::memory_order_release);
+
+            if (batch.tellp() >= batch_size)
+            {
+                write_batch();
+            }
+            continue;
+        }
+
+        // the flags are set after the last record is pushed, so look again
+        bool draining = drain_requested.load(std::memory_order_acquire);
+        bool stopped = stopping.load(std::memory_order_acquire);
+
+        if ((draining || stopped) && head.load(std::memory_order_acquire) == n)
+        {
+            write_batch();
+            std::cout.flush();
+
+            if (stopped)
+                return;
+
+            drain_requested.store(false, std::memory_order_release);
+        }
+        else if (!draining && !stopped)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Writes out the text gathered in batch.
+void trace_printer::write_batch()
+{
+    const std::string &text = batch.str();
+    std::cout.write(text.data(), text.size());
+    batch.str(std::string());
+}
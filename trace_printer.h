@@ -0,0 +1,135 @@
+#ifndef TRACE_PRINTER_H
+#define TRACE_PRINTER_H
+
+//******************************************************************************
+//
+// trace_printer.h
+//
+// CSCI 463 Assignment 5
+//
+// Author: Gavin St. George (Z1909350)
+//
+// RISC-V Simulator
+//
+//******************************************************************************
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include "binary_trace.h"
+
+/**
+ * @brief Class to print -i and -r output on a thread of its own.
+ *
+ * The hart captures each instruction it executes into a fixed-size record
+ * and pushes it into a lock-free single-producer/single-consumer ring. The
+ * writer thread pops the records, formats them with a trace_replayer and
+ * writes the text to std::cout in large batches, so formatting and output
+ * overlap with execution instead of adding to it.
+ *
+ * Whenever something else is about to write to std::cout, drain() must be
+ * called first so that the trace so far comes out ahead of it.
+ * ****************************************************************************/
+class trace_printer
+{
+    public:
+        /**
+         * @brief Constructor. Starts the writer thread.
+         * @param h The hart whose instructions will be printed, in the
+         *        state it is in before the first of them.
+         * @param show_instructions Print each instruction, as -i does.
+         * @param show_registers Dump the registers before each instruction,
+         *        as -r does.
+         * ********************************************************************/
+        trace_printer(const rv32i_hart &h, bool show_instructions, bool show_registers);
+
+        /**
+         * @brief Destructor. Prints everything still in the ring and stops
+         *        the writer thread.
+         * ********************************************************************/
+        ~trace_printer();
+
+        /**
+         * @brief Queues an instruction the hart has just executed.
+         * @param h The hart.
+         * @param pc The address of the instruction.
+         * @param d The decoded instruction.
+         * @param addr rs1 + imm as it was before the instruction executed.
+         * @param old The value rd held before the instruction executed.
+         * @param printed The hart has printed the instruction itself, and
+         *        it only needs to be replayed.
+         * ********************************************************************/
+        void record(const rv32i_hart &h, uint32_t pc, const rv32i_hart::decoded_insn &d, uint32_t addr, int32_t old, bool printed = false)
+        {
+            uint64_t n = head.load(std::memory_order_relaxed);
+
+            while (n - tail.load(std::memory_order_acquire) == ring_size)
+            {
+                std::this_thread::yield();      // full, wait for the writer to catch up
+            }
+
+            binary_trace::record &r = ring[n % ring_size];
+            binary_trace::capture(h, pc, d, addr, old, r);
+            if (printed)
+            {
+                r.flags |= binary_trace::rec_printed;
+            }
+
+            head.store(n + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Waits until everything queued so far has been written to
+         *        std::cout.
+         * ********************************************************************/
+        void drain();
+
+    private:
+        /**
+         * @brief Number of records the ring holds.
+         * ********************************************************************/
+        static constexpr uint64_t ring_size = 64 * 1024;
+
+        /**
+         * @brief Amount of text gathered before it is written.
+         * ********************************************************************/
+        static constexpr std::streamoff batch_size = 256 * 1024;
+
+        /**
+         * @brief Number of records formatted between updates of tail.
+         * ********************************************************************/
+        static constexpr uint64_t release_quantum = 256;
+
+        /**
+         * @brief The writer thread.
+         * ********************************************************************/
+        void writer();
+
+        /**
+         * @brief Writes out the text gathered in batch.
+         * ********************************************************************/
+        void write_batch();
+
+        trace_replayer replayer;        ///< Formats the records.
+        bool show_instructions;         ///< Print each instruction.
+        bool show_registers;            ///< Dump the registers before each instruction.
+        std::ostringstream batch;       ///< Text not yet written.
+
+        std::unique_ptr<binary_trace::record[]> ring { new binary_trace::record[ring_size] };   ///< The queued records.
+
+        // head and tail are kept on cache lines of their own, as each is 
+        // written by one thread and read by the other all the time
+
+        char pad0[64];                                          ///< Padding.
+        std::atomic<uint64_t> head = { 0 };                     ///< Records pushed, only written by the hart.
+        char pad1[64];                                          ///< Padding.
+        std::atomic<uint64_t> tail = { 0 };                     ///< Records popped, only written by the writer.
+        char pad2[64];                                          ///< Padding.
+        std::atomic<bool> drain_requested = { false };          ///< Set by drain(), cleared once drained.
+        std::atomic<bool> stopping = { false };                 ///< Set by the destructor.
+
+        std::thread thread;             ///< Runs writer().
+};
+
+#endif